@@ -18,6 +18,7 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 *********************************************************************/
 #include "abstract_output.h"
+#include "vblankclock.h"
 #include "wayland_server.h"
 
 // KWayland
@@ -35,6 +36,7 @@ namespace KWin
 
 AbstractOutput::AbstractOutput(QObject *parent)
     : QObject(parent)
+    , m_vblankClock(new VBlankClock(this))
 {
 }
 
@@ -49,6 +49,8 @@ namespace ColorCorrect {
 struct GammaRamp;
 }
 
+class VBlankClock;
+
 /**
  * Generic output representation in a Wayland session
  **/
@@ -102,6 +104,45 @@ public:
         return false;
     }
 
+    /**
+     * The clock predicting the vblanks of this output. Platforms feed it with the
+     * presentation timestamps they know about, otherwise it is a software clock.
+     **/
+    VBlankClock *vblankClock() const {
+        return m_vblankClock;
+    }
+
+    /**
+     * Whether the frame currently on screen is a client buffer which got scanned out
+     * without being composited.
+     **/
+    bool isDirectScanout() const {
+        return m_directScanout;
+    }
+
+    /**
+     * Whether the output supports a variable refresh rate, e.g. Adaptive-Sync.
+     **/
+    virtual bool isVrrCapable() const {
+        return false;
+    }
+    /**
+     * Asks for a variable refresh rate with the next frame. While it is enabled the output
+     * flips as soon as a frame is ready instead of at a fixed vblank.
+     *
+     * If the output fails to enable it, further requests are ignored until it got
+     * disabled again.
+     **/
+    virtual void setVrrEnabled(bool enabled) {
+        Q_UNUSED(enabled)
+    }
+    /**
+     * Whether the refresh rate of the output currently follows the frames.
+     **/
+    virtual bool isVrrEnabled() const {
+        return false;
+    }
+
 protected:
     QPointer<KWayland::Server::OutputChangeSet> changes() const {
         return m_changeset;
@@ -139,6 +180,9 @@ protected:
     void setInternal(bool set) {
         m_internal = set;
     }
+    void setDirectScanout(bool set) {
+        m_directScanout = set;
+    }
 
 private:
     QPointer<KWayland::Server::OutputChangeSet> m_changeset;
@@ -151,6 +195,8 @@ private:
     QSize m_physicalSize;
     Qt::ScreenOrientation m_orientation = Qt::PrimaryOrientation;
     bool m_internal = false;
+    bool m_directScanout = false;
+    VBlankClock *m_vblankClock;
 };
 
 }
@@ -0,0 +1,78 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "mock_drm.h"
+#include "../../plugins/platforms/drm/drm_object_connector.h"
+#include <QtTest>
+
+static _drmModeProperty property(uint32_t id, const char *name)
+{
+    _drmModeProperty p{id, 0, "", 0, nullptr, 0, nullptr, 0, nullptr};
+    qstrncpy(p.name, name, DRM_PROP_NAME_LEN);
+    return p;
+}
+
+class ConnectorTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testVrrCapable_data();
+    void testVrrCapable();
+    void testNoProperties();
+};
+
+void ConnectorTest::testVrrCapable_data()
+{
+    QTest::addColumn<QVector<uint32_t>>("ids");
+    QTest::addColumn<QVector<uint64_t>>("values");
+    QTest::addColumn<bool>("capable");
+
+    QTest::newRow("capable") << QVector<uint32_t>{1, 2} << QVector<uint64_t>{0, 1} << true;
+    QTest::newRow("not capable") << QVector<uint32_t>{1, 2} << QVector<uint64_t>{0, 0} << false;
+    QTest::newRow("no property") << QVector<uint32_t>{1} << QVector<uint64_t>{0} << false;
+    QTest::newRow("other property") << QVector<uint32_t>{1, 3} << QVector<uint64_t>{0, 1} << false;
+}
+
+void ConnectorTest::testVrrCapable()
+{
+    QFETCH(QVector<uint32_t>, ids);
+    QFETCH(QVector<uint64_t>, values);
+    const int fd = 30;
+    MockDrm::addDrmModeProperties(fd, QVector<_drmModeProperty>{
+        property(1, "CRTC_ID"),
+        property(2, "vrr_capable"),
+        property(3, "vrr_capable_but_not_really")
+    });
+    MockDrm::addObjectProperties(fd, 40, ids, values);
+
+    KWin::DrmConnector connector{40, fd};
+    QVERIFY(connector.atomicInit());
+    QTEST(connector.isVrrCapable(), "capable");
+}
+
+void ConnectorTest::testNoProperties()
+{
+    // the kernel does not know the connector
+    KWin::DrmConnector connector{41, 31};
+    QVERIFY(!connector.atomicInit());
+    QVERIFY(!connector.isVrrCapable());
+}
+
+QTEST_GUILESS_MAIN(ConnectorTest)
+#include "connectortest.moc"
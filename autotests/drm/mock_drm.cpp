@@ -20,10 +20,19 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "mock_drm.h"
 
 #include <QMap>
+#include <QPair>
 #include <QVector>
 
+#include <algorithm>
+
 static QMap<int, QVector<_drmModeProperty>> s_drmProperties{};
 
+struct MockObjectProperties {
+    QVector<uint32_t> ids;
+    QVector<uint64_t> values;
+};
+static QMap<QPair<int, uint32_t>, MockObjectProperties> s_objectProperties{};
+
 namespace MockDrm
 {
 
@@ -32,6 +41,12 @@ void addDrmModeProperties(int fd, const QVector<_drmModeProperty> &properties)
     s_drmProperties.insert(fd, properties);
 }
 
+void addObjectProperties(int fd, uint32_t objectId, const QVector<uint32_t> &ids, const QVector<uint64_t> &values)
+{
+    Q_ASSERT(ids.size() == values.size());
+    s_objectProperties.insert(qMakePair(fd, objectId), MockObjectProperties{ids, values});
+}
+
 }
 
 int drmModeAtomicAddProperty(drmModeAtomicReqPtr req, uint32_t object_id, uint32_t property_id, uint64_t value)
@@ -76,3 +91,41 @@ void drmModeFreeProperty(drmModePropertyPtr ptr)
 {
     delete ptr;
 }
+
+drmModeObjectPropertiesPtr drmModeObjectGetProperties(int fd, uint32_t object_id, uint32_t object_type)
+{
+    Q_UNUSED(object_type)
+    auto it = s_objectProperties.constFind(qMakePair(fd, object_id));
+    if (it == s_objectProperties.constEnd()) {
+        return nullptr;
+    }
+    auto *properties = new drmModeObjectProperties;
+    properties->count_props = it->ids.size();
+    properties->props = new uint32_t[it->ids.size()];
+    properties->prop_values = new uint64_t[it->values.size()];
+    std::copy(it->ids.constBegin(), it->ids.constEnd(), properties->props);
+    std::copy(it->values.constBegin(), it->values.constEnd(), properties->prop_values);
+    return properties;
+}
+
+void drmModeFreeObjectProperties(drmModeObjectPropertiesPtr ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    delete[] ptr->props;
+    delete[] ptr->prop_values;
+    delete ptr;
+}
+
+drmModeConnectorPtr drmModeGetConnector(int fd, uint32_t connectorId)
+{
+    Q_UNUSED(fd)
+    Q_UNUSED(connectorId)
+    return nullptr;
+}
+
+void drmModeFreeConnector(drmModeConnectorPtr ptr)
+{
+    Q_UNUSED(ptr)
+}
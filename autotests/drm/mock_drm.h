@@ -28,5 +28,10 @@ namespace MockDrm
 {
 
 void addDrmModeProperties(int fd, const QVector<_drmModeProperty> &properties);
+/**
+ * The properties with @p ids are returned by drmModeObjectGetProperties for @p objectId,
+ * with the current @p values.
+ **/
+void addObjectProperties(int fd, uint32_t objectId, const QVector<uint32_t> &ids, const QVector<uint64_t> &values);
 
 }
@@ -26,9 +26,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "shell_client.h"
 #include "wayland_server.h"
 #include "effect_builtins.h"
+#include "effects.h"
+#include "thumbnailitem.h"
 
 #include <KConfigGroup>
 
+#include <KWayland/Client/surface.h>
+
+#include <QQuickWindow>
+
 using namespace KWin;
 static const QString s_socketName = QStringLiteral("wayland_test_kwin_scene_opengl-0");
 
@@ -78,6 +84,7 @@ void GenericSceneOpenGLTest::initTestCase()
     kwinApp()->start();
     QVERIFY(workspaceCreatedSpy.wait());
     QVERIFY(Compositor::self());
+    waylandServer()->initWorkspace();
 }
 
 void GenericSceneOpenGLTest::testRestart_data()
@@ -115,3 +122,48 @@ void GenericSceneOpenGLTest::testRestart()
     // TODO: introduce frameRendered signal in SceneOpenGL
     QTest::qWait(100);
 }
+
+void GenericSceneOpenGLTest::testWindowThumbnail()
+{
+    // no effects are active, so the windows of the frame get recorded into a draw list,
+    // which has to be submitted before the thumbnail is painted into the lanczos filter's
+    // render target
+    auto scene = KWin::Compositor::self()->scene();
+    QVERIFY(scene);
+    QCOMPARE(scene->compositingType(), KWin::OpenGL2Compositing);
+    QVERIFY(!static_cast<EffectsHandlerImpl*>(effects)->hasActiveEffects());
+
+    QVERIFY(Test::setupWaylandConnection());
+    QScopedPointer<KWayland::Client::Surface> surface(Test::createSurface());
+    QVERIFY(!surface.isNull());
+    QScopedPointer<QObject> shellSurface(Test::createShellSurface(Test::ShellSurfaceType::XdgShellV6, surface.data()));
+    QVERIFY(!shellSurface.isNull());
+    ShellClient *c = Test::renderAndWaitForShown(surface.data(), QSize(400, 300), Qt::red);
+    QVERIFY(c);
+
+    QSignalSpy clientAddedSpy(waylandServer(), &WaylandServer::shellClientAdded);
+    QVERIFY(clientAddedSpy.isValid());
+    QQuickWindow window;
+    window.setGeometry(500, 500, 200, 200);
+    // smaller than the window, so it gets painted with the lanczos filter
+    WindowThumbnailItem *thumbnail = new WindowThumbnailItem(window.contentItem());
+    thumbnail->setSize(QSizeF(100, 75));
+    thumbnail->setClient(c);
+    window.show();
+    QVERIFY(clientAddedSpy.wait());
+    ShellClient *internal = clientAddedSpy.first().first().value<ShellClient*>();
+    QVERIFY(internal->isInternal());
+    QTRY_VERIFY(internal->effectWindow() && !internal->effectWindow()->thumbnails().isEmpty());
+
+    // paint a few frames with the thumbnail
+    for (int i = 0; i < 3; ++i) {
+        KWin::Compositor::self()->addRepaintFull();
+        QTest::qWait(100);
+    }
+    QVERIFY(KWin::Compositor::self()->isActive());
+    QCOMPARE(KWin::Compositor::self()->scene(), scene);
+
+    window.hide();
+    shellSurface.reset();
+    QVERIFY(Test::waitForWindowDestroyed(c));
+}
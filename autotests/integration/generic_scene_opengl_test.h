@@ -34,6 +34,7 @@ private Q_SLOTS:
     void cleanup();
     void testRestart_data();
     void testRestart();
+    void testWindowThumbnail();
 
 private:
     QByteArray m_envVariable;
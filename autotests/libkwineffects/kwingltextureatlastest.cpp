@@ -0,0 +1,314 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "mock_gl.h"
+#include "mock_glutils.h"
+#include <QTest>
+#include <kwingltextureatlas.h>
+#include <kwingltexture.h>
+
+using namespace KWin;
+
+class GLTextureAtlasTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testAllocate();
+    void testGap();
+    void testInvalidSize();
+    void testMaxTextureSize();
+    void testReuseAfterRelease();
+    void testNewPage();
+    void testNoFit();
+    void testClear();
+    void testDefragmentDropsPages();
+    void testDefragment();
+};
+
+static void fill(GLTextureAtlas &atlas, quint32 id, const QColor &color)
+{
+    QImage image(atlas.rect(id).size(), QImage::Format_ARGB32_Premultiplied);
+    image.fill(color);
+    atlas.texture(id)->update(image, atlas.rect(id).topLeft());
+}
+
+static bool isFilled(const GLTextureAtlas &atlas, quint32 id, const QColor &color)
+{
+    const QImage image = mockTextureImage(atlas.texture(id)).copy(atlas.rect(id));
+    for (int y = 0; y < image.height(); ++y) {
+        for (int x = 0; x < image.width(); ++x) {
+            if (image.pixelColor(x, y).rgba() != color.rgba()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void GLTextureAtlasTest::init()
+{
+    s_gl = new MockGL;
+}
+
+void GLTextureAtlasTest::cleanup()
+{
+    delete s_gl;
+    s_gl = nullptr;
+}
+
+void GLTextureAtlasTest::testAllocate()
+{
+    GLTextureAtlas atlas(QSize(64, 64), 2);
+    QCOMPARE(atlas.pageCount(), 0);
+    QCOMPARE(atlas.allocationCount(), 0);
+
+    const quint32 id = atlas.allocate(QSize(10, 20));
+    QVERIFY(id != 0);
+    QCOMPARE(atlas.rect(id), QRect(0, 0, 10, 20));
+    QVERIFY(atlas.texture(id));
+    QCOMPARE(atlas.texture(id)->width(), 64);
+    QCOMPARE(atlas.texture(id)->height(), 64);
+    QCOMPARE(atlas.pageCount(), 1);
+    QCOMPARE(atlas.allocationCount(), 1);
+
+    const quint32 second = atlas.allocate(QSize(5, 5));
+    QVERIFY(second != 0);
+    QVERIFY(second != id);
+    QCOMPARE(atlas.texture(second), atlas.texture(id));
+    QCOMPARE(atlas.allocationCount(), 2);
+
+    // unknown ids
+    QVERIFY(!atlas.texture(0));
+    QCOMPARE(atlas.rect(0), QRect());
+    QVERIFY(!atlas.texture(second + 1));
+}
+
+void GLTextureAtlasTest::testGap()
+{
+    // a row and a column are kept free between allocations, linear filtering
+    // would otherwise sample the neighbours
+    GLTextureAtlas atlas(QSize(64, 64), 1);
+    const quint32 first = atlas.allocate(QSize(10, 10));
+    const quint32 right = atlas.allocate(QSize(10, 10));
+    QCOMPARE(atlas.rect(first), QRect(0, 0, 10, 10));
+    QCOMPARE(atlas.rect(right), QRect(11, 0, 10, 10));
+
+    // fills the remaining width, so the next one has to go below
+    const quint32 wide = atlas.allocate(QSize(41, 10));
+    QCOMPARE(atlas.rect(wide), QRect(22, 0, 41, 10));
+    const quint32 below = atlas.allocate(QSize(10, 10));
+    QCOMPARE(atlas.rect(below), QRect(0, 11, 10, 10));
+
+    const QVector<quint32> ids = {first, right, wide, below};
+    for (quint32 a : ids) {
+        for (quint32 b : ids) {
+            if (a != b) {
+                QVERIFY(!atlas.rect(a).adjusted(-1, -1, 1, 1).intersects(atlas.rect(b)));
+            }
+        }
+    }
+}
+
+void GLTextureAtlasTest::testInvalidSize()
+{
+    GLTextureAtlas atlas(QSize(64, 64), 1);
+    QCOMPARE(atlas.allocate(QSize()), 0u);
+    QCOMPARE(atlas.allocate(QSize(0, 10)), 0u);
+    // no room for the gap
+    QCOMPARE(atlas.allocate(QSize(64, 10)), 0u);
+    QCOMPARE(atlas.allocate(QSize(10, 64)), 0u);
+    QCOMPARE(atlas.pageCount(), 0);
+
+    const quint32 id = atlas.allocate(QSize(63, 63));
+    QVERIFY(id != 0);
+    QCOMPARE(atlas.rect(id), QRect(0, 0, 63, 63));
+}
+
+void GLTextureAtlasTest::testMaxTextureSize()
+{
+    s_gl->getIntegerv.maxTextureSize = 32;
+    GLTextureAtlas atlas(QSize(64, 64), 1);
+    QCOMPARE(atlas.allocate(QSize(40, 10)), 0u);
+    const quint32 id = atlas.allocate(QSize(31, 31));
+    QVERIFY(id != 0);
+    QCOMPARE(atlas.texture(id)->width(), 32);
+    QCOMPARE(atlas.texture(id)->height(), 32);
+}
+
+void GLTextureAtlasTest::testReuseAfterRelease()
+{
+    GLTextureAtlas atlas(QSize(64, 64), 1);
+    const quint32 first = atlas.allocate(QSize(63, 31));
+    const quint32 second = atlas.allocate(QSize(63, 31));
+    QVERIFY(first != 0);
+    QVERIFY(second != 0);
+    GLTexture *page = atlas.texture(first);
+    QCOMPARE(atlas.allocate(QSize(10, 10)), 0u);
+
+    // released space below the skyline is only reused once the page is empty
+    atlas.release(first);
+    QCOMPARE(atlas.allocationCount(), 1);
+    QCOMPARE(atlas.rect(first), QRect());
+    QCOMPARE(atlas.allocate(QSize(10, 10)), 0u);
+
+    atlas.release(second);
+    QCOMPARE(atlas.allocationCount(), 0);
+    QCOMPARE(atlas.pageCount(), 1);
+    const quint32 id = atlas.allocate(QSize(63, 63));
+    QVERIFY(id != 0);
+    QVERIFY(id != first && id != second);
+    QCOMPARE(atlas.rect(id), QRect(0, 0, 63, 63));
+    QCOMPARE(atlas.texture(id), page);
+
+    // releasing twice or unknown ids does not harm
+    atlas.release(first);
+    atlas.release(0);
+    QCOMPARE(atlas.allocationCount(), 1);
+}
+
+void GLTextureAtlasTest::testNewPage()
+{
+    GLTextureAtlas atlas(QSize(64, 64), 2);
+    const quint32 first = atlas.allocate(QSize(63, 63));
+    const quint32 second = atlas.allocate(QSize(10, 10));
+    QVERIFY(first != 0);
+    QVERIFY(second != 0);
+    QCOMPARE(atlas.pageCount(), 2);
+    QVERIFY(atlas.texture(first) != atlas.texture(second));
+    QCOMPARE(atlas.rect(second), QRect(0, 0, 10, 10));
+
+    // the second page still has space
+    const quint32 third = atlas.allocate(QSize(10, 10));
+    QCOMPARE(atlas.texture(third), atlas.texture(second));
+    QCOMPARE(atlas.pageCount(), 2);
+}
+
+void GLTextureAtlasTest::testNoFit()
+{
+    // the caller has to fall back to a texture of its own
+    GLTextureAtlas atlas(QSize(64, 64), 2);
+    QVERIFY(atlas.allocate(QSize(63, 63)) != 0);
+    QVERIFY(atlas.allocate(QSize(63, 63)) != 0);
+    QCOMPARE(atlas.allocate(QSize(1, 1)), 0u);
+    QCOMPARE(atlas.pageCount(), 2);
+    QCOMPARE(atlas.allocationCount(), 2);
+}
+
+void GLTextureAtlasTest::testClear()
+{
+    GLTextureAtlas atlas(QSize(64, 64), 1);
+    const quint32 first = atlas.allocate(QSize(10, 10));
+    const quint32 second = atlas.allocate(QSize(10, 10));
+    fill(atlas, first, Qt::red);
+    fill(atlas, second, Qt::blue);
+    QVERIFY(isFilled(atlas, first, Qt::red));
+
+    atlas.clear(first);
+    QVERIFY(isFilled(atlas, first, Qt::transparent));
+    QVERIFY(isFilled(atlas, second, Qt::blue));
+}
+
+void GLTextureAtlasTest::testDefragmentDropsPages()
+{
+    GLTextureAtlas atlas(QSize(64, 64), 3);
+    const quint32 first = atlas.allocate(QSize(63, 63));
+    const quint32 second = atlas.allocate(QSize(63, 63));
+    const quint32 third = atlas.allocate(QSize(63, 63));
+    QCOMPARE(atlas.pageCount(), 3);
+
+    atlas.release(second);
+    atlas.defragment();
+    QCOMPARE(atlas.pageCount(), 2);
+    QCOMPARE(atlas.rect(first), QRect(0, 0, 63, 63));
+    QCOMPARE(atlas.rect(third), QRect(0, 0, 63, 63));
+
+    // one page is kept around
+    atlas.release(first);
+    atlas.release(third);
+    atlas.defragment();
+    QCOMPARE(atlas.pageCount(), 1);
+    QCOMPARE(atlas.allocationCount(), 0);
+}
+
+void GLTextureAtlasTest::testDefragment()
+{
+    GLTextureAtlas atlas(QSize(64, 64), 1);
+    // fills the page with a grid of four times four
+    QVector<quint32> ids;
+    for (int i = 0; i < 16; ++i) {
+        const quint32 id = atlas.allocate(QSize(15, 15));
+        QVERIFY(id != 0);
+        fill(atlas, id, QColor(i * 16, 255 - i * 16, 128));
+        ids << id;
+    }
+    QCOMPARE(atlas.allocate(QSize(1, 1)), 0u);
+    GLTexture *page = atlas.texture(ids.first());
+
+    // keep a diagonal, the free space in between cannot be allocated
+    QVector<int> live = {0, 5, 10, 15};
+    QHash<quint32, QRect> oldRects;
+    for (int i = 0; i < 16; ++i) {
+        if (live.contains(i)) {
+            oldRects.insert(ids.at(i), atlas.rect(ids.at(i)));
+        } else {
+            atlas.release(ids.at(i));
+        }
+    }
+    QCOMPARE(atlas.allocationCount(), 4);
+    QCOMPARE(atlas.allocate(QSize(31, 31)), 0u);
+
+    atlas.defragment();
+    QCOMPARE(atlas.pageCount(), 1);
+    QCOMPARE(atlas.allocationCount(), 4);
+    GLTexture *repacked = atlas.texture(ids.first());
+    QVERIFY(repacked != page);
+
+    bool moved = false;
+    for (int i : live) {
+        const quint32 id = ids.at(i);
+        QCOMPARE(atlas.texture(id), repacked);
+        const QRect rect = atlas.rect(id);
+        QCOMPARE(rect.size(), QSize(15, 15));
+        QVERIFY(QRect(0, 0, 64, 64).contains(rect));
+        moved |= rect != oldRects.value(id);
+        // the contents moved along
+        QVERIFY(isFilled(atlas, id, QColor(i * 16, 255 - i * 16, 128)));
+        for (int j : live) {
+            if (i != j) {
+                QVERIFY(!rect.adjusted(-1, -1, 1, 1).intersects(atlas.rect(ids.at(j))));
+            }
+        }
+    }
+    QVERIFY(moved);
+
+    // the released space can be used again
+    const quint32 id = atlas.allocate(QSize(31, 31));
+    QVERIFY(id != 0);
+    QCOMPARE(atlas.texture(id), repacked);
+
+    // nothing left to repack
+    atlas.defragment();
+    QCOMPARE(atlas.texture(id), repacked);
+}
+
+QTEST_GUILESS_MAIN(GLTextureAtlasTest)
+#include "kwingltextureatlastest.moc"
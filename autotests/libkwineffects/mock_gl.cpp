@@ -62,6 +62,10 @@ static void mock_glGetIntegerv(GLenum pname, GLint *data)
         if (data && s_gl) {
             *data = s_gl->getString.extensions.count();
         }
+    } else if (pname == GL_MAX_TEXTURE_SIZE) {
+        if (data && s_gl && s_gl->getIntegerv.maxTextureSize > 0) {
+            *data = s_gl->getIntegerv.maxTextureSize;
+        }
     }
 }
 
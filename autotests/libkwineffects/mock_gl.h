@@ -32,6 +32,10 @@ struct MockGL {
         QByteArray extensionsString;
         QByteArray shadingLanguageVersion;
     } getString;
+    struct {
+        // not reported if 0
+        int maxTextureSize = 0;
+    } getIntegerv;
 };
 
 extern MockGL *s_gl;
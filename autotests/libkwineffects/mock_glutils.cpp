@@ -0,0 +1,299 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "mock_glutils.h"
+#include <kwinglutils.h>
+
+#include <QPainter>
+#include <QSharedData>
+
+#include <algorithm>
+
+namespace KWin
+{
+
+class GLTexturePrivate : public QSharedData
+{
+public:
+    QImage image;
+    GLuint texture = 0;
+};
+
+class GLVertexBufferPrivate
+{
+public:
+    QVector<float> vertices;
+    QVector<float> texCoords;
+};
+
+static GLuint s_nextTexture = 1;
+static GLTexturePrivate *s_boundTexture = nullptr;
+// the textures of the pushed render targets
+static QStack<GLTexturePrivate *> s_targetTextures;
+
+static GLTexturePrivate *texturePrivate(const GLTexture *texture)
+{
+    // only members of GLTexture get to its private data
+    GLTexturePrivate *bound = s_boundTexture;
+    const_cast<GLTexture *>(texture)->bind();
+    GLTexturePrivate *d = s_boundTexture;
+    s_boundTexture = bound;
+    return d;
+}
+
+GLTexture::GLTexture(GLenum internalFormat, int width, int height, int levels)
+    : d_ptr(new GLTexturePrivate())
+{
+    Q_UNUSED(internalFormat)
+    Q_UNUSED(levels)
+    Q_D(GLTexture);
+    d->image = QImage(width, height, QImage::Format_ARGB32_Premultiplied);
+    // the contents of a new texture are undefined
+    d->image.fill(Qt::magenta);
+    d->texture = s_nextTexture++;
+}
+
+GLTexture::GLTexture(const GLTexture &tex)
+    : d_ptr(tex.d_ptr)
+{
+}
+
+GLTexture::~GLTexture()
+{
+}
+
+void GLTexture::discard()
+{
+    d_ptr = new GLTexturePrivate();
+}
+
+GLuint GLTexture::texture() const
+{
+    Q_D(const GLTexture);
+    return d->texture;
+}
+
+int GLTexture::width() const
+{
+    Q_D(const GLTexture);
+    return d->image.width();
+}
+
+int GLTexture::height() const
+{
+    Q_D(const GLTexture);
+    return d->image.height();
+}
+
+void GLTexture::setYInverted(bool inverted)
+{
+    Q_UNUSED(inverted)
+}
+
+void GLTexture::setWrapMode(GLenum mode)
+{
+    Q_UNUSED(mode)
+}
+
+void GLTexture::setFilter(GLenum filter)
+{
+    Q_UNUSED(filter)
+}
+
+void GLTexture::setDirty()
+{
+}
+
+void GLTexture::bind()
+{
+    s_boundTexture = d_ptr.data();
+}
+
+void GLTexture::unbind()
+{
+    s_boundTexture = nullptr;
+}
+
+void GLTexture::clear()
+{
+    Q_D(GLTexture);
+    d->image.fill(Qt::transparent);
+}
+
+void GLTexture::update(const QImage &image, const QPoint &offset, const QRect &src)
+{
+    Q_D(GLTexture);
+    QPainter painter(&d->image);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.drawImage(offset, image, src.isNull() ? image.rect() : src);
+}
+
+bool GLRenderTarget::sSupported = true;
+QStack<GLRenderTarget *> GLRenderTarget::s_renderTargets;
+
+GLRenderTarget::GLRenderTarget(const GLTexture &color)
+    : mTexture(color)
+    , mValid(true)
+    , mFramebuffer(0)
+{
+}
+
+GLRenderTarget::~GLRenderTarget()
+{
+}
+
+void GLRenderTarget::pushRenderTarget(GLRenderTarget *target)
+{
+    s_renderTargets.push(target);
+    s_targetTextures.push(texturePrivate(&target->mTexture));
+}
+
+GLRenderTarget *GLRenderTarget::popRenderTarget()
+{
+    s_targetTextures.pop();
+    return s_renderTargets.pop();
+}
+
+GLShader::GLShader(unsigned int flags)
+    : mProgram(0)
+    , mValid(true)
+    , mLocationsResolved(true)
+    , mExplicitLinking(false)
+    , mCompilePending(false)
+{
+    Q_UNUSED(flags)
+}
+
+GLShader::~GLShader()
+{
+}
+
+bool GLShader::setUniform(MatrixUniform uniform, const QMatrix4x4 &matrix)
+{
+    Q_UNUSED(uniform)
+    Q_UNUSED(matrix)
+    return true;
+}
+
+ShaderManager *ShaderManager::s_shaderManager = nullptr;
+
+ShaderManager::ShaderManager()
+    : m_debug(false)
+{
+}
+
+ShaderManager::~ShaderManager()
+{
+    qDeleteAll(m_shaderHash);
+}
+
+ShaderManager *ShaderManager::instance()
+{
+    if (!s_shaderManager) {
+        s_shaderManager = new ShaderManager();
+    }
+    return s_shaderManager;
+}
+
+GLShader *ShaderManager::pushShader(ShaderTraits traits)
+{
+    GLShader *shader = m_shaderHash.value(traits);
+    if (!shader) {
+        shader = new GLShader();
+        m_shaderHash.insert(traits, shader);
+    }
+    m_boundShaders.push(shader);
+    return shader;
+}
+
+void ShaderManager::popShader()
+{
+    m_boundShaders.pop();
+}
+
+GLVertexBuffer::GLVertexBuffer(UsageHint hint)
+    : d(new GLVertexBufferPrivate)
+{
+    Q_UNUSED(hint)
+}
+
+GLVertexBuffer::~GLVertexBuffer()
+{
+    delete d;
+}
+
+GLVertexBuffer *GLVertexBuffer::streamingBuffer()
+{
+    static GLVertexBuffer buffer(Stream);
+    return &buffer;
+}
+
+void GLVertexBuffer::reset()
+{
+    d->vertices.clear();
+    d->texCoords.clear();
+}
+
+void GLVertexBuffer::setData(int numberVertices, int dim, const float *vertices, const float *texcoords)
+{
+    Q_ASSERT(dim == 2);
+    d->vertices = QVector<float>(numberVertices * 2);
+    std::copy(vertices, vertices + numberVertices * 2, d->vertices.begin());
+    d->texCoords = QVector<float>(numberVertices * 2);
+    std::copy(texcoords, texcoords + numberVertices * 2, d->texCoords.begin());
+}
+
+static QRectF boundingRect(const float *coords, int count)
+{
+    float left = coords[0];
+    float right = coords[0];
+    float top = coords[1];
+    float bottom = coords[1];
+    for (int i = 1; i < count; ++i) {
+        left = std::min(left, coords[i * 2]);
+        right = std::max(right, coords[i * 2]);
+        top = std::min(top, coords[i * 2 + 1]);
+        bottom = std::max(bottom, coords[i * 2 + 1]);
+    }
+    return QRectF(QPointF(left, top), QPointF(right, bottom));
+}
+
+void GLVertexBuffer::render(GLenum primitiveMode)
+{
+    Q_ASSERT(primitiveMode == GL_TRIANGLES);
+    Q_ASSERT(s_boundTexture);
+    Q_ASSERT(!s_targetTextures.isEmpty());
+    const QImage &source = s_boundTexture->image;
+    QPainter painter(&s_targetTextures.top()->image);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    // the vertices are in the pixels of the target and the projection is ignored
+    for (int first = 0; first + 6 <= d->vertices.count() / 2; first += 6) {
+        const QRectF to = boundingRect(d->vertices.constData() + first * 2, 6);
+        const QRectF from = boundingRect(d->texCoords.constData() + first * 2, 6);
+        painter.drawImage(to, source, QRectF(from.x() * source.width(), from.y() * source.height(),
+                                             from.width() * source.width(), from.height() * source.height()));
+    }
+}
+
+} // namespace
+
+QImage mockTextureImage(const KWin::GLTexture *texture)
+{
+    return KWin::texturePrivate(texture)->image;
+}
@@ -0,0 +1,37 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#ifndef MOCK_GLUTILS_H
+#define MOCK_GLUTILS_H
+
+#include <QImage>
+
+namespace KWin
+{
+class GLTexture;
+}
+
+/**
+ * The mocked GLTexture, GLRenderTarget and GLVertexBuffer keep the texture contents in a
+ * QImage, stored the way it would be in GL. Rendering only supports copying axis aligned
+ * rectangles made of two triangles from the bound texture into the render target.
+ **/
+QImage mockTextureImage(const KWin::GLTexture *texture);
+
+#endif
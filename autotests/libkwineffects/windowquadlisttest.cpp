@@ -18,6 +18,7 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 *********************************************************************/
 #include <kwineffects.h>
+#include <QMatrix4x4>
 #include <QTest>
 
 Q_DECLARE_METATYPE(KWin::WindowQuadList)
@@ -30,11 +31,30 @@ private Q_SLOTS:
     void testMakeGrid();
     void testMakeRegularGrid_data();
     void testMakeRegularGrid();
+    void testBufferMakeGrid_data();
+    void testBufferMakeGrid();
+    void testBufferMakeRegularGrid_data();
+    void testBufferMakeRegularGrid();
+    void testBufferSplit_data();
+    void testBufferSplit();
+    void testBufferTransform();
+    void testBufferInterleavedArrays_data();
+    void testBufferInterleavedArrays();
+    void benchmarkInterleavedArrays_data();
+    void benchmarkInterleavedArrays();
+    void benchmarkMakeGrid_data();
+    void benchmarkMakeGrid();
 
 private:
     KWin::WindowQuad makeQuad(const QRectF &rect);
+    // a window with a decoration and a shadow, split into a grid like the wobbly windows effect does
+    KWin::WindowQuadList makeWindow();
+    void compareQuads(const KWin::WindowQuadList &actual, const KWin::WindowQuadList &expected);
 };
 
+static const unsigned int s_triangles = 0x0004; // GL_TRIANGLES
+static const unsigned int s_quads = 0x0007; // GL_QUADS
+
 KWin::WindowQuad WindowQuadListTest::makeQuad(const QRectF &r)
 {
     KWin::WindowQuad quad(KWin::WindowQuadContents);
@@ -216,6 +236,207 @@ void WindowQuadListTest::testMakeRegularGrid()
     }
 }
 
+KWin::WindowQuadList WindowQuadListTest::makeWindow()
+{
+    KWin::WindowQuadList quads;
+    quads.append(makeQuad(QRectF(0, 0, 1000, 30)));
+    quads.append(makeQuad(QRectF(0, 30, 2, 700)));
+    quads.append(makeQuad(QRectF(998, 30, 2, 700)));
+    quads.append(makeQuad(QRectF(0, 730, 1000, 2)));
+    quads.append(makeQuad(QRectF(2, 30, 996, 700)));
+    return quads.makeGrid(32);
+}
+
+void WindowQuadListTest::compareQuads(const KWin::WindowQuadList &actual, const KWin::WindowQuadList &expected)
+{
+    QCOMPARE(actual.count(), expected.count());
+    for (int i = 0; i < actual.count(); ++i) {
+        QCOMPARE(actual.at(i).type(), expected.at(i).type());
+        QCOMPARE(actual.at(i).uvAxisSwapped(), expected.at(i).uvAxisSwapped());
+        for (int j = 0; j < 4; ++j) {
+            const KWin::WindowVertex &actualVertex = actual.at(i)[j];
+            const KWin::WindowVertex &expectedVertex = expected.at(i)[j];
+            QCOMPARE(float(actualVertex.x()), float(expectedVertex.x()));
+            QCOMPARE(float(actualVertex.y()), float(expectedVertex.y()));
+            QCOMPARE(float(actualVertex.u()), float(expectedVertex.u()));
+            QCOMPARE(float(actualVertex.v()), float(expectedVertex.v()));
+        }
+    }
+}
+
+void WindowQuadListTest::testBufferMakeGrid_data()
+{
+    testMakeGrid_data();
+}
+
+void WindowQuadListTest::testBufferMakeGrid()
+{
+    QFETCH(KWin::WindowQuadList, orig);
+    QFETCH(int, quadSize);
+    const KWin::WindowQuadBuffer buffer(orig);
+    QCOMPARE(buffer.count(), orig.count());
+    compareQuads(buffer.toList(), orig);
+    compareQuads(buffer.makeGrid(quadSize).toList(), orig.makeGrid(quadSize));
+}
+
+void WindowQuadListTest::testBufferMakeRegularGrid_data()
+{
+    testMakeRegularGrid_data();
+}
+
+void WindowQuadListTest::testBufferMakeRegularGrid()
+{
+    QFETCH(KWin::WindowQuadList, orig);
+    QFETCH(int, xSubdivisions);
+    QFETCH(int, ySubdivisions);
+    const KWin::WindowQuadBuffer buffer(orig);
+    compareQuads(buffer.makeRegularGrid(xSubdivisions, ySubdivisions).toList(), orig.makeRegularGrid(xSubdivisions, ySubdivisions));
+}
+
+void WindowQuadListTest::testBufferSplit_data()
+{
+    QTest::addColumn<bool>("uvSwapped");
+    QTest::addColumn<double>("position");
+
+    QTest::newRow("inside") << false << 5.0;
+    QTest::newRow("inside, swapped") << true << 5.0;
+    QTest::newRow("edge") << false << 0.0;
+    QTest::newRow("outside") << false << 20.0;
+}
+
+void WindowQuadListTest::testBufferSplit()
+{
+    QFETCH(bool, uvSwapped);
+    QFETCH(double, position);
+    KWin::WindowQuad quad(KWin::WindowQuadDecoration);
+    quad[ 0 ] = KWin::WindowVertex(0, 0, 10, 20);
+    quad[ 1 ] = KWin::WindowVertex(10, 0, 30, 20);
+    quad[ 2 ] = KWin::WindowVertex(10, 10, 30, 60);
+    quad[ 3 ] = KWin::WindowVertex(0, 10, 10, 60);
+    quad.setUVAxisSwapped(uvSwapped);
+    KWin::WindowQuadList list;
+    list << quad << makeQuad(QRectF(0, 10, 10, 4));
+
+    const KWin::WindowQuadBuffer buffer(list);
+    compareQuads(buffer.splitAtX(position).toList(), list.splitAtX(position));
+    compareQuads(buffer.splitAtY(position).toList(), list.splitAtY(position));
+}
+
+void WindowQuadListTest::testBufferTransform()
+{
+    KWin::WindowQuadBuffer buffer(makeWindow());
+    QMatrix4x4 matrix;
+    matrix.translate(100, 50);
+    matrix.scale(0.5, 2);
+    buffer.transform(matrix);
+
+    const KWin::WindowQuadList original = makeWindow();
+    const KWin::WindowQuadList transformed = buffer.toList();
+    QCOMPARE(transformed.count(), original.count());
+    for (int i = 0; i < original.count(); ++i) {
+        for (int j = 0; j < 4; ++j) {
+            const QPointF expected = matrix.map(QPointF(original.at(i)[j].x(), original.at(i)[j].y()));
+            QCOMPARE(float(transformed.at(i)[j].x()), float(expected.x()));
+            QCOMPARE(float(transformed.at(i)[j].y()), float(expected.y()));
+            QCOMPARE(float(transformed.at(i)[j].u()), float(original.at(i)[j].u()));
+        }
+    }
+}
+
+void WindowQuadListTest::testBufferInterleavedArrays_data()
+{
+    QTest::addColumn<unsigned int>("primitiveType");
+    QTest::addColumn<int>("verticesPerQuad");
+
+    QTest::newRow("quads") << s_quads << 4;
+    QTest::newRow("triangles") << s_triangles << 6;
+}
+
+void WindowQuadListTest::testBufferInterleavedArrays()
+{
+    QFETCH(unsigned int, primitiveType);
+    QFETCH(int, verticesPerQuad);
+    const KWin::WindowQuadList list = makeWindow();
+    const KWin::WindowQuadBuffer buffer(list);
+    QMatrix4x4 textureMatrix;
+    textureMatrix.scale(1.0 / 1000, 1.0 / 732);
+    textureMatrix.translate(0.5, 0.25);
+
+    QVector<KWin::GLVertex2D> expected(list.count() * verticesPerQuad);
+    QVector<KWin::GLVertex2D> actual(list.count() * verticesPerQuad);
+    list.makeInterleavedArrays(primitiveType, expected.data(), textureMatrix);
+    buffer.makeInterleavedArrays(primitiveType, actual.data(), textureMatrix);
+    for (int i = 0; i < expected.count(); ++i) {
+        QCOMPARE(actual.at(i).position, expected.at(i).position);
+        QCOMPARE(actual.at(i).texcoord, expected.at(i).texcoord);
+    }
+}
+
+void WindowQuadListTest::benchmarkInterleavedArrays_data()
+{
+    QTest::addColumn<bool>("soa");
+    QTest::addColumn<unsigned int>("primitiveType");
+
+    QTest::newRow("WindowQuadList, quads") << false << s_quads;
+    QTest::newRow("WindowQuadBuffer, quads") << true << s_quads;
+    QTest::newRow("WindowQuadList, triangles") << false << s_triangles;
+    QTest::newRow("WindowQuadBuffer, triangles") << true << s_triangles;
+}
+
+void WindowQuadListTest::benchmarkInterleavedArrays()
+{
+    // what the OpenGL scene does for every window in every frame
+    QFETCH(bool, soa);
+    QFETCH(unsigned int, primitiveType);
+    const KWin::WindowQuadList list = makeWindow();
+    QVector<KWin::GLVertex2D> vertices(list.count() * 6);
+    const QMatrix4x4 textureMatrix;
+
+    if (soa) {
+        KWin::WindowQuadBuffer buffer;
+        QBENCHMARK {
+            buffer.clear();
+            buffer.append(list);
+            buffer.makeInterleavedArrays(primitiveType, vertices.data(), textureMatrix);
+        }
+    } else {
+        QBENCHMARK {
+            KWin::WindowQuadList copy;
+            for (const KWin::WindowQuad &quad : list) {
+                copy.append(quad);
+            }
+            copy.makeInterleavedArrays(primitiveType, vertices.data(), textureMatrix);
+        }
+    }
+}
+
+void WindowQuadListTest::benchmarkMakeGrid_data()
+{
+    QTest::addColumn<bool>("soa");
+
+    QTest::newRow("WindowQuadList") << false;
+    QTest::newRow("WindowQuadBuffer") << true;
+}
+
+void WindowQuadListTest::benchmarkMakeGrid()
+{
+    QFETCH(bool, soa);
+    KWin::WindowQuadList list;
+    list.append(makeQuad(QRectF(0, 0, 1000, 30)));
+    list.append(makeQuad(QRectF(2, 30, 996, 700)));
+
+    if (soa) {
+        const KWin::WindowQuadBuffer buffer(list);
+        QBENCHMARK {
+            buffer.makeGrid(16);
+        }
+    } else {
+        QBENCHMARK {
+            list.makeGrid(16);
+        }
+    }
+}
+
 QTEST_MAIN(WindowQuadListTest)
 
 #include "windowquadlisttest.moc"
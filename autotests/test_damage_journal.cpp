@@ -0,0 +1,101 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "../platformsupport/scenes/opengl/damagejournal.h"
+
+#include <QTest>
+
+using namespace KWin;
+
+class DamageJournalTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testUndefinedBuffer();
+    void testAccumulate_data();
+    void testAccumulate();
+    void testWrapAround();
+    void testClear();
+};
+
+static const QRegion s_fallback(0, 0, 1000, 1000);
+
+void DamageJournalTest::testUndefinedBuffer()
+{
+    DamageJournal journal;
+    QCOMPARE(journal.count(), 0);
+    QCOMPARE(journal.accumulate(0, s_fallback), s_fallback);
+    QCOMPARE(journal.accumulate(1, s_fallback), s_fallback);
+
+    journal.add(QRegion(0, 0, 10, 10));
+    QCOMPARE(journal.accumulate(0, s_fallback), s_fallback);
+}
+
+void DamageJournalTest::testAccumulate_data()
+{
+    QTest::addColumn<int>("bufferAge");
+    QTest::addColumn<QRegion>("expected");
+
+    QTest::newRow("current") << 1 << QRegion();
+    QTest::newRow("previous") << 2 << QRegion(20, 0, 10, 10);
+    QTest::newRow("triple buffered") << 3 << (QRegion(20, 0, 10, 10) | QRegion(10, 0, 10, 10));
+    QTest::newRow("unknown") << 4 << s_fallback;
+}
+
+void DamageJournalTest::testAccumulate()
+{
+    DamageJournal journal;
+    journal.add(QRegion(0, 0, 10, 10));
+    journal.add(QRegion(10, 0, 10, 10));
+    journal.add(QRegion(20, 0, 10, 10));
+    QCOMPARE(journal.count(), 3);
+
+    QFETCH(int, bufferAge);
+    QTEST(journal.accumulate(bufferAge, s_fallback), "expected");
+}
+
+void DamageJournalTest::testWrapAround()
+{
+    DamageJournal journal(3);
+    for (int i = 0; i < 5; ++i) {
+        journal.add(QRegion(i * 10, 0, 10, 10));
+    }
+    QCOMPARE(journal.count(), 3);
+    QCOMPARE(journal.capacity(), 3);
+    QCOMPARE(journal.accumulate(2, s_fallback), QRegion(40, 0, 10, 10));
+    QCOMPARE(journal.accumulate(3, s_fallback), QRegion(30, 0, 20, 10));
+    QCOMPARE(journal.accumulate(4, s_fallback), s_fallback);
+}
+
+void DamageJournalTest::testClear()
+{
+    DamageJournal journal;
+    journal.add(QRegion(0, 0, 10, 10));
+    journal.add(QRegion(10, 0, 10, 10));
+    journal.clear();
+    QCOMPARE(journal.count(), 0);
+    QCOMPARE(journal.accumulate(1, s_fallback), s_fallback);
+
+    journal.add(QRegion(20, 0, 10, 10));
+    QCOMPARE(journal.accumulate(1, s_fallback), QRegion());
+    QCOMPARE(journal.accumulate(2, s_fallback), s_fallback);
+}
+
+QTEST_GUILESS_MAIN(DamageJournalTest)
+#include "test_damage_journal.moc"
@@ -0,0 +1,186 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "../effectprofiler.h"
+
+#include <QTest>
+
+using namespace KWin;
+
+static const qint64 s_micro = 1000;
+
+// the profiler only uses the pointers as keys
+static Effect *const s_blur = reinterpret_cast<Effect *>(quintptr(0x10));
+static Effect *const s_fade = reinterpret_cast<Effect *>(quintptr(0x20));
+
+static QString effectName(Effect *effect)
+{
+    if (effect == s_blur) {
+        return QStringLiteral("blur");
+    }
+    if (effect == s_fade) {
+        return QStringLiteral("fade");
+    }
+    return QString();
+}
+
+class EffectProfilerTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testInactive();
+    void testExclusiveTime();
+    void testFrames();
+    void testEffectsChanged();
+    void testHistogram();
+    void testSummary();
+};
+
+void EffectProfilerTest::testInactive()
+{
+    EffectProfiler profiler(effectName);
+    QVERIFY(!profiler.isActive());
+    profiler.enter(s_blur, 0);
+    profiler.leave(10 * s_micro);
+    QVERIFY(profiler.names().isEmpty());
+
+    profiler.start(false);
+    QVERIFY(profiler.isActive());
+    profiler.stop();
+    QVERIFY(!profiler.isActive());
+}
+
+void EffectProfilerTest::testExclusiveTime()
+{
+    EffectProfiler profiler(effectName);
+    profiler.start(false);
+
+    // blur calls into fade, which calls into the scene
+    profiler.enter(s_blur, 0);
+    profiler.enter(s_fade, 100 * s_micro);
+    profiler.enter(nullptr, 150 * s_micro);
+    profiler.leave(400 * s_micro);
+    profiler.leave(420 * s_micro);
+    // blur paints after the chain returned
+    profiler.leave(500 * s_micro);
+
+    QCOMPARE(profiler.names(), (QStringList{QStringLiteral("blur"), QStringLiteral("fade"), QStringLiteral("scene")}));
+    QCOMPARE(profiler.durations(QStringLiteral("blur"), EffectProfiler::Clock::Cpu), QVector<qint64>{180 * s_micro});
+    QCOMPARE(profiler.durations(QStringLiteral("fade"), EffectProfiler::Clock::Cpu), QVector<qint64>{70 * s_micro});
+    QCOMPARE(profiler.durations(QStringLiteral("scene"), EffectProfiler::Clock::Cpu), QVector<qint64>{250 * s_micro});
+    QVERIFY(profiler.durations(QStringLiteral("blur"), EffectProfiler::Clock::Gpu).isEmpty());
+    QVERIFY(profiler.durations(QStringLiteral("wobbly"), EffectProfiler::Clock::Cpu).isEmpty());
+}
+
+void EffectProfilerTest::testFrames()
+{
+    EffectProfiler profiler(effectName);
+    profiler.start(false);
+
+    // one effect call per window sums up in the frame
+    profiler.enter(nullptr, 0);
+    for (int i = 0; i < 3; ++i) {
+        profiler.enter(s_blur, (100 * i + 10) * s_micro);
+        profiler.leave((100 * i + 30) * s_micro);
+    }
+    profiler.leave(1000 * s_micro);
+
+    // a frame without blur
+    profiler.enter(nullptr, 2000 * s_micro);
+    profiler.leave(2500 * s_micro);
+
+    QCOMPARE(profiler.durations(QStringLiteral("blur"), EffectProfiler::Clock::Cpu), QVector<qint64>{60 * s_micro});
+    QCOMPARE(profiler.durations(QStringLiteral("scene"), EffectProfiler::Clock::Cpu), (QVector<qint64>{940 * s_micro, 500 * s_micro}));
+
+    // only the last frames are kept
+    for (int i = 0; i < EffectProfiler::s_capacity; ++i) {
+        profiler.enter(nullptr, 0);
+        profiler.leave(i);
+    }
+    const QVector<qint64> durations = profiler.durations(QStringLiteral("scene"), EffectProfiler::Clock::Cpu);
+    QCOMPARE(durations.count(), EffectProfiler::s_capacity);
+    QCOMPARE(durations.first(), qint64(0));
+    QCOMPARE(durations.last(), qint64(EffectProfiler::s_capacity - 1));
+
+    profiler.clear();
+    QVERIFY(profiler.names().isEmpty());
+}
+
+void EffectProfilerTest::testEffectsChanged()
+{
+    QString name = QStringLiteral("blur");
+    EffectProfiler profiler([&name] (Effect *) { return name; });
+    profiler.start(false);
+
+    profiler.enter(s_blur, 0);
+    profiler.leave(10 * s_micro);
+
+    // the pointer is looked up only once
+    name = QStringLiteral("fade");
+    profiler.enter(s_blur, 0);
+    profiler.leave(20 * s_micro);
+    QCOMPARE(profiler.names(), QStringList{QStringLiteral("blur")});
+
+    // but another effect could be loaded at the same address
+    profiler.effectsChanged();
+    profiler.enter(s_blur, 0);
+    profiler.leave(30 * s_micro);
+    QCOMPARE(profiler.names(), (QStringList{QStringLiteral("blur"), QStringLiteral("fade")}));
+    QCOMPARE(profiler.durations(QStringLiteral("blur"), EffectProfiler::Clock::Cpu), (QVector<qint64>{10 * s_micro, 20 * s_micro}));
+    QCOMPARE(profiler.durations(QStringLiteral("fade"), EffectProfiler::Clock::Cpu), QVector<qint64>{30 * s_micro});
+}
+
+void EffectProfilerTest::testHistogram()
+{
+    EffectProfiler profiler(effectName);
+    profiler.start(false);
+
+    const QVector<qint64> durations = {50, 100, 300, 900, 1500, 20000, 30000};
+    for (qint64 duration : durations) {
+        profiler.enter(s_blur, 0);
+        profiler.leave(duration * s_micro);
+    }
+
+    QCOMPARE(profiler.histogram(QStringLiteral("blur"), EffectProfiler::Clock::Cpu), (QVector<int>{1, 1, 1, 1, 1, 0, 0, 2}));
+    QCOMPARE(profiler.histogram(QStringLiteral("blur"), EffectProfiler::Clock::Gpu), (QVector<int>{0, 0, 0, 0, 0, 0, 0, 0}));
+}
+
+void EffectProfilerTest::testSummary()
+{
+    EffectProfiler profiler(effectName);
+    QVERIFY(profiler.summary().isEmpty());
+    profiler.start(false);
+
+    for (int i = 1; i <= 100; ++i) {
+        profiler.enter(s_fade, 0);
+        profiler.leave(i * s_micro);
+    }
+
+    const QVariantMap summary = profiler.summary();
+    QCOMPARE(summary.value(QStringLiteral("fade.cpu.frames")).toInt(), 100);
+    QCOMPARE(summary.value(QStringLiteral("fade.cpu.p50")).toLongLong(), 50);
+    QCOMPARE(summary.value(QStringLiteral("fade.cpu.p95")).toLongLong(), 95);
+    QCOMPARE(summary.value(QStringLiteral("fade.cpu.p99")).toLongLong(), 99);
+    QCOMPARE(summary.value(QStringLiteral("fade.cpu.max")).toLongLong(), 100);
+    QCOMPARE(summary.value(QStringLiteral("fade.cpu.histogram")).toList().count(), 8);
+    QVERIFY(!summary.contains(QStringLiteral("fade.gpu.p50")));
+}
+
+QTEST_GUILESS_MAIN(EffectProfilerTest)
+#include "test_effect_profiler.moc"
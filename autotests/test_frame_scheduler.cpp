@@ -0,0 +1,147 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "../framescheduler.h"
+#include "../vblankclock.h"
+
+#include <QTest>
+
+using namespace KWin;
+
+static const qint64 s_milli = 1000 * 1000;
+
+class FrameSchedulerTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testNoSamples();
+    void testPercentile();
+    void testRollingWindow();
+    void testOverflowBucket();
+    void testPaintStart();
+    void testPaintStartTooLate();
+    void testPaintStartQueued();
+};
+
+void FrameSchedulerTest::testNoSamples()
+{
+    FrameScheduler scheduler;
+    QCOMPARE(scheduler.sampleCount(), 0);
+    QCOMPARE(scheduler.predictedPaintTime(), qint64(-1));
+
+    VBlankClock clock;
+    const qint64 before = VBlankClock::now();
+    const qint64 start = scheduler.nextPaintStart(&clock);
+    QVERIFY(start >= before);
+    QVERIFY(start <= VBlankClock::now());
+}
+
+void FrameSchedulerTest::testPercentile()
+{
+    FrameScheduler scheduler;
+    scheduler.setSafetyMargin(0);
+    // 61 fast frames and 3 slow ones, the slow ones are above the 95th percentile
+    for (int i = 0; i < 61; ++i) {
+        scheduler.addPaintTime(2 * s_milli + 100 * 1000);
+    }
+    for (int i = 0; i < 3; ++i) {
+        scheduler.addPaintTime(10 * s_milli);
+    }
+    QCOMPARE(scheduler.sampleCount(), 64);
+    QCOMPARE(scheduler.predictedPaintTime(), 2 * s_milli + 250 * 1000);
+
+    scheduler.setSafetyMargin(s_milli);
+    QCOMPARE(scheduler.predictedPaintTime(), 3 * s_milli + 250 * 1000);
+}
+
+void FrameSchedulerTest::testRollingWindow()
+{
+    FrameScheduler scheduler;
+    scheduler.setSafetyMargin(0);
+    for (int i = 0; i < FrameScheduler::s_windowSize; ++i) {
+        scheduler.addPaintTime(8 * s_milli);
+    }
+    QCOMPARE(scheduler.predictedPaintTime(), 8 * s_milli + 250 * 1000);
+    // once the window got replaced the old slow frames don't matter any more
+    for (int i = 0; i < FrameScheduler::s_windowSize; ++i) {
+        scheduler.addPaintTime(s_milli);
+    }
+    QCOMPARE(scheduler.sampleCount(), int(FrameScheduler::s_windowSize));
+    QCOMPARE(scheduler.predictedPaintTime(), s_milli + 250 * 1000);
+
+    scheduler.reset();
+    QCOMPARE(scheduler.sampleCount(), 0);
+    QCOMPARE(scheduler.predictedPaintTime(), qint64(-1));
+}
+
+void FrameSchedulerTest::testOverflowBucket()
+{
+    FrameScheduler scheduler;
+    scheduler.setSafetyMargin(0);
+    scheduler.addPaintTime(100 * s_milli);
+    scheduler.addPaintTime(120 * s_milli);
+    QCOMPARE(scheduler.predictedPaintTime(), 120 * s_milli);
+}
+
+void FrameSchedulerTest::testPaintStart()
+{
+    FrameScheduler scheduler;
+    scheduler.setSafetyMargin(0);
+    scheduler.addPaintTime(s_milli);
+
+    VBlankClock clock;
+    clock.setRefreshRate(60000);
+    // the last vblank just happened, we have plenty of time
+    clock.notifyVBlank(VBlankClock::now());
+    const qint64 start = scheduler.nextPaintStart(&clock);
+    QCOMPARE(start, clock.nextVBlank() - scheduler.predictedPaintTime());
+    QVERIFY(start > VBlankClock::now());
+}
+
+void FrameSchedulerTest::testPaintStartTooLate()
+{
+    FrameScheduler scheduler;
+    scheduler.setSafetyMargin(0);
+    scheduler.addPaintTime(10 * s_milli);
+
+    VBlankClock clock;
+    clock.setRefreshRate(60000);
+    // only 5 msec until the next vblank, so aim for the one after
+    const qint64 last = VBlankClock::now() - clock.refreshInterval() + 5 * s_milli;
+    clock.notifyVBlank(last);
+    const qint64 start = scheduler.nextPaintStart(&clock);
+    QCOMPARE(start, last + 2 * clock.refreshInterval() - scheduler.predictedPaintTime());
+}
+
+void FrameSchedulerTest::testPaintStartQueued()
+{
+    FrameScheduler scheduler;
+    scheduler.setSafetyMargin(0);
+    scheduler.addPaintTime(s_milli);
+
+    VBlankClock clock;
+    clock.setRefreshRate(60000);
+    clock.notifyVBlank(VBlankClock::now());
+    // the next vblank is taken by the frame waiting for scanout
+    const qint64 start = scheduler.nextPaintStart(&clock, 1);
+    QCOMPARE(start, clock.nextVBlank() + clock.refreshInterval() - scheduler.predictedPaintTime());
+}
+
+QTEST_GUILESS_MAIN(FrameSchedulerTest)
+#include "test_frame_scheduler.moc"
@@ -0,0 +1,235 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "../frametelemetry.h"
+#include "../vblankclock.h"
+
+#include <QDataStream>
+#include <QTest>
+
+using namespace KWin;
+
+static const qint64 s_micro = 1000;
+
+class FrameTelemetryTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testRecordFrame();
+    void testAbortFrame();
+    void testRingBuffer();
+    void testPresented();
+    void testPresentedQueued();
+    void testSummary();
+    void testDump();
+};
+
+void FrameTelemetryTest::testRecordFrame()
+{
+    FrameTelemetry telemetry;
+    QCOMPARE(telemetry.frameCount(), 0);
+    QVERIFY(!telemetry.isRecording());
+
+    const qint64 before = VBlankClock::now();
+    telemetry.beginFrame(1, before - 100, before);
+    QVERIFY(telemetry.isRecording());
+    telemetry.enterPhase(FrameTelemetry::Phase::PrePaint);
+    telemetry.enterPhase(FrameTelemetry::Phase::Paint);
+    telemetry.enterPhase(FrameTelemetry::Phase::Swap);
+    telemetry.endFrame();
+    const qint64 after = VBlankClock::now();
+    QVERIFY(!telemetry.isRecording());
+
+    const auto frames = telemetry.frames();
+    QCOMPARE(frames.count(), 1);
+    const FrameTiming &frame = frames.first();
+    QCOMPARE(frame.screen, qint64(1));
+    QCOMPARE(frame.scheduled, before - 100);
+    QCOMPARE(frame.target, before);
+    QVERIFY(frame.start >= before);
+    QVERIFY(frame.damageDuration >= 0);
+    QVERIFY(frame.prePaintDuration >= 0);
+    QVERIFY(frame.paintDuration >= 0);
+    QVERIFY(frame.swapDuration >= 0);
+    QVERIFY(frame.start + frame.damageDuration + frame.prePaintDuration + frame.paintDuration + frame.swapDuration <= after);
+    QCOMPARE(frame.presented, qint64(0));
+
+    // phases outside of a frame are ignored
+    telemetry.enterPhase(FrameTelemetry::Phase::Paint);
+    telemetry.endFrame();
+    QCOMPARE(telemetry.frameCount(), 1);
+}
+
+void FrameTelemetryTest::testAbortFrame()
+{
+    FrameTelemetry telemetry;
+    telemetry.beginFrame(-1, 0, 0);
+    telemetry.abortFrame();
+    QVERIFY(!telemetry.isRecording());
+    telemetry.endFrame();
+    QCOMPARE(telemetry.frameCount(), 0);
+}
+
+void FrameTelemetryTest::testRingBuffer()
+{
+    FrameTelemetry telemetry;
+    for (int i = 0; i < FrameTelemetry::s_capacity + 10; ++i) {
+        FrameTiming frame;
+        frame.start = i + 1;
+        telemetry.addFrame(frame);
+    }
+    QCOMPARE(telemetry.frameCount(), FrameTelemetry::s_capacity);
+    const auto frames = telemetry.frames();
+    QCOMPARE(frames.count(), FrameTelemetry::s_capacity);
+    // the oldest ones got replaced
+    QCOMPARE(frames.first().start, qint64(11));
+    QCOMPARE(frames.last().start, qint64(FrameTelemetry::s_capacity + 10));
+
+    telemetry.clear();
+    QCOMPARE(telemetry.frameCount(), 0);
+    QVERIFY(telemetry.frames().isEmpty());
+}
+
+void FrameTelemetryTest::testPresented()
+{
+    FrameTelemetry telemetry;
+    FrameTiming frame;
+    frame.screen = 0;
+    frame.start = 100;
+    telemetry.addFrame(frame);
+    frame.screen = 1;
+    frame.start = 200;
+    telemetry.addFrame(frame);
+    frame.screen = 0;
+    frame.start = 300;
+    telemetry.addFrame(frame);
+
+    // a presentation before the start of the last frame belongs to the frame before
+    telemetry.notifyPresented(0, 250);
+    auto frames = telemetry.frames();
+    QCOMPARE(frames.at(0).presented, qint64(250));
+    QCOMPARE(frames.at(1).presented, qint64(0));
+    QCOMPARE(frames.at(2).presented, qint64(0));
+
+    telemetry.notifyPresented(0, 350);
+    telemetry.notifyPresented(1, 360);
+    // an invalid timestamp is ignored
+    telemetry.notifyPresented(1, 0);
+    frames = telemetry.frames();
+    QCOMPARE(frames.at(0).presented, qint64(250));
+    QCOMPARE(frames.at(1).presented, qint64(360));
+    QCOMPARE(frames.at(2).presented, qint64(350));
+
+    // the last frame got presented already, don't touch it again
+    telemetry.notifyPresented(0, 400);
+    QCOMPARE(telemetry.frames().at(2).presented, qint64(350));
+}
+
+void FrameTelemetryTest::testPresentedQueued()
+{
+    FrameTelemetry telemetry;
+    FrameTiming frame;
+    frame.screen = 0;
+    frame.start = 100;
+    telemetry.addFrame(frame);
+    frame.start = 200;
+    telemetry.addFrame(frame);
+
+    // the second frame got rendered while the first one waited for the page flip
+    telemetry.notifyPresented(0, 250, 1);
+    auto frames = telemetry.frames();
+    QCOMPARE(frames.at(0).presented, qint64(250));
+    QCOMPARE(frames.at(1).presented, qint64(0));
+
+    telemetry.notifyPresented(0, 266);
+    frames = telemetry.frames();
+    QCOMPARE(frames.at(0).presented, qint64(250));
+    QCOMPARE(frames.at(1).presented, qint64(266));
+}
+
+void FrameTelemetryTest::testSummary()
+{
+    FrameTelemetry telemetry;
+    QCOMPARE(telemetry.summary().value(QStringLiteral("frames")).toInt(), 0);
+    QVERIFY(!telemetry.summary().contains(QStringLiteral("paint.p50")));
+
+    for (int i = 1; i <= 100; ++i) {
+        FrameTiming frame;
+        frame.start = 1000 * s_micro;
+        frame.target = 990 * s_micro;
+        frame.damageDuration = 10 * s_micro;
+        frame.prePaintDuration = 20 * s_micro;
+        frame.paintDuration = i * s_micro;
+        frame.swapDuration = 30 * s_micro;
+        // only every second frame got presented
+        if (i % 2 == 0) {
+            frame.presented = frame.start + 2 * i * s_micro;
+        }
+        telemetry.addFrame(frame);
+    }
+    const QVariantMap summary = telemetry.summary();
+    QCOMPARE(summary.value(QStringLiteral("frames")).toInt(), 100);
+    QCOMPARE(summary.value(QStringLiteral("damage.p50")).toLongLong(), 10);
+    QCOMPARE(summary.value(QStringLiteral("prePaint.max")).toLongLong(), 20);
+    QCOMPARE(summary.value(QStringLiteral("paint.p50")).toLongLong(), 50);
+    QCOMPARE(summary.value(QStringLiteral("paint.p95")).toLongLong(), 95);
+    QCOMPARE(summary.value(QStringLiteral("paint.p99")).toLongLong(), 99);
+    QCOMPARE(summary.value(QStringLiteral("paint.max")).toLongLong(), 100);
+    QCOMPARE(summary.value(QStringLiteral("swap.p95")).toLongLong(), 30);
+    QCOMPARE(summary.value(QStringLiteral("total.p50")).toLongLong(), 110);
+    QCOMPARE(summary.value(QStringLiteral("wakeupDelay.p50")).toLongLong(), 10);
+    // 50 presented frames with latencies 4, 8, ..., 200
+    QCOMPARE(summary.value(QStringLiteral("latency.p50")).toLongLong(), 100);
+    QCOMPARE(summary.value(QStringLiteral("latency.max")).toLongLong(), 200);
+}
+
+void FrameTelemetryTest::testDump()
+{
+    FrameTelemetry telemetry;
+    FrameTiming frame;
+    frame.screen = 2;
+    frame.scheduled = 1;
+    frame.target = 2;
+    frame.start = 3;
+    frame.damageDuration = 4;
+    frame.prePaintDuration = 5;
+    frame.paintDuration = 6;
+    frame.swapDuration = 7;
+    frame.presented = 8;
+    telemetry.addFrame(frame);
+
+    const QByteArray data = telemetry.dump();
+    QCOMPARE(data.size(), int(3 * sizeof(quint32) + sizeof(FrameTiming)));
+
+    QDataStream stream(data);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    quint32 version, fields, count;
+    stream >> version >> fields >> count;
+    QCOMPARE(version, FrameTelemetry::s_dumpVersion);
+    QCOMPARE(fields, quint32(9));
+    QCOMPARE(count, quint32(1));
+    QVector<qint64> values(fields);
+    for (quint32 i = 0; i < fields; ++i) {
+        stream >> values[i];
+    }
+    QCOMPARE(values, (QVector<qint64>{2, 1, 2, 3, 4, 5, 6, 7, 8}));
+}
+
+QTEST_GUILESS_MAIN(FrameTelemetryTest)
+#include "test_frame_telemetry.moc"
@@ -0,0 +1,261 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "../rectregion.h"
+
+#include <QRandomGenerator>
+#include <QTest>
+
+using namespace KWin;
+
+Q_DECLARE_METATYPE(QVector<QRect>)
+
+static QRegion toQRegion(const QVector<QRect> &rects)
+{
+    QRegion region;
+    for (const QRect &rect : rects) {
+        region |= rect;
+    }
+    return region;
+}
+
+static RectRegion toRectRegion(const QVector<QRect> &rects)
+{
+    RectRegion region;
+    for (const QRect &rect : rects) {
+        region |= rect;
+    }
+    return region;
+}
+
+// the windows of a busy desktop, topmost first
+static QVector<QRect> windowStack(int count)
+{
+    QRandomGenerator random(42);
+    QVector<QRect> windows;
+    windows.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const int x = random.bounded(1600);
+        const int y = random.bounded(800);
+        windows << QRect(x, y, 200 + random.bounded(1000), 150 + random.bounded(700));
+    }
+    return windows;
+}
+
+class RectRegionTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testEmpty();
+    void testOperations_data();
+    void testOperations();
+    void testCoalesce();
+    void testContains();
+    void testRandom();
+    void benchmarkOcclusion_data();
+    void benchmarkOcclusion();
+};
+
+void RectRegionTest::testEmpty()
+{
+    RectRegion region;
+    QVERIFY(region.isEmpty());
+    QCOMPARE(region.rectCount(), 0);
+    QCOMPARE(region.boundingRect(), QRect());
+    QVERIFY(region.toRegion().isEmpty());
+    QVERIFY(region.contains(QRect()));
+    QVERIFY(!region.contains(QRect(0, 0, 1, 1)));
+    QVERIFY(!region.intersects(QRect(0, 0, 1, 1)));
+
+    region.setRect(QRect(0, 0, 0, 10));
+    QVERIFY(region.isEmpty());
+    region |= QRect(10, 10, 10, 10);
+    region -= RectRegion(QRect(0, 0, 100, 100));
+    QVERIFY(region.isEmpty());
+}
+
+void RectRegionTest::testOperations_data()
+{
+    QTest::addColumn<QVector<QRect>>("a");
+    QTest::addColumn<QVector<QRect>>("b");
+
+    QTest::newRow("disjoint") << QVector<QRect>{QRect(0, 0, 10, 10)} << QVector<QRect>{QRect(20, 20, 10, 10)};
+    QTest::newRow("below") << QVector<QRect>{QRect(0, 0, 10, 10)} << QVector<QRect>{QRect(0, 10, 10, 10)};
+    QTest::newRow("beside") << QVector<QRect>{QRect(0, 0, 10, 10)} << QVector<QRect>{QRect(10, 0, 10, 10)};
+    QTest::newRow("overlap") << QVector<QRect>{QRect(0, 0, 10, 10)} << QVector<QRect>{QRect(5, 5, 10, 10)};
+    QTest::newRow("inside") << QVector<QRect>{QRect(0, 0, 100, 100)} << QVector<QRect>{QRect(10, 10, 10, 10)};
+    QTest::newRow("covering") << QVector<QRect>{QRect(10, 10, 10, 10)} << QVector<QRect>{QRect(0, 0, 100, 100)};
+    QTest::newRow("cross") << QVector<QRect>{QRect(0, 40, 100, 20)} << QVector<QRect>{QRect(40, 0, 20, 100)};
+    QTest::newRow("frame") << QVector<QRect>{QRect(0, 0, 100, 10), QRect(0, 90, 100, 10), QRect(0, 0, 10, 100), QRect(90, 0, 10, 100)}
+                           << QVector<QRect>{QRect(5, 5, 90, 90)};
+    QTest::newRow("windows") << windowStack(8) << windowStack(3);
+}
+
+void RectRegionTest::testOperations()
+{
+    QFETCH(QVector<QRect>, a);
+    QFETCH(QVector<QRect>, b);
+    const QRegion qa = toQRegion(a);
+    const QRegion qb = toQRegion(b);
+    const RectRegion ra = toRectRegion(a);
+    const RectRegion rb = toRectRegion(b);
+
+    QCOMPARE(ra.toRegion(), qa);
+    QCOMPARE(ra.boundingRect(), qa.boundingRect());
+    QCOMPARE((ra | rb).toRegion(), qa | qb);
+    QCOMPARE((rb | ra).toRegion(), qa | qb);
+    QCOMPARE((ra - rb).toRegion(), qa - qb);
+    QCOMPARE((rb - ra).toRegion(), qb - qa);
+    QCOMPARE((ra & rb).toRegion(), qa & qb);
+    QCOMPARE((rb & ra).toRegion(), qa & qb);
+    QCOMPARE(RectRegion(qa), ra);
+}
+
+void RectRegionTest::testCoalesce()
+{
+    // two rects forming one rect again
+    RectRegion region(QRect(0, 0, 10, 10));
+    region |= QRect(0, 10, 10, 10);
+    QCOMPARE(region.rectCount(), 1);
+    QCOMPARE(region.boundingRect(), QRect(0, 0, 10, 20));
+
+    region |= QRect(10, 0, 10, 20);
+    QCOMPARE(region.rectCount(), 1);
+    QCOMPARE(region.boundingRect(), QRect(0, 0, 20, 20));
+
+    // filling a hole
+    region -= RectRegion(QRect(5, 5, 10, 10));
+    QCOMPARE(region.rectCount(), 4);
+    region |= QRect(5, 5, 10, 10);
+    QCOMPARE(region.rectCount(), 1);
+    QCOMPARE(region, RectRegion(QRect(0, 0, 20, 20)));
+}
+
+void RectRegionTest::testContains()
+{
+    RectRegion region(QRect(0, 0, 100, 100));
+    region -= RectRegion(QRect(40, 40, 20, 20));
+    QVERIFY(region.contains(QRect(0, 0, 100, 40)));
+    QVERIFY(region.contains(QRect(0, 0, 40, 100)));
+    QVERIFY(!region.contains(QRect(0, 0, 41, 100)));
+    QVERIFY(!region.contains(QRect(0, 0, 101, 10)));
+    QVERIFY(!region.contains(QRect(50, 50, 1, 1)));
+    QVERIFY(region.intersects(QRect(50, 50, 20, 20)));
+    QVERIFY(!region.intersects(QRect(45, 45, 10, 10)));
+    QVERIFY(!region.intersects(QRect(100, 0, 10, 10)));
+
+    QVERIFY(region.contains(RectRegion(QRect(0, 0, 10, 10)) | RectRegion(QRect(90, 90, 10, 10))));
+    QVERIFY(!region.contains(RectRegion(QRect(0, 0, 10, 10)) | RectRegion(QRect(45, 45, 10, 10))));
+
+    // bands with a gap in between
+    RectRegion split(QRect(0, 0, 10, 10));
+    split |= QRect(0, 20, 10, 10);
+    QVERIFY(!split.contains(QRect(0, 0, 10, 30)));
+    QVERIFY(split.contains(QRect(0, 20, 10, 10)));
+}
+
+void RectRegionTest::testRandom()
+{
+    QRandomGenerator random(7);
+    auto randomRects = [&random] {
+        QVector<QRect> rects;
+        const int count = random.bounded(6);
+        for (int i = 0; i < count; ++i) {
+            rects << QRect(random.bounded(64), random.bounded(64), 1 + random.bounded(64), 1 + random.bounded(64));
+        }
+        return rects;
+    };
+    for (int i = 0; i < 2000; ++i) {
+        const QVector<QRect> a = randomRects();
+        const QVector<QRect> b = randomRects();
+        const QRegion qa = toQRegion(a);
+        const QRegion qb = toQRegion(b);
+        const RectRegion ra = toRectRegion(a);
+        const RectRegion rb = toRectRegion(b);
+        QCOMPARE((ra | rb).toRegion(), qa | qb);
+        QCOMPARE((ra - rb).toRegion(), qa - qb);
+        QCOMPARE((ra & rb).toRegion(), qa & qb);
+        const QRect probe(random.bounded(64), random.bounded(64), 1 + random.bounded(32), 1 + random.bounded(32));
+        QCOMPARE(ra.contains(probe), (QRegion(probe) - qa).isEmpty());
+        QCOMPARE(ra.intersects(probe), qa.intersects(probe));
+    }
+}
+
+void RectRegionTest::benchmarkOcclusion_data()
+{
+    QTest::addColumn<bool>("qregion");
+    QTest::addColumn<int>("windows");
+
+    QTest::newRow("QRegion, 10 windows") << true << 10;
+    QTest::newRow("RectRegion, 10 windows") << false << 10;
+    QTest::newRow("QRegion, 50 windows") << true << 50;
+    QTest::newRow("RectRegion, 50 windows") << false << 50;
+}
+
+void RectRegionTest::benchmarkOcclusion()
+{
+    // the occlusion pass of Scene::paintSimpleScreen for a partial repaint
+    QFETCH(bool, qregion);
+    QFETCH(int, windows);
+    const QVector<QRect> stack = windowStack(windows);
+    const QRect damage(300, 200, 800, 600);
+
+    if (qregion) {
+        QBENCHMARK {
+            QRegion allClips;
+            QRegion upperTranslucentDamage;
+            for (int i = 0; i < stack.count(); ++i) {
+                QRegion region(damage);
+                region |= upperTranslucentDamage;
+                region -= allClips;
+                if (i % 3) {
+                    // opaque
+                    allClips |= stack.at(i);
+                    upperTranslucentDamage |= region - stack.at(i);
+                } else {
+                    upperTranslucentDamage |= region;
+                }
+            }
+        }
+    } else {
+        RectRegion allClips;
+        RectRegion upperTranslucentDamage;
+        RectRegion region;
+        RectRegion clip;
+        QBENCHMARK {
+            allClips.clear();
+            upperTranslucentDamage.clear();
+            for (int i = 0; i < stack.count(); ++i) {
+                region.setRect(damage);
+                region |= upperTranslucentDamage;
+                region -= allClips;
+                if (i % 3) {
+                    clip.setRect(stack.at(i));
+                    allClips |= clip;
+                    upperTranslucentDamage |= region - clip;
+                } else {
+                    upperTranslucentDamage |= region;
+                }
+            }
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(RectRegionTest)
+#include "test_rect_region.moc"
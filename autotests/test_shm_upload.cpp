@@ -0,0 +1,133 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "../platformsupport/scenes/opengl/shm_upload.h"
+
+#include <QTest>
+
+using namespace KWin;
+
+Q_DECLARE_METATYPE(QVector<QRect>)
+
+static int bytes(const QRect &rect)
+{
+    return rect.width() * rect.height() * 4;
+}
+
+// what was copied for a commit before uploading straight from the shm buffer:
+// an RGB32 buffer got converted as a whole, then each damage rect got copied out
+// of the converted image and uploaded from there
+static int legacyBytes(const QRegion &damage, const QSize &size, bool opaque)
+{
+    int total = opaque ? bytes(QRect(QPoint(0, 0), size)) : 0;
+    for (const QRect &rect : damage) {
+        total += 2 * bytes(rect);
+    }
+    return total;
+}
+
+class ShmUploadTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testRects_data();
+    void testRects();
+    void testScale();
+    void benchmarkBytesPerCommit_data();
+    void benchmarkBytesPerCommit();
+};
+
+void ShmUploadTest::testRects_data()
+{
+    QTest::addColumn<QVector<QRect>>("damage");
+    QTest::addColumn<QVector<QRect>>("expected");
+
+    QTest::newRow("empty") << QVector<QRect>() << QVector<QRect>();
+    QTest::newRow("single") << QVector<QRect>{QRect(10, 10, 100, 100)} << QVector<QRect>{QRect(10, 10, 100, 100)};
+    QTest::newRow("clipped") << QVector<QRect>{QRect(900, 700, 400, 400)} << QVector<QRect>{QRect(900, 700, 124, 68)};
+    QTest::newRow("outside") << QVector<QRect>{QRect(2000, 0, 10, 10)} << QVector<QRect>();
+    // the glyphs of a line of text
+    QTest::newRow("glyphs") << QVector<QRect>{QRect(10, 10, 8, 16), QRect(20, 10, 8, 16), QRect(30, 10, 8, 16)}
+                            << QVector<QRect>{QRect(10, 10, 28, 16)};
+    QTest::newRow("far apart") << QVector<QRect>{QRect(0, 0, 100, 100), QRect(900, 600, 100, 100)}
+                               << QVector<QRect>{QRect(0, 0, 100, 100), QRect(900, 600, 100, 100)};
+}
+
+void ShmUploadTest::testRects()
+{
+    QFETCH(QVector<QRect>, damage);
+    QRegion region;
+    for (const QRect &rect : damage) {
+        region |= rect;
+    }
+    QTEST(shmUploadRects(region, 1, QRect(0, 0, 1024, 768)), "expected");
+}
+
+void ShmUploadTest::testScale()
+{
+    const QVector<QRect> rects = shmUploadRects(QRegion(10, 20, 30, 40), 2, QRect(0, 0, 2048, 1536));
+    QCOMPARE(rects, QVector<QRect>{QRect(20, 40, 60, 80)});
+}
+
+void ShmUploadTest::benchmarkBytesPerCommit_data()
+{
+    QTest::addColumn<QVector<QRect>>("damage");
+    QTest::addColumn<bool>("opaque");
+
+    const QVector<QRect> cursor{QRect(200, 300, 8, 16)};
+    QVector<QRect> typing;
+    for (int i = 0; i < 20; ++i) {
+        typing << QRect(10 + i * 9, 300, 8, 16);
+    }
+    const QVector<QRect> scroll{QRect(0, 40, 1280, 680)};
+
+    QTest::newRow("cursor") << cursor << false;
+    QTest::newRow("cursor/opaque") << cursor << true;
+    QTest::newRow("typing") << typing << false;
+    QTest::newRow("typing/opaque") << typing << true;
+    QTest::newRow("scroll") << scroll << false;
+    QTest::newRow("scroll/opaque") << scroll << true;
+}
+
+void ShmUploadTest::benchmarkBytesPerCommit()
+{
+    QFETCH(QVector<QRect>, damage);
+    QFETCH(bool, opaque);
+    const QSize size(1280, 720);
+    QRegion region;
+    for (const QRect &rect : damage) {
+        region |= rect;
+    }
+
+    QVector<QRect> rects;
+    QBENCHMARK {
+        rects = shmUploadRects(region, 1, QRect(QPoint(0, 0), size));
+    }
+
+    int total = 0;
+    for (const QRect &rect : rects) {
+        total += bytes(rect);
+    }
+    QVERIFY(total <= legacyBytes(region, size, opaque));
+    // QTest has no metric for copied memory, the closest one is used to report it
+    QTest::setBenchmarkResult(total, QTest::BytesAllocated);
+}
+
+QTEST_GUILESS_MAIN(ShmUploadTest)
+#include "test_shm_upload.moc"
@@ -0,0 +1,120 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "../vblankclock.h"
+
+#include <QTest>
+#include <QSignalSpy>
+
+using namespace KWin;
+
+class VBlankClockTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testRefreshInterval_data();
+    void testRefreshInterval();
+    void testSoftwareClock();
+    void testPrediction();
+    void testWakeup();
+    void testCancelWakeup();
+};
+
+void VBlankClockTest::testRefreshInterval_data()
+{
+    QTest::addColumn<int>("refreshRate");
+    QTest::addColumn<qint64>("interval");
+
+    QTest::newRow("60Hz") << 60000 << qint64(16666666);
+    QTest::newRow("144Hz") << 144000 << qint64(6944444);
+    QTest::newRow("59.94Hz") << 59940 << qint64(16683350);
+}
+
+void VBlankClockTest::testRefreshInterval()
+{
+    VBlankClock clock;
+    QFETCH(int, refreshRate);
+    clock.setRefreshRate(refreshRate);
+    QCOMPARE(clock.refreshRate(), refreshRate);
+    QTEST(clock.refreshInterval(), "interval");
+}
+
+void VBlankClockTest::testSoftwareClock()
+{
+    VBlankClock clock;
+    QVERIFY(!clock.isHardwareBacked());
+    const qint64 before = VBlankClock::now();
+    const qint64 next = clock.nextVBlank();
+    QVERIFY(next > before);
+    QVERIFY(next <= VBlankClock::now() + clock.refreshInterval());
+    // the phase stays stable
+    QCOMPARE((clock.nextVBlank() - next) % clock.refreshInterval(), qint64(0));
+}
+
+void VBlankClockTest::testPrediction()
+{
+    VBlankClock clock;
+    clock.setRefreshRate(100000);
+    const qint64 interval = clock.refreshInterval();
+    const qint64 last = VBlankClock::now() - 3 * interval - interval / 2;
+    QCOMPARE(clock.lastSequence(), quint64(0));
+    clock.notifyVBlank(last, 42);
+    QVERIFY(clock.isHardwareBacked());
+    QCOMPARE(clock.lastVBlank(), last);
+    QCOMPARE(clock.lastSequence(), quint64(42));
+    QCOMPARE(clock.nextVBlank(), last + 4 * interval);
+
+    // invalid timestamps are ignored
+    clock.notifyVBlank(0, 43);
+    QCOMPARE(clock.lastVBlank(), last);
+    QCOMPARE(clock.lastSequence(), quint64(42));
+}
+
+void VBlankClockTest::testWakeup()
+{
+    VBlankClock clock;
+    QSignalSpy wakeupSpy(&clock, &VBlankClock::wakeup);
+    QVERIFY(wakeupSpy.isValid());
+
+    clock.scheduleWakeup(VBlankClock::now() + 5 * 1000 * 1000);
+    QVERIFY(clock.isWakeupScheduled());
+    QVERIFY(wakeupSpy.wait(500));
+    QCOMPARE(wakeupSpy.count(), 1);
+    QVERIFY(!clock.isWakeupScheduled());
+
+    // a target in the past wakes up immediately
+    clock.scheduleWakeup(VBlankClock::now() - 1000);
+    QVERIFY(wakeupSpy.wait(500));
+    QCOMPARE(wakeupSpy.count(), 2);
+}
+
+void VBlankClockTest::testCancelWakeup()
+{
+    VBlankClock clock;
+    QSignalSpy wakeupSpy(&clock, &VBlankClock::wakeup);
+    QVERIFY(wakeupSpy.isValid());
+
+    clock.scheduleWakeup(VBlankClock::now() + 5 * 1000 * 1000);
+    clock.cancelWakeup();
+    QVERIFY(!clock.isWakeupScheduled());
+    QVERIFY(!wakeupSpy.wait(50));
+}
+
+QTEST_GUILESS_MAIN(VBlankClockTest)
+#include "test_vblank_clock.moc"
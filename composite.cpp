@@ -19,6 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 *********************************************************************/
 #include "composite.h"
 
+#include "abstract_output.h"
 #include "dbusinterface.h"
 #include "utils.h"
 #include <QTextStream>
@@ -34,7 +35,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "useractions.h"
 #include "xcbutils.h"
 #include "platform.h"
+#include "presentationtime.h"
 #include "shell_client.h"
+#include "vblankclock.h"
 #include "wayland_server.h"
 #include "decorations/decoratedclient.h"
 
@@ -60,15 +63,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <xcb/composite.h>
 #include <xcb/damage.h>
-#include <fcntl.h>
-#include <unistd.h>
-#include <sys/ioctl.h>
-#include <libdrm/drm.h>
-
-#include <sys/stat.h>
-#define drmcard "/dev/dri/card0"
-
-int dri_fd;
 
 Q_DECLARE_METATYPE(KWin::Compositor::SuspendReason)
 
@@ -77,8 +71,6 @@ namespace KWin
 
 extern int currentRefreshRate();
 
-int LastPaintFree;
-
 CompositorSelectionOwner::CompositorSelectionOwner(const char *selection) : KSelectionOwner(selection, connection(), rootWindow()), owning(false)
 {
     connect (this, SIGNAL(lostOwnership()), SLOT(looseOwnership()));
@@ -328,6 +320,7 @@ void Compositor::startupWithWorkspace()
     } else
         vBlankInterval = milliToNano(1); // no sync - DO NOT set "0", would cause div-by-zero segfaults.
     m_timeSinceLastVBlank = fpsInterval - (options->vBlankTime() + 1); // means "start now" - we don't have even a slight idea when the first vsync will occur
+    setupOutputRepaintLoops();
     scheduleRepaint();
     kwinApp()->platform()->createEffectsHandler(this, m_scene);   // sets also the 'effects' pointer
     connect(Workspace::self(), &Workspace::deletedRemoved, m_scene, &Scene::windowDeleted);
@@ -363,7 +356,12 @@ void Compositor::startupWithWorkspace()
         m_releaseSelectionTimer.stop();
     }
 
-    dri_fd=open(drmcard,O_RDWR);
+    if (kwinApp()->platform()->enabledOutputs().isEmpty()) {
+        // the platform provides a software clock, it needs to know the refresh rate
+        kwinApp()->platform()->vblankClock()->setRefreshRate(m_xrrRefreshRate * 1000);
+    }
+    // paint times of a previous scene are meaningless for the new one
+    m_frameScheduler.reset();
 
     // render at least once
     performCompositing();
@@ -371,6 +369,10 @@ void Compositor::startupWithWorkspace()
 
 void Compositor::scheduleRepaint()
 {
+    if (m_perOutputRepaint) {
+        scheduleOutputRepaints();
+        return;
+    }
     if (!compositeTimer.isActive())
         setCompositeTimer();
 }
@@ -421,6 +423,15 @@ void Compositor::finish()
     delete m_scene;
     m_scene = NULL;
     compositeTimer.stop();
+    if (m_vblankClock) {
+        m_vblankClock->cancelWakeup();
+    }
+    m_waitingForVBlank = false;
+    while (!m_outputLoops.isEmpty()) {
+        destroyOutputRepaintLoop(m_outputLoops.constBegin().key());
+    }
+    m_perOutputRepaint = false;
+    m_outputSwapsPending = 0;
     repaints_region = QRegion();
     if (Workspace::self()) {
         for (ClientList::ConstIterator it = Workspace::self()->clientList().constBegin();
@@ -606,23 +617,25 @@ void Compositor::addRepaint(int x, int y, int w, int h)
 {
     if (!hasScene())
         return;
-    repaints_region += QRegion(x, y, w, h);
-    scheduleRepaint();
+    addRepaint(QRegion(x, y, w, h));
 }
 
 void Compositor::addRepaint(const QRect& r)
 {
     if (!hasScene())
         return;
-    repaints_region += r;
-    scheduleRepaint();
+    addRepaint(QRegion(r));
 }
 
 void Compositor::addRepaint(const QRegion& r)
 {
     if (!hasScene())
         return;
-    repaints_region += r;
+    if (m_perOutputRepaint) {
+        addOutputRepaints(r);
+    } else {
+        repaints_region += r;
+    }
     scheduleRepaint();
 }
 
@@ -631,7 +644,11 @@ void Compositor::addRepaintFull()
     if (!hasScene())
         return;
     const QSize &s = screens()->size();
-    repaints_region = QRegion(0, 0, s.width(), s.height());
+    if (m_perOutputRepaint) {
+        addOutputRepaints(QRegion(0, 0, s.width(), s.height()));
+    } else {
+        repaints_region = QRegion(0, 0, s.width(), s.height());
+    }
     scheduleRepaint();
 }
 
@@ -655,14 +672,108 @@ void Compositor::bufferSwapComplete()
     assert(m_bufferSwapPending);
     m_bufferSwapPending = false;
 
+    if (!m_perOutputRepaint && m_vblankClock) {
+        m_frameTelemetry.notifyPresented(-1, m_vblankClock->lastVBlank());
+        framePresented(nullptr, m_vblankClock, true);
+    }
+
+    // e.g. the platform got reactivated, whatever was pending got dropped
+    m_outputSwapsPending = 0;
+    for (auto it = m_outputLoops.constBegin(); it != m_outputLoops.constEnd(); ++it) {
+        OutputRepaintLoop *loop = it.value();
+        if (auto presentation = waylandServer() ? waylandServer()->presentationTime() : nullptr) {
+            for (int i = 0; i < loop->swapsPending; ++i) {
+                presentation->discarded(it.key());
+            }
+        }
+        loop->swapsPending = 0;
+        loop->composeAtSwapCompletion = false;
+    }
+
     if (m_composeAtSwapCompletion) {
         m_composeAtSwapCompletion = false;
-        performCompositing();
+        if (m_perOutputRepaint) {
+            scheduleOutputRepaints();
+        } else {
+            // don't start right away, but as late as possible for the next vblank
+            waitForVBlank();
+        }
+    }
+}
+
+void Compositor::aboutToSwapBuffers(AbstractOutput *output)
+{
+    if (m_perOutputRepaint) {
+        if (OutputRepaintLoop *loop = m_outputLoops.value(output)) {
+            loop->swapsPending++;
+        }
+        return;
+    }
+    if (m_outputSwapsPending++ == 0) {
+        aboutToSwapBuffers();
+    }
+}
+
+void Compositor::bufferSwapComplete(AbstractOutput *output)
+{
+    if (m_perOutputRepaint) {
+        OutputRepaintLoop *loop = m_outputLoops.value(output);
+        if (!loop || loop->swapsPending == 0) {
+            return;
+        }
+        loop->swapsPending--;
+        if (loop->clock) {
+            const int screenId = kwinApp()->platform()->enabledOutputs().indexOf(output);
+            m_frameTelemetry.notifyPresented(screenId, loop->clock->lastVBlank(), loop->swapsPending);
+        }
+        framePresented(output, loop->clock, true);
+        if (loop->composeAtSwapCompletion) {
+            loop->composeAtSwapCompletion = false;
+            scheduleOutputRepaint(output);
+        }
+        return;
+    }
+    if (m_outputSwapsPending == 0) {
+        return;
+    }
+    if (--m_outputSwapsPending == 0) {
+        bufferSwapComplete();
+    }
+}
+
+void Compositor::bufferSwapDiscarded(AbstractOutput *output)
+{
+    if (!m_perOutputRepaint) {
+        // the frame of all outputs is reported once the last of them swapped
+        bufferSwapComplete(output);
+        return;
+    }
+    OutputRepaintLoop *loop = m_outputLoops.value(output);
+    if (!loop || loop->swapsPending == 0) {
+        return;
+    }
+    loop->swapsPending--;
+    // nothing got presented, so there is no telemetry sample either
+    if (auto presentation = waylandServer() ? waylandServer()->presentationTime() : nullptr) {
+        presentation->discarded(output);
+    }
+    if (loop->composeAtSwapCompletion) {
+        loop->composeAtSwapCompletion = false;
+        scheduleOutputRepaint(output);
     }
 }
 
 void Compositor::performCompositing()
 {
+    if (m_perOutputRepaint) {
+        // every output is painted by its own repaint loop
+        scheduleOutputRepaints();
+        return;
+    }
+
+    QElapsedTimer passTimer;
+    passTimer.start();
+
     if (m_scene->usesOverlayWindow() && !isOverlayWindowVisible())
         return; // nothing is visible anyway
 
@@ -681,18 +792,131 @@ void Compositor::performCompositing()
         return;
     }
 
+    m_frameTelemetry.beginFrame(-1, m_passScheduled, m_passTarget);
+    ToplevelList damaged;
+    ToplevelList windows = fetchWindowDamage(&damaged);
+
+    if (repaints_region.isEmpty() && !windowRepaintsPending()) {
+        m_frameTelemetry.abortFrame();
+        m_scene->idle();
+        m_timeSinceLastVBlank = fpsInterval - (options->vBlankTime() + 1); // means "start now"
+        m_timeSinceStart += m_timeSinceLastVBlank;
+        // Note: It would seem here we should undo suspended unredirect, but when scenes need
+        // it for some reason, e.g. transformations or translucency, the next pass that does not
+        // need this anymore and paints normally will also reset the suspended unredirect.
+        // Otherwise the window would not be painted normally anyway.
+        compositeTimer.stop();
+        return;
+    }
+
+    removeUnpaintableWindows(windows);
+
+    QRegion repaints = repaints_region;
+    // clear all repaints, so that post-pass can add repaints for the next repaint
+    repaints_region = QRegion();
+
+    const auto outputs = kwinApp()->platform()->enabledOutputs();
+    for (AbstractOutput *output : outputs) {
+        updateVrr(output);
+    }
+
+    m_frameTelemetry.enterPhase(FrameTelemetry::Phase::PrePaint);
+    m_timeSinceLastVBlank = paintScene(-1, repaints, windows);
+    m_frameTelemetry.endFrame();
+    // the whole pass counts, fetching damage can take a noticeable amount of time as well
+    m_frameScheduler.addPaintTime(passTimer.nsecsElapsed());
+    m_timeSinceStart += m_timeSinceLastVBlank;
+
+    if (waylandServer()) {
+        PresentationTime *presentation = waylandServer()->presentationTime();
+        for (Toplevel *win : qAsConst(damaged)) {
+            if (auto surface = win->surface()) {
+                surface->frameRendered(m_timeSinceStart);
+                if (presentation) {
+                    presentation->frameRendered(nullptr, surface);
+                }
+            }
+        }
+        if (presentation) {
+            presentation->frameSubmitted(nullptr);
+        }
+        if (!m_bufferSwapPending) {
+            // the platform does not tell when the frame hits the screen, it's as good as it gets
+            framePresented(nullptr, kwinApp()->platform()->vblankClock(), false);
+        }
+    }
+
+    compositeTimer.stop(); // stop here to ensure *we* cause the next repaint schedule - not some effect through m_scene->paint()
+
+    // Trigger at least one more pass even if there would be nothing to paint, so that scene->idle()
+    // is called the next time. If there would be nothing pending, it will not restart the timer and
+    // scheduleRepaint() would restart it again somewhen later, called from functions that
+    // would again add something pending.
+    if (m_bufferSwapPending && m_scene->syncsToVBlank()) {
+        m_composeAtSwapCompletion = true;
+    } else {
+        waitForVBlank();
+    }
+}
+
+void Compositor::framePresented(AbstractOutput *output, VBlankClock *clock, bool pageFlipped)
+{
+    PresentationTime *presentation = waylandServer() ? waylandServer()->presentationTime() : nullptr;
+    if (!presentation) {
+        return;
+    }
+    qint64 timestamp = VBlankClock::now();
+    quint64 sequence = 0;
+    PresentationTime::Kinds kinds;
+    if (pageFlipped && clock && clock->isHardwareBacked()) {
+        timestamp = clock->lastVBlank();
+        sequence = clock->lastSequence();
+        kinds = PresentationTime::Kind::VSync | PresentationTime::Kind::HwClock | PresentationTime::Kind::HwCompletion;
+    }
+    if (output && output->isDirectScanout()) {
+        kinds |= PresentationTime::Kind::ZeroCopy;
+    }
+    presentation->presented(output, timestamp, clock ? clock->refreshInterval() : 0, sequence, kinds);
+}
+
+void Compositor::waitForVBlank()
+{
+    VBlankClock *clock = kwinApp()->platform()->vblankClock();
+    if (clock != m_vblankClock) {
+        if (m_vblankClock) {
+            m_vblankClock->cancelWakeup();
+            disconnect(m_vblankClock, &VBlankClock::wakeup, this, &Compositor::vblankWakeup);
+        }
+        m_vblankClock = clock;
+        connect(m_vblankClock, &VBlankClock::wakeup, this, &Compositor::vblankWakeup);
+    }
+    // we keep processing events while waiting, but do not start a new pass until woken up
+    m_waitingForVBlank = true;
+    m_passScheduled = VBlankClock::now();
+    // with a variable refresh rate the outputs wait for the frame, not the other way round
+    m_passTarget = isVrrEnabled() ? m_passScheduled : m_frameScheduler.nextPaintStart(m_vblankClock);
+    m_vblankClock->scheduleWakeup(m_passTarget);
+}
+
+void Compositor::vblankWakeup()
+{
+    m_waitingForVBlank = false;
+    scheduleRepaint();
+}
+
+ToplevelList Compositor::fetchWindowDamage(ToplevelList *damaged)
+{
     // Create a list of all windows in the stacking order
     ToplevelList windows = Workspace::self()->xStackingOrder();
-    ToplevelList damaged;
 
     // Reset the damage state of each window and fetch the damage region
     // without waiting for a reply
     foreach (Toplevel *win, windows) {
         if (win->resetAndFetchDamage())
-            damaged << win;
+            *damaged << win;
     }
 
-    if (damaged.count() > 0) {
+    if (!damaged->isEmpty()) {
         m_scene->triggerFence();
         if (auto c = kwinApp()->x11Connection()) {
             xcb_flush(c);
@@ -707,7 +931,7 @@ void Compositor::performCompositing()
     }
 
     // Get the replies
-    foreach (Toplevel *win, damaged) {
+    foreach (Toplevel *win, *damaged) {
         // Discard the cached lanczos texture
         if (win->effectWindow()) {
             const QVariant texture = win->effectWindow()->data(LanczosCacheRole);
@@ -719,19 +943,11 @@ void Compositor::performCompositing()
 
         win->getDamageRegionReply();
     }
+    return windows;
+}
 
-    if (repaints_region.isEmpty() && !windowRepaintsPending()) {
-        m_scene->idle();
-        m_timeSinceLastVBlank = fpsInterval - (options->vBlankTime() + 1); // means "start now"
-        m_timeSinceStart += m_timeSinceLastVBlank;
-        // Note: It would seem here we should undo suspended unredirect, but when scenes need
-        // it for some reason, e.g. transformations or translucency, the next pass that does not
-        // need this anymore and paints normally will also reset the suspended unredirect.
-        // Otherwise the window would not be painted normally anyway.
-        compositeTimer.stop();
-        return;
-    }
-
+void Compositor::removeUnpaintableWindows(ToplevelList &windows) const
+{
     // skip windows that are not yet ready for being painted and if screen is locked skip windows that are
     // neither lockscreen nor inputmethod windows
     // TODO ?
@@ -747,15 +963,15 @@ void Compositor::performCompositing()
             }
         }
     }
+}
 
-    QRegion repaints = repaints_region;
-    // clear all repaints, so that post-pass can add repaints for the next repaint
-    repaints_region = QRegion();
-
+qint64 Compositor::paintScene(int screenId, const QRegion &repaints, const ToplevelList &windows)
+{
     if (m_framesToTestForSafety > 0 && (m_scene->compositingType() & OpenGLCompositing)) {
         kwinApp()->platform()->createOpenGLSafePoint(Platform::OpenGLSafePoint::PreFrame);
     }
-    m_timeSinceLastVBlank = m_scene->paint(repaints, windows);
+    const qint64 renderTime = screenId < 0 ? m_scene->paint(repaints, windows)
+                                           : m_scene->paintOutput(screenId, repaints, windows);
     if (m_framesToTestForSafety > 0) {
         if (m_scene->compositingType() & OpenGLCompositing) {
             kwinApp()->platform()->createOpenGLSafePoint(Platform::OpenGLSafePoint::PostFrame);
@@ -765,38 +981,292 @@ void Compositor::performCompositing()
             kwinApp()->platform()->createOpenGLSafePoint(Platform::OpenGLSafePoint::PostLastGuardedFrame);
         }
     }
-    m_timeSinceStart += m_timeSinceLastVBlank;
+    return renderTime;
+}
 
-    if (waylandServer()) {
-        for (Toplevel *win : qAsConst(damaged)) {
-            if (auto surface = win->surface()) {
-                surface->frameRendered(m_timeSinceStart);
+void Compositor::setupOutputRepaintLoops()
+{
+    const auto outputs = kwinApp()->platform()->enabledOutputs();
+    // the scene addresses outputs by their screen id, so both have to match
+    m_perOutputRepaint = m_scene->supportsOutputPainting()
+                         && !outputs.isEmpty()
+                         && outputs.count() == screens()->count()
+                         && !qEnvironmentVariableIsSet("KWIN_SINGLE_REPAINT_LOOP");
+    if (!m_perOutputRepaint) {
+        return;
+    }
+    qCDebug(KWIN_CORE) << "Repainting" << outputs.count() << "outputs independently";
+    if (m_vblankClock) {
+        m_vblankClock->cancelWakeup();
+        disconnect(m_vblankClock, &VBlankClock::wakeup, this, &Compositor::vblankWakeup);
+        m_vblankClock.clear();
+    }
+    m_waitingForVBlank = false;
+    connect(screens(), &Screens::changed, this, &Compositor::syncOutputRepaintLoops, Qt::UniqueConnection);
+    syncOutputRepaintLoops();
+}
+
+void Compositor::syncOutputRepaintLoops()
+{
+    if (!m_perOutputRepaint) {
+        return;
+    }
+    const auto outputs = kwinApp()->platform()->enabledOutputs();
+    const auto loopOutputs = m_outputLoops.keys();
+    for (AbstractOutput *output : loopOutputs) {
+        if (!outputs.contains(output)) {
+            destroyOutputRepaintLoop(output);
+        }
+    }
+    for (AbstractOutput *output : outputs) {
+        if (m_outputLoops.contains(output)) {
+            continue;
+        }
+        OutputRepaintLoop *loop = new OutputRepaintLoop;
+        loop->clock = output->vblankClock();
+        loop->wakeupConnection = connect(loop->clock, &VBlankClock::wakeup, this,
+            [this, output] {
+                performCompositing(output);
+            }
+        );
+        loop->destroyedConnection = connect(output, &QObject::destroyed, this,
+            [this, output] {
+                destroyOutputRepaintLoop(output);
+            }
+        );
+        m_outputLoops.insert(output, loop);
+    }
+    // the geometries changed, repaint everything on the new layout
+    addRepaintFull();
+}
+
+void Compositor::destroyOutputRepaintLoop(AbstractOutput *output)
+{
+    OutputRepaintLoop *loop = m_outputLoops.take(output);
+    if (!loop) {
+        return;
+    }
+    disconnect(loop->wakeupConnection);
+    disconnect(loop->destroyedConnection);
+    if (loop->clock) {
+        loop->clock->cancelWakeup();
+    }
+    delete loop;
+}
+
+void Compositor::addOutputRepaints(const QRegion &region)
+{
+    for (auto it = m_outputLoops.constBegin(); it != m_outputLoops.constEnd(); ++it) {
+        const QRegion repaints = region & it.key()->geometry();
+        if (!repaints.isEmpty()) {
+            it.value()->repaints |= repaints;
+        }
+    }
+}
+
+void Compositor::collectWindowRepaints()
+{
+    auto collect = [this] (Toplevel *t) {
+        const QRegion repaints = t->repaints();
+        if (repaints.isEmpty()) {
+            return;
+        }
+        addOutputRepaints(repaints);
+        t->resetRepaints();
+    };
+    std::for_each(Workspace::self()->clientList().constBegin(), Workspace::self()->clientList().constEnd(), collect);
+    std::for_each(Workspace::self()->desktopList().constBegin(), Workspace::self()->desktopList().constEnd(), collect);
+    std::for_each(Workspace::self()->unmanagedList().constBegin(), Workspace::self()->unmanagedList().constEnd(), collect);
+    std::for_each(Workspace::self()->deletedList().constBegin(), Workspace::self()->deletedList().constEnd(), collect);
+    if (auto w = waylandServer()) {
+        // same restrictions as in windowRepaintsPending()
+        for (ShellClient *c : w->clients()) {
+            if (c->readyForPainting()) {
+                collect(c);
+            }
+        }
+        for (ShellClient *c : w->internalClients()) {
+            if (c->isShown(true)) {
+                collect(c);
             }
         }
     }
+}
 
-    compositeTimer.stop(); // stop here to ensure *we* cause the next repaint schedule - not some effect through m_scene->paint()
+void Compositor::scheduleOutputRepaints()
+{
+    if (!hasScene() || m_starting || !Workspace::self()) {
+        return;
+    }
+    collectWindowRepaints();
+    for (auto it = m_outputLoops.constBegin(); it != m_outputLoops.constEnd(); ++it) {
+        if (!it.value()->repaints.isEmpty()) {
+            scheduleOutputRepaint(it.key());
+        }
+    }
+}
 
-    // Trigger at least one more pass even if there would be nothing to paint, so that scene->idle()
-    // is called the next time. If there would be nothing pending, it will not restart the timer and
-    // scheduleRepaint() would restart it again somewhen later, called from functions that
-    // would again add something pending.
-    if (m_bufferSwapPending && m_scene->syncsToVBlank()) {
+void Compositor::scheduleOutputRepaint(AbstractOutput *output)
+{
+    OutputRepaintLoop *loop = m_outputLoops.value(output);
+    if (!loop || !loop->clock) {
+        return;
+    }
+    if (loop->swapsPending >= kwinApp()->platform()->frameQueueDepth()) {
+        loop->composeAtSwapCompletion = true;
+        return;
+    }
+    if (loop->waitingForVBlank) {
+        return;
+    }
+    loop->waitingForVBlank = true;
+    loop->passScheduled = VBlankClock::now();
+    if (output->isVrrEnabled()) {
+        // the output flips as soon as the frame is ready, there is no vblank to aim for
+        loop->passTarget = loop->passScheduled;
+    } else {
+        // the frames still waiting for scanout take the next vblanks
+        loop->passTarget = loop->scheduler.nextPaintStart(loop->clock, loop->swapsPending);
+    }
+    loop->clock->scheduleWakeup(loop->passTarget);
+}
+
+void Compositor::performCompositing(AbstractOutput *output)
+{
+    QElapsedTimer passTimer;
+    passTimer.start();
+
+    OutputRepaintLoop *loop = m_outputLoops.value(output);
+    if (!loop || !hasScene()) {
+        return;
+    }
+    loop->waitingForVBlank = false;
+
+    // compositing as a whole is blocked, e.g. during a VT switch
+    if (m_bufferSwapPending) {
         m_composeAtSwapCompletion = true;
+        return;
+    }
+    const int queueDepth = kwinApp()->platform()->frameQueueDepth();
+    if (loop->swapsPending >= queueDepth) {
+        loop->composeAtSwapCompletion = true;
+        return;
+    }
+    if (!kwinApp()->platform()->areOutputsEnabled()) {
+        return;
+    }
+
+    const int screenId = kwinApp()->platform()->enabledOutputs().indexOf(output);
+    m_frameTelemetry.beginFrame(screenId, loop->passScheduled, loop->passTarget);
+    ToplevelList damaged;
+    ToplevelList windows = fetchWindowDamage(&damaged);
+    // frame callbacks go out once the outputs showing the window got painted
+    for (Toplevel *win : qAsConst(damaged)) {
+        const QRect rect = win->visibleRect();
+        bool onOutput = false;
+        for (auto it = m_outputLoops.constBegin(); it != m_outputLoops.constEnd(); ++it) {
+            if (!rect.intersects(it.key()->geometry())) {
+                continue;
+            }
+            onOutput = true;
+            if (!it.value()->damagedWindows.contains(win)) {
+                it.value()->damagedWindows << win;
+            }
+        }
+        if (!onOutput && !loop->damagedWindows.contains(win)) {
+            // not visible anywhere, don't let the client wait for a frame which never happens
+            loop->damagedWindows << win;
+        }
+    }
+    collectWindowRepaints();
+
+    if (loop->repaints.isEmpty()) {
+        m_frameTelemetry.abortFrame();
+        const bool idle = std::none_of(m_outputLoops.constBegin(), m_outputLoops.constEnd(),
+            [] (OutputRepaintLoop *l) {
+                return !l->repaints.isEmpty() || l->waitingForVBlank || l->swapsPending > 0;
+            }
+        );
+        if (idle) {
+            m_scene->idle();
+        }
+        return;
+    }
+
+    removeUnpaintableWindows(windows);
+
+    const QRegion repaints = loop->repaints;
+    // clear the repaints, so that post-pass can add repaints for the next repaint
+    loop->repaints = QRegion();
+    updateVrr(output);
+
+    const int swapsPending = loop->swapsPending;
+    m_frameTelemetry.enterPhase(FrameTelemetry::Phase::PrePaint);
+    m_timeSinceLastVBlank = paintScene(screenId, repaints, windows);
+    m_frameTelemetry.endFrame();
+    loop->scheduler.addPaintTime(passTimer.nsecsElapsed());
+    const bool swapped = loop->swapsPending > swapsPending;
+    m_timeSinceStart += m_timeSinceLastVBlank;
+
+    if (waylandServer()) {
+        PresentationTime *presentation = waylandServer()->presentationTime();
+        for (const QPointer<Toplevel> &win : qAsConst(loop->damagedWindows)) {
+            if (win && win->surface()) {
+                win->surface()->frameRendered(m_timeSinceStart);
+                if (presentation) {
+                    presentation->frameRendered(output, win->surface());
+                }
+            }
+        }
+        if (presentation && (swapped || loop->swapsPending == 0)) {
+            // otherwise the feedbacks go with the next frame, older ones are still on their way
+            presentation->frameSubmitted(output);
+        }
+        if (!swapped && loop->swapsPending == 0) {
+            // nothing got flipped, e.g. the output has no valid buffer
+            framePresented(output, loop->clock, false);
+        }
+    }
+    loop->damagedWindows.clear();
+
+    // like in the single loop, trigger at least one more pass so that scene->idle() gets called
+    if (loop->swapsPending >= queueDepth) {
+        loop->composeAtSwapCompletion = true;
     } else {
-drm_wait_vblank_t vblank;
-         int retval;
-         vblank.request.sequence = 1;
-         vblank.request.type = _DRM_VBLANK_RELATIVE;
-         do {
-           retval = ioctl (dri_fd, DRM_IOCTL_WAIT_VBLANK, &vblank);
-           *((int*)&vblank.request.type )&=~_DRM_VBLANK_RELATIVE;
-         }
-         while (retval == -1 && errno == EINTR);
-         LastPaintFree=8000;
-         usleep(LastPaintFree);
-           scheduleRepaint();
+        scheduleOutputRepaint(output);
+    }
+}
+
+void Compositor::updateVrr(AbstractOutput *output)
+{
+    if (!output->isVrrCapable()) {
+        return;
+    }
+    // a fullscreen client, like a game or a video player, sets the pace of its output
+    AbstractClient *client = Workspace::self()->activeClient();
+    if (client && (!client->isFullScreen() || client->geometry() != output->geometry())) {
+        client = nullptr;
+    }
+    if (m_vrrClients.value(output) != client) {
+        // the output does not ask again after a refused request until it got disabled,
+        // another client gets a new try
+        output->setVrrEnabled(false);
+        if (client) {
+            m_vrrClients.insert(output, client);
+        } else {
+            m_vrrClients.remove(output);
+        }
+    }
+    output->setVrrEnabled(client);
+}
+
+bool Compositor::isVrrEnabled() const
+{
+    const auto outputs = kwinApp()->platform()->enabledOutputs();
+    if (outputs.isEmpty()) {
+        return false;
     }
+    return std::all_of(outputs.constBegin(), outputs.constEnd(), [] (AbstractOutput *o) { return o->isVrrEnabled(); });
 }
 
 template <class T>
@@ -855,6 +1325,10 @@ void Compositor::setCompositeTimer()
     if (m_bufferSwapPending && m_composeAtSwapCompletion)
         return;
 
+    // Don't start the timer if we're waiting for the next vblank, vblankWakeup() does
+    if (m_waitingForVBlank)
+        return;
+
     // Don't start the timer if all outputs are disabled
     if (!kwinApp()->platform()->areOutputsEnabled()) {
         return;
@@ -862,7 +1336,8 @@ void Compositor::setCompositeTimer()
 
     uint waitTime = 1;
 
-    if (m_scene->blocksForRetrace()) {
+    // with a variable refresh rate there is no retrace to pad to
+    if (m_scene->blocksForRetrace() && !isVrrEnabled()) {
 
         // TODO: make vBlankTime dynamic?!
         // It's required because glXWaitVideoSync will *likely* block a full frame if one enters
@@ -910,6 +1385,8 @@ void Compositor::setCompositeTimer()
     }
     waitTime=0;
     compositeTimer.start(qMin(waitTime, 250u), this); // force 4fps minimum
+    m_passScheduled = VBlankClock::now();
+    m_passTarget = m_passScheduled + milliToNano(qMin(waitTime, 250u));
 }
 
 bool Compositor::isActive()
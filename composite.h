@@ -23,6 +23,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define KWIN_COMPOSITE_H
 // KWin
 #include <kwinglobals.h>
+#include "framescheduler.h"
+#include "frametelemetry.h"
+#include "utils.h"
 // KDE
 #include <KSelectionOwner>
 // Qt
@@ -30,12 +33,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QElapsedTimer>
 #include <QTimer>
 #include <QBasicTimer>
+#include <QHash>
+#include <QPointer>
 #include <QRegion>
+#include <QVector>
 
 namespace KWin {
 
+class AbstractClient;
+class AbstractOutput;
 class Client;
 class Scene;
+class VBlankClock;
 
 class CompositorSelectionOwner : public KSelectionOwner
 {
@@ -173,6 +182,36 @@ public Q_SLOTS:
      */
     void bufferSwapComplete();
 
+    /**
+     * Notifies the compositor that the buffer of @p output is about to be swapped.
+     * If outputs are repainted independently only the repaint loop of @p output is
+     * deferred, once Platform::frameQueueDepth swaps are pending. Otherwise this is
+     * equivalent to aboutToSwapBuffers() for the first pending output.
+     */
+    void aboutToSwapBuffers(AbstractOutput *output);
+    /**
+     * Notifies the compositor that the oldest pending buffer swap of @p output has completed.
+     */
+    void bufferSwapComplete(AbstractOutput *output);
+    /**
+     * Notifies the compositor that the oldest pending buffer swap of @p output will never be
+     * shown, e.g. because the queued frame could not be presented after the page flip.
+     */
+    void bufferSwapDiscarded(AbstractOutput *output);
+    /**
+     * @returns whether a buffer swap is pending, that is compositing is blocked
+     **/
+    bool isBufferSwapPending() const {
+        return m_bufferSwapPending;
+    }
+
+    /**
+     * @returns the timing of the last compositing passes
+     **/
+    FrameTelemetry *frameTelemetry() {
+        return &m_frameTelemetry;
+    }
+
 Q_SIGNALS:
     void compositingToggled(bool active);
     void aboutToDestroy();
@@ -194,6 +233,10 @@ private Q_SLOTS:
      **/
     void restart();
     void performCompositing();
+    /**
+     * Invoked by the VBlankClock once the next pass should be started.
+     **/
+    void vblankWakeup();
     void slotConfigChanged();
     void releaseCompositorSelection();
     void deleteUnusedSupportProperties();
@@ -201,7 +244,54 @@ private Q_SLOTS:
 private:
     void claimCompositorSelection();
     void setCompositeTimer();
+    /**
+     * Asynchronously waits until the FrameScheduler wants the next pass to start for
+     * the Platform's VBlankClock. The event loop keeps running, the next pass is
+     * scheduled by vblankWakeup().
+     **/
+    void waitForVBlank();
+    /**
+     * Sends the presentation feedback for the frame painted last for @p output, @c nullptr
+     * meaning all outputs. If @p pageFlipped is @c true the timing of @p clock is the one
+     * of the page flip which showed the frame.
+     **/
+    void framePresented(AbstractOutput *output, VBlankClock *clock, bool pageFlipped);
     bool windowRepaintsPending() const;
+    /**
+     * Fetches the damage of all windows in the stacking order and returns the windows to
+     * consider for painting. The damaged windows are added to @p damaged.
+     **/
+    ToplevelList fetchWindowDamage(ToplevelList *damaged);
+    /**
+     * Removes the windows which must not be painted yet, e.g. because the screen is locked.
+     **/
+    void removeUnpaintableWindows(ToplevelList &windows) const;
+    /**
+     * Paints either all screens (@p screenId being @c -1) or the given screen and creates
+     * the OpenGL safe points around the first frames.
+     **/
+    qint64 paintScene(int screenId, const QRegion &repaints, const ToplevelList &windows);
+
+    /**
+     * Decides whether the outputs get independent repaint loops. This is the case if
+     * the Scene is able to render and present a single output.
+     **/
+    void setupOutputRepaintLoops();
+    void syncOutputRepaintLoops();
+    void destroyOutputRepaintLoop(AbstractOutput *output);
+    /**
+     * Adds @p region to the repaints of all outputs it intersects.
+     **/
+    void addOutputRepaints(const QRegion &region);
+    /**
+     * Moves the pending repaints of all windows to the outputs.
+     **/
+    void collectWindowRepaints();
+    void scheduleOutputRepaints();
+    void scheduleOutputRepaint(AbstractOutput *output);
+    void updateVrr(AbstractOutput *output);
+    bool isVrrEnabled() const;
+    void performCompositing(AbstractOutput *output);
     /**
      * Continues the startup after Scene And Workspace are created
      **/
@@ -232,6 +322,38 @@ private:
     bool m_bufferSwapPending;
     bool m_composeAtSwapCompletion;
     int m_framesToTestForSafety = 3;
+    QPointer<VBlankClock> m_vblankClock;
+    bool m_waitingForVBlank = false;
+    FrameScheduler m_frameScheduler;
+    FrameTelemetry m_frameTelemetry;
+    // when the next pass got scheduled and when it is supposed to start
+    qint64 m_passScheduled = 0;
+    qint64 m_passTarget = 0;
+    // number of outputs with a pending swap if all outputs share one repaint loop
+    int m_outputSwapsPending = 0;
+
+    /**
+     * The state of the repaint loop of one output if outputs are repainted independently.
+     **/
+    struct OutputRepaintLoop {
+        FrameScheduler scheduler;
+        QRegion repaints;
+        // windows whose frame callbacks are sent once this output got painted
+        QVector<QPointer<Toplevel>> damagedWindows;
+        QPointer<VBlankClock> clock;
+        qint64 passScheduled = 0;
+        qint64 passTarget = 0;
+        QMetaObject::Connection wakeupConnection;
+        QMetaObject::Connection destroyedConnection;
+        bool waitingForVBlank = false;
+        // frames handed over to the output which did not reach the screen yet
+        int swapsPending = 0;
+        bool composeAtSwapCompletion = false;
+    };
+    bool m_perOutputRepaint = false;
+    QHash<AbstractOutput*, OutputRepaintLoop*> m_outputLoops;
+    // the fullscreen client each output asked for a variable refresh rate for
+    QHash<AbstractOutput*, QPointer<AbstractClient>> m_vrrClients;
 
     KWIN_SINGLETON_VARIABLE(Compositor, s_compositor)
 };
@@ -27,6 +27,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "atoms.h"
 #include "composite.h"
 #include "debug_console.h"
+#include "effects.h"
 #include "main.h"
 #include "placement.h"
 #include "platform.h"
@@ -38,6 +39,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "activities.h"
 #endif
 
+#include <kwinglutils.h>
+
 // Qt
 #include <QOpenGLContext>
 #include <QDBusServiceWatcher>
@@ -298,6 +301,34 @@ void CompositorDBusInterface::suspend()
     m_compositor->suspend(Compositor::ScriptSuspend);
 }
 
+QByteArray CompositorDBusInterface::frameTimings() const
+{
+    return m_compositor->frameTelemetry()->dump();
+}
+
+QVariantMap CompositorDBusInterface::frameTimingSummary() const
+{
+    QVariantMap summary = m_compositor->frameTelemetry()->summary();
+    summary.insert(QStringLiteral("uniforms.updates"), GLShader::uniformUpdateCount());
+    summary.insert(QStringLiteral("uniforms.skipped"), GLShader::skippedUniformUpdateCount());
+    return summary;
+}
+
+void CompositorDBusInterface::setEffectProfilingEnabled(bool enabled)
+{
+    if (effects) {
+        static_cast<EffectsHandlerImpl*>(effects)->setEffectProfilingEnabled(enabled);
+    }
+}
+
+QVariantMap CompositorDBusInterface::effectTimingSummary() const
+{
+    if (!effects) {
+        return QVariantMap();
+    }
+    return static_cast<EffectsHandlerImpl*>(effects)->effectProfiler()->summary();
+}
+
 QStringList CompositorDBusInterface::supportedOpenGLPlatformInterfaces() const
 {
     QStringList interfaces;
@@ -161,6 +161,51 @@ public Q_SLOTS:
      * @see isOpenGLBroken
      **/
     void resume();
+    /**
+     * @brief The timing of the last compositing passes as binary dump.
+     *
+     * The format is described in FrameTelemetry::dump.
+     *
+     * @return QByteArray the serialized frames, oldest first
+     * @see frameTimingSummary
+     **/
+    QByteArray frameTimings() const;
+    /**
+     * @brief Percentiles of the durations of the phases of the last compositing passes.
+     *
+     * All values are in microseconds, e.g. "paint.p95" is the 95th percentile of the time
+     * spent in painting and "latency.p50" the median time from the start of a pass to
+     * the presentation of the frame.
+     *
+     * "uniforms.updates" and "uniforms.skipped" are not durations but the number of shader
+     * uniform values uploaded and of redundant ones skipped since startup.
+     *
+     * @return QVariantMap the percentiles and the number of frames they are based on
+     * @see frameTimings
+     **/
+    QVariantMap frameTimingSummary() const;
+    /**
+     * @brief Starts or stops measuring the time effects spend painting.
+     *
+     * With OpenGL compositing the GPU time is measured as well, if the driver supports
+     * timer queries. Profiling is stopped when the Compositor restarts.
+     *
+     * @param enabled whether to measure
+     * @see effectTimingSummary
+     **/
+    void setEffectProfilingEnabled(bool enabled);
+    /**
+     * @brief Percentiles of the time each effect spent painting in the last frames.
+     *
+     * Keys are like "blur.gpu.p95", the 95th percentile in microseconds of the GPU time blur
+     * took in the frames it painted in. "scene" stands for the painting done by the scene
+     * itself. "blur.cpu.histogram" holds the number of frames below 0.1, 0.25, 0.5, 1, 2, 4,
+     * 8 milliseconds and of the rest.
+     *
+     * @return QVariantMap the percentiles and histograms, empty if nothing got measured
+     * @see setEffectProfilingEnabled
+     **/
+    QVariantMap effectTimingSummary() const;
 
 Q_SIGNALS:
     void compositingToggled(bool active);
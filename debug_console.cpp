@@ -20,6 +20,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "debug_console.h"
 #include "composite.h"
 #include "client.h"
+#include "effects.h"
 #include "input_event.h"
 #include "main.h"
 #include "scene.h"
@@ -45,6 +46,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <NETWM>
 // Qt
 #include <QMouseEvent>
+#include <QSignalBlocker>
+#include <QTimer>
 #include <QMetaProperty>
 #include <QMetaType>
 
@@ -517,9 +520,32 @@ DebugConsole::DebugConsole()
                 updateKeyboardTab();
                 connect(input(), &InputRedirection::keyStateChanged, this, &DebugConsole::updateKeyboardTab);
             }
+            if (index == 6) {
+                updateSceneTab();
+            }
         }
     );
 
+    connect(m_ui->effectProfilingCheckBox, &QCheckBox::toggled, this,
+        [] (bool enabled) {
+            if (effects) {
+                static_cast<EffectsHandlerImpl*>(effects)->setEffectProfilingEnabled(enabled);
+            }
+        }
+    );
+
+    // the counters change every frame, refresh them at a readable pace
+    QTimer *sceneTimer = new QTimer(this);
+    sceneTimer->setInterval(1000);
+    connect(sceneTimer, &QTimer::timeout, this,
+        [this] {
+            if (m_ui->tabWidget->currentIndex() == 6) {
+                updateSceneTab();
+            }
+        }
+    );
+    sceneTimer->start();
+
     // for X11
     setWindowFlags(Qt::X11BypassWindowManagerHint);
 
@@ -601,6 +627,69 @@ void DebugConsole::updateKeyboardTab()
     m_ui->activeModifiersLabel->setText(stateActiveComponents<xkb_mod_index_t>(state, xkb_keymap_num_mods(map), modActive, &xkb_keymap_mod_get_name));
 }
 
+void DebugConsole::updateSceneTab()
+{
+    const quint64 hits = Scene::Window::quadCacheHits();
+    const quint64 misses = Scene::Window::quadCacheMisses();
+    m_ui->quadCacheHitsLabel->setText(QString::number(hits));
+    m_ui->quadCacheMissesLabel->setText(QString::number(misses));
+    if (hits + misses == 0) {
+        m_ui->quadCacheHitRateLabel->setText(i18n("n/a"));
+    } else {
+        m_ui->quadCacheHitRateLabel->setText(i18nc("percentage of window quad lists which were reused", "%1 %", QString::number(100.0 * hits / (hits + misses), 'f', 1)));
+    }
+    m_ui->clippedQuadsWindowsLabel->setText(QString::number(Scene::Window::clippedWindows(Scene::Window::Clipping::Quads)));
+    m_ui->clippedScissorWindowsLabel->setText(QString::number(Scene::Window::clippedWindows(Scene::Window::Clipping::Scissor)));
+    m_ui->clippedScissorDrawsLabel->setText(QString::number(Scene::Window::clippedDraws(Scene::Window::Clipping::Scissor)));
+
+    const EffectProfiler *profiler = effects ? static_cast<EffectsHandlerImpl*>(effects)->effectProfiler() : nullptr;
+    m_ui->effectTimingsBox->setEnabled(profiler != nullptr);
+    m_ui->effectTimingsView->clear();
+    if (!profiler) {
+        return;
+    }
+    {
+        QSignalBlocker blocker(m_ui->effectProfilingCheckBox);
+        m_ui->effectProfilingCheckBox->setChecked(profiler->isActive());
+    }
+
+    auto duration = [] (const QVariant &microseconds) {
+        if (!microseconds.isValid()) {
+            return QString();
+        }
+        return i18nc("duration in milliseconds", "%1 ms", QString::number(microseconds.toLongLong() / 1000.0, 'f', 2));
+    };
+    // one bar per bucket, scaled to the fullest one
+    auto histogram = [] (const QVariant &buckets) {
+        const QVariantList counts = buckets.toList();
+        int max = 0;
+        for (const QVariant &count : counts) {
+            max = qMax(max, count.toInt());
+        }
+        QString bars;
+        for (const QVariant &count : counts) {
+            const int c = count.toInt();
+            bars.append(c == 0 ? QChar(0x00b7) : QChar(0x2581 + (c * 8 + max - 1) / max - 1));
+        }
+        return bars;
+    };
+
+    const QVariantMap summary = profiler->summary();
+    const QStringList names = profiler->names();
+    for (const QString &name : names) {
+        QTreeWidgetItem *item = new QTreeWidgetItem(m_ui->effectTimingsView);
+        item->setText(0, name);
+        item->setText(1, duration(summary.value(name + QStringLiteral(".cpu.p50"))));
+        item->setText(2, duration(summary.value(name + QStringLiteral(".cpu.p95"))));
+        item->setText(3, histogram(summary.value(name + QStringLiteral(".cpu.histogram"))));
+        item->setText(4, duration(summary.value(name + QStringLiteral(".gpu.p50"))));
+        item->setText(5, duration(summary.value(name + QStringLiteral(".gpu.p95"))));
+        item->setText(6, histogram(summary.value(name + QStringLiteral(".gpu.histogram"))));
+        item->setToolTip(3, i18n("Frames below 0.1, 0.25, 0.5, 1, 2, 4, 8 ms and above"));
+        item->setToolTip(6, item->toolTip(3));
+    }
+}
+
 void DebugConsole::showEvent(QShowEvent *event)
 {
     QWidget::showEvent(event);
@@ -108,6 +108,7 @@ protected:
 private:
     void initGLTab();
     void updateKeyboardTab();
+    void updateSceneTab();
 
     QScopedPointer<Ui::DebugConsole> m_ui;
     QScopedPointer<DebugConsoleFilter> m_inputFilter;
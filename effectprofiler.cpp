@@ -0,0 +1,322 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "effectprofiler.h"
+
+#include <epoxy/gl.h>
+
+#include <QVarLengthArray>
+
+#include <algorithm>
+
+namespace KWin
+{
+
+const int EffectProfiler::s_capacity;
+const int EffectProfiler::s_maxPendingFrames;
+const std::array<qint64, 7> EffectProfiler::s_histogramBounds = {{ 100, 250, 500, 1000, 2000, 4000, 8000 }};
+
+void EffectProfiler::Durations::add(qint64 duration)
+{
+    ring[written % s_capacity] = duration;
+    ++written;
+}
+
+QVector<qint64> EffectProfiler::Durations::values() const
+{
+    const int count = int(qMin(written, quint64(s_capacity)));
+    QVector<qint64> values;
+    values.reserve(count);
+    for (quint64 i = written - count; i < written; ++i) {
+        values << ring[i % s_capacity];
+    }
+    return values;
+}
+
+EffectProfiler::EffectProfiler(std::function<QString(Effect *)> effectName)
+    : m_effectName(effectName)
+{
+}
+
+EffectProfiler::~EffectProfiler() = default;
+
+void EffectProfiler::start(bool gpu)
+{
+    if (m_active) {
+        return;
+    }
+    m_active = true;
+    m_gpu = gpu;
+    m_stack.clear();
+}
+
+void EffectProfiler::stop()
+{
+    if (!m_active) {
+        return;
+    }
+    deleteQueries();
+    m_active = false;
+    m_gpu = false;
+    m_stack.clear();
+    for (Entry &entry : m_entries) {
+        entry.frameCpu = 0;
+        entry.inFrame = false;
+    }
+}
+
+void EffectProfiler::effectsChanged()
+{
+    m_effects.clear();
+}
+
+void EffectProfiler::clear()
+{
+    m_entries.clear();
+    m_effects.clear();
+    m_stack.clear();
+    // the pending results refer to entries which are gone
+    recycleQueries();
+}
+
+int EffectProfiler::entryIndex(Effect *effect)
+{
+    auto it = m_effects.constFind(effect);
+    if (it != m_effects.constEnd()) {
+        return it.value();
+    }
+    const QString name = effect ? m_effectName(effect) : QStringLiteral("scene");
+    int index = -1;
+    for (int i = 0; i < m_entries.count(); ++i) {
+        if (m_entries.at(i).name == name) {
+            index = i;
+            break;
+        }
+    }
+    if (index < 0) {
+        Entry entry;
+        entry.name = name;
+        m_entries << entry;
+        index = m_entries.count() - 1;
+    }
+    m_effects.insert(effect, index);
+    return index;
+}
+
+const EffectProfiler::Entry *EffectProfiler::entry(const QString &name) const
+{
+    for (const Entry &entry : m_entries) {
+        if (entry.name == name) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+void EffectProfiler::account(qint64 timestamp)
+{
+    m_entries[m_stack.top()].frameCpu += timestamp - m_lastTimestamp;
+    m_lastTimestamp = timestamp;
+}
+
+void EffectProfiler::enter(Effect *effect, qint64 timestamp)
+{
+    if (!m_active) {
+        return;
+    }
+    const int index = entryIndex(effect);
+    if (m_stack.isEmpty()) {
+        collectGpuResults();
+        m_lastTimestamp = timestamp;
+    } else {
+        account(timestamp);
+    }
+    m_stack.push(index);
+    m_entries[index].inFrame = true;
+    queryTimestamp(index);
+}
+
+void EffectProfiler::leave(qint64 timestamp)
+{
+    if (!m_active || m_stack.isEmpty()) {
+        return;
+    }
+    account(timestamp);
+    m_stack.pop();
+    if (!m_stack.isEmpty()) {
+        queryTimestamp(m_stack.top());
+        return;
+    }
+
+    // the outermost call returned, the frame is complete
+    queryTimestamp(-1);
+    for (Entry &entry : m_entries) {
+        if (entry.inFrame) {
+            entry.cpu.add(entry.frameCpu);
+            entry.frameCpu = 0;
+            entry.inFrame = false;
+        }
+    }
+    if (m_gpu) {
+        m_gpuPending.push_back(m_gpuFrame);
+        m_gpuFrame.clear();
+    }
+}
+
+void EffectProfiler::queryTimestamp(int entry)
+{
+    if (!m_gpu) {
+        return;
+    }
+    GLuint query;
+    if (m_freeQueries.isEmpty()) {
+        glGenQueries(1, &query);
+    } else {
+        query = m_freeQueries.takeLast();
+    }
+    glQueryCounter(query, GL_TIMESTAMP);
+    m_gpuFrame << Timestamp{entry, query};
+}
+
+void EffectProfiler::collectGpuResults()
+{
+    while (!m_gpuPending.empty()) {
+        const QVector<Timestamp> &frame = m_gpuPending.front();
+
+        // the GPU finishes commands in order, once the last query is done all are
+        GLint available = 0;
+        glGetQueryObjectiv(frame.last().query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available && int(m_gpuPending.size()) <= s_maxPendingFrames) {
+            return;
+        }
+
+        if (available) {
+            QVarLengthArray<qint64, 16> durations(m_entries.count());
+            std::fill(durations.begin(), durations.end(), -1);
+            GLuint64 previous = 0;
+            for (int i = 0; i < frame.count(); ++i) {
+                GLuint64 timestamp = 0;
+                glGetQueryObjectui64v(frame.at(i).query, GL_QUERY_RESULT, &timestamp);
+                const int entry = i > 0 ? frame.at(i - 1).entry : -1;
+                if (entry >= 0 && entry < durations.count()) {
+                    durations[entry] = qMax(durations[entry], qint64(0)) + qint64(timestamp - previous);
+                }
+                previous = timestamp;
+            }
+            for (int i = 0; i < durations.count(); ++i) {
+                if (durations.at(i) >= 0) {
+                    m_entries[i].gpu.add(durations.at(i));
+                }
+            }
+        }
+
+        for (const Timestamp &timestamp : frame) {
+            m_freeQueries << timestamp.query;
+        }
+        m_gpuPending.pop_front();
+    }
+}
+
+void EffectProfiler::recycleQueries()
+{
+    for (const QVector<Timestamp> &frame : m_gpuPending) {
+        for (const Timestamp &timestamp : frame) {
+            m_freeQueries << timestamp.query;
+        }
+    }
+    for (const Timestamp &timestamp : qAsConst(m_gpuFrame)) {
+        m_freeQueries << timestamp.query;
+    }
+    m_gpuPending.clear();
+    m_gpuFrame.clear();
+}
+
+void EffectProfiler::deleteQueries()
+{
+    recycleQueries();
+    if (!m_freeQueries.isEmpty()) {
+        glDeleteQueries(m_freeQueries.count(), m_freeQueries.constData());
+    }
+    m_freeQueries.clear();
+}
+
+QStringList EffectProfiler::names() const
+{
+    QStringList names;
+    for (const Entry &entry : m_entries) {
+        names << entry.name;
+    }
+    return names;
+}
+
+QVector<qint64> EffectProfiler::durations(const QString &name, Clock clock) const
+{
+    const Entry *entry = this->entry(name);
+    if (!entry) {
+        return QVector<qint64>();
+    }
+    return clock == Clock::Cpu ? entry->cpu.values() : entry->gpu.values();
+}
+
+QVector<int> EffectProfiler::histogram(const QString &name, Clock clock) const
+{
+    QVector<int> buckets(int(s_histogramBounds.size()) + 1, 0);
+    const QVector<qint64> values = durations(name, clock);
+    for (qint64 value : values) {
+        const auto bound = std::upper_bound(s_histogramBounds.begin(), s_histogramBounds.end(), value / 1000);
+        ++buckets[bound - s_histogramBounds.begin()];
+    }
+    return buckets;
+}
+
+QVariantMap EffectProfiler::summary() const
+{
+    QVariantMap summary;
+    for (const Entry &entry : m_entries) {
+        auto addClock = [this, &entry, &summary] (Clock clock, const QString &prefix) {
+            QVector<qint64> values = durations(entry.name, clock);
+            if (values.isEmpty()) {
+                return;
+            }
+            summary.insert(prefix + QStringLiteral(".frames"), values.count());
+            std::sort(values.begin(), values.end());
+            auto percentile = [&values] (int percent) {
+                // nearest rank
+                const int rank = qMax(1, (percent * values.count() + 99) / 100);
+                return values.at(rank - 1) / 1000;
+            };
+            summary.insert(prefix + QStringLiteral(".p50"), percentile(50));
+            summary.insert(prefix + QStringLiteral(".p95"), percentile(95));
+            summary.insert(prefix + QStringLiteral(".p99"), percentile(99));
+            summary.insert(prefix + QStringLiteral(".max"), values.last() / 1000);
+
+            QVariantList buckets;
+            const QVector<int> histogram = this->histogram(entry.name, clock);
+            for (int count : histogram) {
+                buckets << count;
+            }
+            summary.insert(prefix + QStringLiteral(".histogram"), buckets);
+        };
+        addClock(Clock::Cpu, entry.name + QStringLiteral(".cpu"));
+        addClock(Clock::Gpu, entry.name + QStringLiteral(".gpu"));
+    }
+    return summary;
+}
+
+}
@@ -0,0 +1,164 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#ifndef KWIN_EFFECTPROFILER_H
+#define KWIN_EFFECTPROFILER_H
+
+#include <kwin_export.h>
+
+#include <QHash>
+#include <QStack>
+#include <QStringList>
+#include <QVariantMap>
+#include <QVector>
+
+#include <array>
+#include <deque>
+#include <functional>
+
+namespace KWin
+{
+
+class Effect;
+
+/**
+ * @brief Attributes the CPU and GPU time of painting to the effects.
+ *
+ * The EffectsHandler calls enter before passing a paintScreen, paintWindow or drawWindow
+ * call on to an effect, or to the scene at the end of the chain, and leave once it returned.
+ * As effects call into the next one, the calls nest. The time between two of these points
+ * is accounted to the effect entered last which did not return yet, so every effect only
+ * gets the time spent in its own code. The outermost call makes up a frame, the durations
+ * of the last s_capacity frames an effect took part in are kept per effect.
+ *
+ * The GPU time is measured with GL_TIMESTAMP queries at the same points, as GL_TIME_ELAPSED
+ * queries cannot be nested. Their results are read back without waiting when a later frame
+ * starts. Frames whose results are not available after s_maxPendingFrames are dropped.
+ *
+ * The profiler is used from the compositing thread only and does nothing unless started.
+ **/
+class KWIN_EXPORT EffectProfiler
+{
+public:
+    enum class Clock {
+        Cpu,
+        Gpu
+    };
+
+    /**
+     * @p effectName is used to look up the name of an effect entered for the first time.
+     **/
+    explicit EffectProfiler(std::function<QString(Effect *)> effectName);
+    ~EffectProfiler();
+
+    bool isActive() const {
+        return m_active;
+    }
+    /**
+     * Starts profiling, with @p gpu also the GPU time. The timer queries are created
+     * in the OpenGL context current while painting.
+     **/
+    void start(bool gpu);
+    /**
+     * Stops profiling and deletes the timer queries, which needs the OpenGL context
+     * to be current. The recorded durations are kept.
+     **/
+    void stop();
+    /**
+     * Forgets the effects by pointer, to be called when effects got loaded or unloaded.
+     **/
+    void effectsChanged();
+    void clear();
+
+    /**
+     * Starts painting with @p effect, or with the scene if it is @c null.
+     **/
+    void enter(Effect *effect, qint64 timestamp);
+    void leave(qint64 timestamp);
+
+    /**
+     * @returns the names of the profiled effects, "scene" stands for the scene
+     **/
+    QStringList names() const;
+    /**
+     * @returns the durations in nanoseconds of the frames @p name took part in, oldest first
+     **/
+    QVector<qint64> durations(const QString &name, Clock clock) const;
+    /**
+     * @returns the number of durations falling into each of the histogram buckets
+     * @see s_histogramBounds
+     **/
+    QVector<int> histogram(const QString &name, Clock clock) const;
+    /**
+     * @returns the 50th, 95th and 99th percentile and the maximum in microseconds and the
+     * histogram of both clocks for each effect. Keys are like "blur.gpu.p95".
+     **/
+    QVariantMap summary() const;
+
+    static const int s_capacity = 256;
+    static const int s_maxPendingFrames = 8;
+    /**
+     * The upper bounds in microseconds of all but the last histogram bucket.
+     **/
+    static const std::array<qint64, 7> s_histogramBounds;
+
+private:
+    struct Durations {
+        void add(qint64 duration);
+        QVector<qint64> values() const;
+
+        std::array<qint64, s_capacity> ring;
+        quint64 written = 0;
+    };
+    struct Entry {
+        QString name;
+        Durations cpu;
+        Durations gpu;
+        qint64 frameCpu = 0;
+        bool inFrame = false;
+    };
+    struct Timestamp {
+        // the entry running from the query on, -1 once the frame ended
+        int entry;
+        quint32 query;
+    };
+
+    int entryIndex(Effect *effect);
+    const Entry *entry(const QString &name) const;
+    void account(qint64 timestamp);
+    void queryTimestamp(int entry);
+    void collectGpuResults();
+    void recycleQueries();
+    void deleteQueries();
+
+    std::function<QString(Effect *)> m_effectName;
+    bool m_active = false;
+    bool m_gpu = false;
+    QVector<Entry> m_entries;
+    QHash<Effect *, int> m_effects;
+    QStack<int> m_stack;
+    qint64 m_lastTimestamp = 0;
+    QVector<Timestamp> m_gpuFrame;
+    std::deque<QVector<Timestamp>> m_gpuPending;
+    QVector<quint32> m_freeQueries;
+};
+
+}
+
+#endif
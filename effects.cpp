@@ -41,10 +41,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "screens.h"
 #include "screenlockerwatcher.h"
 #include "thumbnailitem.h"
+#include "vblankclock.h"
 #include "virtualdesktops.h"
 #include "window_property_notify_x11_filter.h"
 #include "workspace.h"
 #include "kwinglutils.h"
+#include "kwinglplatform.h"
 
 #include <QDebug>
 #include <QDesktopWidget>
@@ -52,6 +54,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <Plasma/Theme>
 
 #include <assert.h>
+#include <algorithm>
 #include "composite.h"
 #include "xcbutils.h"
 #include "platform.h"
@@ -127,6 +130,14 @@ EffectsHandlerImpl::EffectsHandlerImpl(Compositor *compositor, Scene *scene)
     , m_currentRenderedDesktop(0)
     , m_effectLoader(new EffectLoader(this))
     , m_trackingCursorChanges(0)
+    , m_profiler([this] (Effect *effect) {
+            for (const EffectPair &pair : qAsConst(loaded_effects)) {
+                if (pair.second == effect) {
+                    return pair.first;
+                }
+            }
+            return QString();
+        })
 {
     qRegisterMetaType<QVector<KWin::EffectWindow*>>();
     connect(m_effectLoader, &AbstractEffectLoader::effectLoaded, this,
@@ -140,9 +151,6 @@ EffectsHandlerImpl::EffectsHandlerImpl(Compositor *compositor, Scene *scene)
     new EffectsAdaptor(this);
     QDBusConnection dbus = QDBusConnection::sessionBus();
     dbus.registerObject(QStringLiteral("/Effects"), this);
-    // init is important, otherwise causes crashes when quads are build before the first painting pass start
-    m_currentBuildQuadsIterator = m_activeEffects.constEnd();
-
     Workspace *ws = Workspace::self();
     VirtualDesktopManager *vds = VirtualDesktopManager::self();
     connect(ws, &Workspace::showingDesktopChanged,
@@ -256,11 +264,17 @@ EffectsHandlerImpl::EffectsHandlerImpl(Compositor *compositor, Scene *scene)
         );
     }
     reconfigure();
+
+    if (qgetenv("KWIN_EFFECT_PROFILING") == QByteArrayLiteral("1")) {
+        setEffectProfilingEnabled(true);
+    }
 }
 
 EffectsHandlerImpl::~EffectsHandlerImpl()
 {
     unloadAllEffects();
+    // the context is still current for deleting the timer queries
+    m_profiler.stop();
 }
 
 void EffectsHandlerImpl::unloadAllEffects()
@@ -373,10 +387,16 @@ void EffectsHandlerImpl::prePaintScreen(ScreenPrePaintData& data, int time)
 void EffectsHandlerImpl::paintScreen(int mask, QRegion region, ScreenPaintData& data)
 {
     if (m_currentPaintScreenIterator != m_activeEffects.constEnd()) {
-        (*m_currentPaintScreenIterator++)->paintScreen(mask, region, data);
+        Effect *effect = *m_currentPaintScreenIterator++;
+        enterProfiledCall(effect);
+        effect->paintScreen(mask, region, data);
+        leaveProfiledCall();
         --m_currentPaintScreenIterator;
-    } else
+    } else {
+        enterProfiledCall(nullptr);
         m_scene->finalPaintScreen(mask, region, data);
+        leaveProfiledCall();
+    }
 }
 
 void EffectsHandlerImpl::paintDesktop(int desktop, int mask, QRegion region, ScreenPaintData &data)
@@ -416,10 +436,16 @@ void EffectsHandlerImpl::prePaintWindow(EffectWindow* w, WindowPrePaintData& dat
 void EffectsHandlerImpl::paintWindow(EffectWindow* w, int mask, QRegion region, WindowPaintData& data)
 {
     if (m_currentPaintWindowIterator != m_activeEffects.constEnd()) {
-        (*m_currentPaintWindowIterator++)->paintWindow(w, mask, region, data);
+        Effect *effect = *m_currentPaintWindowIterator++;
+        enterProfiledCall(effect);
+        effect->paintWindow(w, mask, region, data);
+        leaveProfiledCall();
         --m_currentPaintWindowIterator;
-    } else
+    } else {
+        enterProfiledCall(nullptr);
         m_scene->finalPaintWindow(static_cast<EffectWindowImpl*>(w), mask, region, data);
+        leaveProfiledCall();
+    }
 }
 
 void EffectsHandlerImpl::paintEffectFrame(EffectFrame* frame, QRegion region, double opacity, double frameOpacity)
@@ -453,24 +479,62 @@ Effect *EffectsHandlerImpl::provides(Effect::Feature ef)
 void EffectsHandlerImpl::drawWindow(EffectWindow* w, int mask, QRegion region, WindowPaintData& data)
 {
     if (m_currentDrawWindowIterator != m_activeEffects.constEnd()) {
-        (*m_currentDrawWindowIterator++)->drawWindow(w, mask, region, data);
+        Effect *effect = *m_currentDrawWindowIterator++;
+        enterProfiledCall(effect);
+        effect->drawWindow(w, mask, region, data);
+        leaveProfiledCall();
         --m_currentDrawWindowIterator;
-    } else
+    } else {
+        enterProfiledCall(nullptr);
         m_scene->finalDrawWindow(static_cast<EffectWindowImpl*>(w), mask, region, data);
+        leaveProfiledCall();
+    }
+}
+
+inline void EffectsHandlerImpl::enterProfiledCall(Effect *effect)
+{
+    if (Q_UNLIKELY(m_profiler.isActive())) {
+        m_profiler.enter(effect, VBlankClock::now());
+    }
+}
+
+inline void EffectsHandlerImpl::leaveProfiledCall()
+{
+    if (Q_UNLIKELY(m_profiler.isActive())) {
+        m_profiler.leave(VBlankClock::now());
+    }
+}
+
+void EffectsHandlerImpl::setEffectProfilingEnabled(bool enabled)
+{
+    if (enabled == m_profiler.isActive()) {
+        return;
+    }
+    if (!enabled) {
+        makeOpenGLContextCurrent();
+        m_profiler.stop();
+        return;
+    }
+    // GL_TIMESTAMP queries are not part of OpenGL ES
+    const bool gpu = isOpenGLCompositing() && !GLPlatform::instance()->isGLES() &&
+            (hasGLVersion(3, 3) || hasGLExtension(QByteArrayLiteral("GL_ARB_timer_query")));
+    m_profiler.start(gpu);
 }
 
 void EffectsHandlerImpl::buildQuads(EffectWindow* w, WindowQuadList& quadList)
 {
-    static bool initIterator = true;
+    // quads may be built on several threads at once, each walks the chain on its own
+    static thread_local bool initIterator = true;
+    static thread_local EffectsIterator currentIterator;
     if (initIterator) {
-        m_currentBuildQuadsIterator = m_activeEffects.constBegin();
+        currentIterator = m_activeEffects.constBegin();
         initIterator = false;
     }
-    if (m_currentBuildQuadsIterator != m_activeEffects.constEnd()) {
-        (*m_currentBuildQuadsIterator++)->buildQuads(w, quadList);
-        --m_currentBuildQuadsIterator;
+    if (currentIterator != m_activeEffects.constEnd()) {
+        (*currentIterator++)->buildQuads(w, quadList);
+        --currentIterator;
     }
-    if (m_currentBuildQuadsIterator == m_activeEffects.constBegin())
+    if (currentIterator == m_activeEffects.constBegin())
         initIterator = true;
 }
 
@@ -783,6 +847,40 @@ bool EffectsHandlerImpl::hasKeyboardGrab() const
     return keyboard_grab_effect != NULL;
 }
 
+bool EffectsHandlerImpl::blocksDirectScanout() const
+{
+    if (fullscreen_effect) {
+        return true;
+    }
+    // m_activeEffects is only valid while painting
+    return std::any_of(loaded_effects.constBegin(), loaded_effects.constEnd(),
+        [] (const EffectPair &effect) {
+            return effect.second->isActive() && effect.second->blocksDirectScanout();
+        }
+    );
+}
+
+bool EffectsHandlerImpl::needsOccludedWindows() const
+{
+    if (fullscreen_effect) {
+        return true;
+    }
+    return std::any_of(m_activeEffects.constBegin(), m_activeEffects.constEnd(),
+        [] (Effect *effect) {
+            return effect->needsOccludedWindows();
+        }
+    );
+}
+
+bool EffectsHandlerImpl::supportsConcurrentBuildQuads() const
+{
+    return std::all_of(m_activeEffects.constBegin(), m_activeEffects.constEnd(),
+        [] (Effect *effect) {
+            return effect->supportsConcurrentBuildQuads();
+        }
+    );
+}
+
 void EffectsHandlerImpl::desktopResized(const QSize &size)
 {
     m_scene->screenGeometryChanged(size);
@@ -1427,6 +1525,7 @@ void EffectsHandlerImpl::effectsChanged()
         std::back_inserter(loaded_effects));
 
     m_activeEffects.reserve(loaded_effects.count());
+    m_profiler.effectsChanged();
 }
 
 QStringList EffectsHandlerImpl::activeEffects() const
@@ -24,6 +24,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "kwineffects.h"
 
+#include "effectprofiler.h"
 #include "scene.h"
 
 #include <QHash>
@@ -204,6 +205,25 @@ public:
     void startPaint();
     void grabbedKeyboardEvent(QKeyEvent* e);
     bool hasKeyboardGrab() const;
+    /**
+     * @returns whether any active Effect needs to paint on top of a fullscreen window,
+     * which prevents scanning the window out directly.
+     **/
+    bool blocksDirectScanout() const;
+    /**
+     * @returns whether any active Effect may need windows hidden behind opaque windows.
+     **/
+    bool needsOccludedWindows() const;
+    /**
+     * @returns whether any Effect takes part in painting the current frame.
+     **/
+    /**
+     * @returns whether all active Effects allow building window quads from other threads.
+     **/
+    bool supportsConcurrentBuildQuads() const;
+    bool hasActiveEffects() const {
+        return !m_activeEffects.isEmpty();
+    }
     void desktopResized(const QSize &size);
 
     void reloadEffect(Effect *effect) override;
@@ -259,6 +279,17 @@ public:
         return registered_atoms.contains(atom);
     }
 
+    /**
+     * Starts or stops measuring the time the effects spend in paintScreen, paintWindow
+     * and drawWindow. With OpenGL compositing this includes the GPU time if the driver
+     * supports timer queries. Profiling starts right away if the environment variable
+     * KWIN_EFFECT_PROFILING is set to 1.
+     **/
+    void setEffectProfilingEnabled(bool enabled);
+    const EffectProfiler *effectProfiler() const {
+        return &m_profiler;
+    }
+
 public Q_SLOTS:
     void slotCurrentTabAboutToChange(EffectWindow* from, EffectWindow* to);
     void slotTabAdded(EffectWindow* from, EffectWindow* to);
@@ -328,6 +359,8 @@ protected:
 
 private:
     void registerPropertyType(long atom, bool reg);
+    void enterProfiledCall(Effect *effect);
+    void leaveProfiledCall();
     typedef QVector< Effect*> EffectsList;
     typedef EffectsList::const_iterator EffectsIterator;
     EffectsList m_activeEffects;
@@ -335,7 +368,6 @@ private:
     EffectsIterator m_currentPaintWindowIterator;
     EffectsIterator m_currentPaintEffectFrameIterator;
     EffectsIterator m_currentPaintScreenIterator;
-    EffectsIterator m_currentBuildQuadsIterator;
     typedef QHash< QByteArray, QList< Effect*> > PropertyEffectMap;
     PropertyEffectMap m_propertiesForEffects;
     QHash<QByteArray, qulonglong> m_managedProperties;
@@ -347,6 +379,7 @@ private:
     EffectLoader *m_effectLoader;
     int m_trackingCursorChanges;
     std::unique_ptr<WindowPropertyNotifyX11Filter> m_x11WindowPropertyNotify;
+    EffectProfiler m_profiler;
 };
 
 class EffectWindowImpl : public EffectWindow
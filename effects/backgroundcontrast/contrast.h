@@ -64,6 +64,19 @@ public:
         return 76;
     }
 
+    bool blocksDirectScanout() const override {
+        // only paints behind translucent windows
+        return false;
+    }
+
+    bool needsOccludedWindows() const override {
+        return false;
+    }
+
+    bool supportsConcurrentBuildQuads() const override {
+        return true;
+    }
+
 public Q_SLOTS:
     void slotWindowAdded(KWin::EffectWindow *w);
     void slotWindowDeleted(KWin::EffectWindow *w);
@@ -0,0 +1,111 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "framescheduler.h"
+#include "vblankclock.h"
+
+#include <algorithm>
+
+namespace KWin
+{
+
+const int FrameScheduler::s_windowSize;
+const qint64 FrameScheduler::s_bucketWidth;
+const int FrameScheduler::s_bucketCount;
+
+static const qint64 s_defaultSafetyMargin = 1000 * 1000;
+
+static int bucketForDuration(qint64 duration)
+{
+    return qBound(0, int(duration / FrameScheduler::s_bucketWidth), FrameScheduler::s_bucketCount - 1);
+}
+
+FrameScheduler::FrameScheduler()
+    : m_safetyMargin(s_defaultSafetyMargin)
+{
+    if (qEnvironmentVariableIsSet("KWIN_FRAME_SAFETY_MARGIN")) {
+        // given in microseconds like the VBlankTime option
+        m_safetyMargin = qint64(qEnvironmentVariableIntValue("KWIN_FRAME_SAFETY_MARGIN")) * 1000;
+    }
+    reset();
+}
+
+void FrameScheduler::reset()
+{
+    m_samples.fill(0);
+    m_histogram.fill(0);
+    m_nextSample = 0;
+    m_sampleCount = 0;
+}
+
+void FrameScheduler::addPaintTime(qint64 duration)
+{
+    duration = qMax(qint64(0), duration);
+    if (m_sampleCount == s_windowSize) {
+        // the window is full, the oldest sample drops out of the histogram
+        m_histogram[bucketForDuration(m_samples[m_nextSample])]--;
+    } else {
+        m_sampleCount++;
+    }
+    m_samples[m_nextSample] = duration;
+    m_histogram[bucketForDuration(duration)]++;
+    m_nextSample = (m_nextSample + 1) % s_windowSize;
+}
+
+qint64 FrameScheduler::percentile(int percent) const
+{
+    const int wanted = (m_sampleCount * percent + 99) / 100;
+    int seen = 0;
+    for (int i = 0; i < s_bucketCount - 1; ++i) {
+        seen += m_histogram[i];
+        if (seen >= wanted) {
+            // upper bound of the bucket, we rather start a little too early
+            return (i + 1) * s_bucketWidth;
+        }
+    }
+    // the overflow bucket has no upper bound, use the longest sample instead
+    return *std::max_element(m_samples.begin(), m_samples.begin() + m_sampleCount);
+}
+
+qint64 FrameScheduler::predictedPaintTime() const
+{
+    if (m_sampleCount == 0) {
+        return -1;
+    }
+    return percentile(95) + m_safetyMargin;
+}
+
+qint64 FrameScheduler::nextPaintStart(const VBlankClock *clock, int framesQueued) const
+{
+    const qint64 now = VBlankClock::now();
+    const qint64 paintTime = predictedPaintTime();
+    if (paintTime < 0) {
+        // nothing known yet, start right away
+        return now;
+    }
+    qint64 start = clock->nextVBlank() + framesQueued * clock->refreshInterval() - paintTime;
+    // if we cannot make it for the next vblank anymore, go for the one after
+    // but still start as late as possible
+    while (start < now) {
+        start += clock->refreshInterval();
+    }
+    return start;
+}
+
+}
@@ -0,0 +1,95 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#ifndef KWIN_FRAMESCHEDULER_H
+#define KWIN_FRAMESCHEDULER_H
+
+#include <kwin_export.h>
+
+#include <QtGlobal>
+
+#include <array>
+
+namespace KWin
+{
+
+class VBlankClock;
+
+/**
+ * @brief Decides when a compositing pass has to start to make it in time for a vblank.
+ *
+ * The scheduler keeps a rolling histogram over the durations of the last passes. A pass
+ * is started the 95th percentile of these durations plus a safety margin before the
+ * predicted vblank, that is as late as possible to keep input latency low while still
+ * making it in time.
+ *
+ * All times are in nanoseconds.
+ **/
+class KWIN_EXPORT FrameScheduler
+{
+public:
+    FrameScheduler();
+
+    /**
+     * Adds the @p duration of a finished compositing pass to the histogram.
+     **/
+    void addPaintTime(qint64 duration);
+    /**
+     * @returns the expected duration of the next pass including the safety margin,
+     * @c -1 if there is no sample yet.
+     **/
+    qint64 predictedPaintTime() const;
+    /**
+     * @returns the time at which the next pass should start to be finished before
+     * a vblank of @p clock. This is never in the past.
+     *
+     * @p framesQueued is the number of frames which still wait for scanout. Each of
+     * them takes one vblank, the pass aims for the first one after them.
+     **/
+    qint64 nextPaintStart(const VBlankClock *clock, int framesQueued = 0) const;
+
+    qint64 safetyMargin() const {
+        return m_safetyMargin;
+    }
+    void setSafetyMargin(qint64 margin) {
+        m_safetyMargin = margin;
+    }
+    int sampleCount() const {
+        return m_sampleCount;
+    }
+    void reset();
+
+    // number of passes the histogram covers
+    static const int s_windowSize = 64;
+    // width of one histogram bucket
+    static const qint64 s_bucketWidth = 250 * 1000;
+    static const int s_bucketCount = 128;
+
+private:
+    qint64 percentile(int percent) const;
+    std::array<qint64, s_windowSize> m_samples;
+    std::array<int, s_bucketCount> m_histogram;
+    int m_nextSample = 0;
+    int m_sampleCount = 0;
+    qint64 m_safetyMargin;
+};
+
+}
+
+#endif
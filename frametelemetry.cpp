@@ -0,0 +1,212 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "frametelemetry.h"
+#include "vblankclock.h"
+
+#include <QDataStream>
+
+#include <algorithm>
+#include <functional>
+
+namespace KWin
+{
+
+const int FrameTelemetry::s_capacity;
+const quint32 FrameTelemetry::s_dumpVersion;
+
+static const quint32 s_fieldCount = sizeof(FrameTiming) / sizeof(qint64);
+static_assert(sizeof(FrameTiming) == s_fieldCount * sizeof(qint64), "FrameTiming must only consist of qint64");
+
+FrameTelemetry::FrameTelemetry()
+{
+}
+
+void FrameTelemetry::beginFrame(int screen, qint64 scheduled, qint64 target)
+{
+    m_current = FrameTiming();
+    m_current.screen = screen;
+    m_current.scheduled = scheduled;
+    m_current.target = target;
+    m_current.start = VBlankClock::now();
+    m_phase = Phase::Damage;
+    m_phaseStart = m_current.start;
+    m_recording = true;
+}
+
+void FrameTelemetry::enterPhase(Phase phase)
+{
+    if (!m_recording) {
+        return;
+    }
+    const qint64 now = VBlankClock::now();
+    const qint64 elapsed = now - m_phaseStart;
+    switch (m_phase) {
+    case Phase::Damage:
+        m_current.damageDuration += elapsed;
+        break;
+    case Phase::PrePaint:
+        m_current.prePaintDuration += elapsed;
+        break;
+    case Phase::Paint:
+        m_current.paintDuration += elapsed;
+        break;
+    case Phase::Swap:
+        m_current.swapDuration += elapsed;
+        break;
+    }
+    m_phase = phase;
+    m_phaseStart = now;
+}
+
+void FrameTelemetry::endFrame()
+{
+    if (!m_recording) {
+        return;
+    }
+    // account the time of the last phase
+    enterPhase(m_phase);
+    m_recording = false;
+    addFrame(m_current);
+}
+
+void FrameTelemetry::abortFrame()
+{
+    m_recording = false;
+}
+
+void FrameTelemetry::addFrame(const FrameTiming &frame)
+{
+    m_frames[m_written % s_capacity] = frame;
+    m_written++;
+}
+
+void FrameTelemetry::notifyPresented(int screen, qint64 timestamp, int framesQueued)
+{
+    if (timestamp <= 0) {
+        return;
+    }
+    const int count = frameCount();
+    for (int i = 1; i <= count; ++i) {
+        FrameTiming &frame = m_frames[(m_written - i) % s_capacity];
+        if (frame.screen != screen || frame.start >= timestamp) {
+            continue;
+        }
+        if (framesQueued > 0) {
+            framesQueued--;
+            continue;
+        }
+        if (frame.presented == 0) {
+            frame.presented = timestamp;
+        }
+        // older frames got presented already or were replaced
+        return;
+    }
+}
+
+int FrameTelemetry::frameCount() const
+{
+    return int(qMin(m_written, quint64(s_capacity)));
+}
+
+QVector<FrameTiming> FrameTelemetry::frames() const
+{
+    const int count = frameCount();
+    QVector<FrameTiming> frames;
+    frames.reserve(count);
+    for (quint64 i = m_written - count; i < m_written; ++i) {
+        frames << m_frames[i % s_capacity];
+    }
+    return frames;
+}
+
+void FrameTelemetry::clear()
+{
+    m_written = 0;
+}
+
+QByteArray FrameTelemetry::dump() const
+{
+    const QVector<FrameTiming> frames = this->frames();
+    QByteArray data;
+    data.reserve(3 * sizeof(quint32) + frames.count() * sizeof(FrameTiming));
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream << s_dumpVersion << s_fieldCount << quint32(frames.count());
+    for (const FrameTiming &frame : frames) {
+        const qint64 *fields = reinterpret_cast<const qint64*>(&frame);
+        for (quint32 i = 0; i < s_fieldCount; ++i) {
+            stream << fields[i];
+        }
+    }
+    return data;
+}
+
+QVariantMap FrameTelemetry::summary() const
+{
+    const QVector<FrameTiming> frames = this->frames();
+    QVariantMap summary;
+    summary.insert(QStringLiteral("frames"), frames.count());
+
+    auto addPercentiles = [&frames, &summary] (const QString &name, std::function<qint64(const FrameTiming &)> value) {
+        QVector<qint64> values;
+        values.reserve(frames.count());
+        for (const FrameTiming &frame : frames) {
+            const qint64 v = value(frame);
+            if (v >= 0) {
+                values << v;
+            }
+        }
+        if (values.isEmpty()) {
+            return;
+        }
+        std::sort(values.begin(), values.end());
+        auto percentile = [&values] (int percent) {
+            // nearest rank
+            const int rank = qMax(1, (percent * values.count() + 99) / 100);
+            return values.at(rank - 1) / 1000;
+        };
+        summary.insert(name + QStringLiteral(".p50"), percentile(50));
+        summary.insert(name + QStringLiteral(".p95"), percentile(95));
+        summary.insert(name + QStringLiteral(".p99"), percentile(99));
+        summary.insert(name + QStringLiteral(".max"), values.last() / 1000);
+    };
+    addPercentiles(QStringLiteral("damage"), [] (const FrameTiming &f) { return f.damageDuration; });
+    addPercentiles(QStringLiteral("prePaint"), [] (const FrameTiming &f) { return f.prePaintDuration; });
+    addPercentiles(QStringLiteral("paint"), [] (const FrameTiming &f) { return f.paintDuration; });
+    addPercentiles(QStringLiteral("swap"), [] (const FrameTiming &f) { return f.swapDuration; });
+    addPercentiles(QStringLiteral("total"),
+        [] (const FrameTiming &f) {
+            return f.damageDuration + f.prePaintDuration + f.paintDuration + f.swapDuration;
+        }
+    );
+    addPercentiles(QStringLiteral("wakeupDelay"),
+        [] (const FrameTiming &f) {
+            return f.target != 0 ? qMax(qint64(0), f.start - f.target) : qint64(-1);
+        }
+    );
+    addPercentiles(QStringLiteral("latency"),
+        [] (const FrameTiming &f) {
+            return f.presented != 0 ? f.presented - f.start : qint64(-1);
+        }
+    );
+    return summary;
+}
+
+}
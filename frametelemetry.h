@@ -0,0 +1,137 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#ifndef KWIN_FRAMETELEMETRY_H
+#define KWIN_FRAMETELEMETRY_H
+
+#include <kwin_export.h>
+
+#include <QByteArray>
+#include <QVariantMap>
+#include <QVector>
+
+#include <array>
+
+namespace KWin
+{
+
+/**
+ * The timing of one compositing pass. Points in time are CLOCK_MONOTONIC timestamps,
+ * durations are in nanoseconds. A value of @c 0 means unknown.
+ *
+ * All members are 64 bit so that the binary dump is a plain array of them.
+ **/
+struct FrameTiming
+{
+    // the screen the pass painted, -1 if it painted all screens
+    qint64 screen = -1;
+    // when the pass got scheduled and when it was supposed to start
+    qint64 scheduled = 0;
+    qint64 target = 0;
+    // when performCompositing started
+    qint64 start = 0;
+    qint64 damageDuration = 0;
+    qint64 prePaintDuration = 0;
+    qint64 paintDuration = 0;
+    qint64 swapDuration = 0;
+    // when the frame got presented, as reported by the platform
+    qint64 presented = 0;
+};
+
+/**
+ * @brief Records the timing of the last compositing passes.
+ *
+ * The frames are kept in a fixed size ring buffer, recording neither locks nor allocates.
+ * The Compositor starts a frame with beginFrame, the different parts of the pass switch
+ * the phase with enterPhase and endFrame adds the frame to the ring buffer. The time
+ * between two phase switches is accounted to the phase which was active, so a pass
+ * painting multiple screens sums up the phases of all screens.
+ *
+ * The recorder is used from the compositing thread only.
+ **/
+class KWIN_EXPORT FrameTelemetry
+{
+public:
+    enum class Phase {
+        Damage,
+        PrePaint,
+        Paint,
+        Swap
+    };
+
+    FrameTelemetry();
+
+    void beginFrame(int screen, qint64 scheduled, qint64 target);
+    void enterPhase(Phase phase);
+    void endFrame();
+    /**
+     * Discards the frame started by beginFrame, e.g. because there was nothing to paint.
+     **/
+    void abortFrame();
+    bool isRecording() const {
+        return m_recording;
+    }
+
+    /**
+     * Adds a finished @p frame to the ring buffer.
+     **/
+    void addFrame(const FrameTiming &frame);
+    /**
+     * Sets the presentation @p timestamp of the last frame of @p screen which started
+     * before it and got not presented yet. The last @p framesQueued frames of @p screen
+     * are still waiting for scanout and are skipped.
+     **/
+    void notifyPresented(int screen, qint64 timestamp, int framesQueued = 0);
+
+    /**
+     * @returns the recorded frames, oldest first
+     **/
+    QVector<FrameTiming> frames() const;
+    int frameCount() const;
+    void clear();
+
+    /**
+     * Serializes all recorded frames: a little endian header of quint32 version,
+     * quint32 number of fields per frame and quint32 number of frames, followed by
+     * the frames with their fields as little endian qint64 in declaration order.
+     **/
+    QByteArray dump() const;
+    /**
+     * @returns the 50th, 95th and 99th percentile and the maximum of each phase, the
+     * whole pass and the latency from the start of the pass to the presentation in
+     * microseconds. Keys are like "paint.p95".
+     **/
+    QVariantMap summary() const;
+
+    static const int s_capacity = 1024;
+    static const quint32 s_dumpVersion = 1;
+
+private:
+    std::array<FrameTiming, s_capacity> m_frames;
+    // total number of frames added, the next one goes to m_written % s_capacity
+    quint64 m_written = 0;
+    FrameTiming m_current;
+    Phase m_phase = Phase::Damage;
+    qint64 m_phaseStart = 0;
+    bool m_recording = false;
+};
+
+}
+
+#endif
@@ -41,6 +41,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <ksharedconfig.h>
 #include <kconfiggroup.h>
 
+#include <algorithm>
 #include <assert.h>
 
 #include <KWayland/Server/surface_interface.h>
@@ -619,6 +620,21 @@ bool Effect::isActive() const
     return true;
 }
 
+bool Effect::blocksDirectScanout() const
+{
+    return true;
+}
+
+bool Effect::needsOccludedWindows() const
+{
+    return true;
+}
+
+bool Effect::supportsConcurrentBuildQuads() const
+{
+    return false;
+}
+
 QString Effect::debug(const QString &) const
 {
     return QString();
@@ -1475,6 +1491,434 @@ bool WindowQuadList::isTransformed() const
     return false;
 }
 
+/***************************************************************
+ WindowQuadBuffer
+***************************************************************/
+
+static_assert(sizeof(GLVertex2D) == 4 * sizeof(float), "GLVertex2D has to be four packed floats");
+
+WindowQuadBuffer::WindowQuadBuffer()
+{
+}
+
+WindowQuadBuffer::WindowQuadBuffer(const WindowQuadList &quads)
+{
+    append(quads);
+}
+
+void WindowQuadBuffer::clear()
+{
+    // keeps the capacity
+    m_x.clear();
+    m_y.clear();
+    m_u.clear();
+    m_v.clear();
+    m_info.clear();
+}
+
+void WindowQuadBuffer::reserve(int quads)
+{
+    m_x.reserve(quads * 4);
+    m_y.reserve(quads * 4);
+    m_u.reserve(quads * 4);
+    m_v.reserve(quads * 4);
+    m_info.reserve(quads);
+}
+
+void WindowQuadBuffer::append(const WindowQuad &quad)
+{
+    for (int i = 0; i < 4; ++i) {
+        const WindowVertex &vertex = quad[i];
+        m_x.append(vertex.x());
+        m_y.append(vertex.y());
+        m_u.append(vertex.u());
+        m_v.append(vertex.v());
+    }
+    m_info.append(QuadInfo{quad.type(), quad.id(), quad.uvAxisSwapped()});
+}
+
+void WindowQuadBuffer::append(const WindowQuadList &quads)
+{
+    reserve(count() + quads.count());
+    for (const WindowQuad &quad : quads) {
+        append(quad);
+    }
+}
+
+void WindowQuadBuffer::appendQuad(const WindowQuadBuffer &source, int index)
+{
+    const int first = index * 4;
+    for (int i = first; i < first + 4; ++i) {
+        m_x.append(source.m_x.at(i));
+        m_y.append(source.m_y.at(i));
+        m_u.append(source.m_u.at(i));
+        m_v.append(source.m_v.at(i));
+    }
+    m_info.append(source.m_info.at(index));
+}
+
+WindowQuad WindowQuadBuffer::at(int index) const
+{
+    const QuadInfo &info = m_info.at(index);
+    WindowQuad quad(info.type, info.id);
+    for (int i = 0; i < 4; ++i) {
+        const int vertex = index * 4 + i;
+        quad[i] = WindowVertex(m_x.at(vertex), m_y.at(vertex), m_u.at(vertex), m_v.at(vertex));
+    }
+    quad.setUVAxisSwapped(info.uvSwapped);
+    return quad;
+}
+
+WindowQuadList WindowQuadBuffer::toList() const
+{
+    WindowQuadList ret;
+    ret.reserve(count());
+    for (int i = 0; i < count(); ++i) {
+        ret.append(at(i));
+    }
+    return ret;
+}
+
+double WindowQuadBuffer::left(int index) const
+{
+    const float *x = m_x.constData() + index * 4;
+    return qMin(qMin(x[0], x[1]), qMin(x[2], x[3]));
+}
+
+double WindowQuadBuffer::right(int index) const
+{
+    const float *x = m_x.constData() + index * 4;
+    return qMax(qMax(x[0], x[1]), qMax(x[2], x[3]));
+}
+
+double WindowQuadBuffer::top(int index) const
+{
+    const float *y = m_y.constData() + index * 4;
+    return qMin(qMin(y[0], y[1]), qMin(y[2], y[3]));
+}
+
+double WindowQuadBuffer::bottom(int index) const
+{
+    const float *y = m_y.constData() + index * 4;
+    return qMax(qMax(y[0], y[1]), qMax(y[2], y[3]));
+}
+
+// same as WindowQuad::makeSubQuad
+void WindowQuadBuffer::appendSubQuad(const WindowQuadBuffer &source, int index, double x1, double y1, double x2, double y2)
+{
+    const double left = source.left(index);
+    const double top = source.top(index);
+    assert(x1 < x2 && y1 < y2 && x1 >= left && x2 <= source.right(index) && y1 >= top && y2 <= source.bottom(index));
+    const QuadInfo &info = source.m_info.at(index);
+    const float *u = source.m_u.constData() + index * 4;
+    const float *v = source.m_v.constData() + index * 4;
+
+    const double width = source.right(index) - left;
+    const double height = source.bottom(index) - top;
+    const double texWidth = u[2] - u[0];
+    const double texHeight = v[2] - v[0];
+
+    // vertices are clockwise starting from topleft
+    m_x << x1 << x2 << x2 << x1;
+    m_y << y1 << y1 << y2 << y2;
+    if (!info.uvSwapped) {
+        const float u0 = (x1 - left) / width  * texWidth  + u[0];
+        const float u1 = (x2 - left) / width  * texWidth  + u[0];
+        const float v0 = (y1 - top)  / height * texHeight + v[0];
+        const float v1 = (y2 - top)  / height * texHeight + v[0];
+        m_u << u0 << u1 << u1 << u0;
+        m_v << v0 << v0 << v1 << v1;
+    } else {
+        const float u0 = (y1 - top)  / height * texWidth  + u[0];
+        const float u1 = (y2 - top)  / height * texWidth  + u[0];
+        const float v0 = (x1 - left) / width  * texHeight + v[0];
+        const float v1 = (x2 - left) / width  * texHeight + v[0];
+        m_u << u0 << u0 << u1 << u1;
+        m_v << v0 << v1 << v1 << v0;
+    }
+    m_info.append(info);
+}
+
+WindowQuadBuffer WindowQuadBuffer::splitAtX(double x) const
+{
+    WindowQuadBuffer ret;
+    ret.reserve(count() * 2);
+    for (int i = 0; i < count(); ++i) {
+        const float *vx = m_x.constData() + i * 4;
+        bool wholeLeft = true;
+        bool wholeRight = true;
+        for (int j = 0; j < 4; ++j) {
+            if (vx[j] < x)
+                wholeRight = false;
+            if (vx[j] > x)
+                wholeLeft = false;
+        }
+        // no size or whole in one split part
+        if (wholeLeft || wholeRight || top(i) == bottom(i) || left(i) == right(i)) {
+            ret.appendQuad(*this, i);
+            continue;
+        }
+        ret.appendSubQuad(*this, i, left(i), top(i), x, bottom(i));
+        ret.appendSubQuad(*this, i, x, top(i), right(i), bottom(i));
+    }
+    return ret;
+}
+
+WindowQuadBuffer WindowQuadBuffer::splitAtY(double y) const
+{
+    WindowQuadBuffer ret;
+    ret.reserve(count() * 2);
+    for (int i = 0; i < count(); ++i) {
+        const float *vy = m_y.constData() + i * 4;
+        bool wholeTop = true;
+        bool wholeBottom = true;
+        for (int j = 0; j < 4; ++j) {
+            if (vy[j] < y)
+                wholeBottom = false;
+            if (vy[j] > y)
+                wholeTop = false;
+        }
+        if (wholeTop || wholeBottom || top(i) == bottom(i) || left(i) == right(i)) {
+            ret.appendQuad(*this, i);
+            continue;
+        }
+        ret.appendSubQuad(*this, i, left(i), top(i), right(i), y);
+        ret.appendSubQuad(*this, i, left(i), y, right(i), bottom(i));
+    }
+    return ret;
+}
+
+WindowQuadBuffer WindowQuadBuffer::makeGrid(int maxQuadSize) const
+{
+    if (isEmpty())
+        return *this;
+
+    // Find the bounding rectangle
+    double left = this->left(0);
+    double right = this->right(0);
+    double top = this->top(0);
+    double bottom = this->bottom(0);
+    for (int i = 1; i < count(); ++i) {
+        left   = qMin(left,   this->left(i));
+        right  = qMax(right,  this->right(i));
+        top    = qMin(top,    this->top(i));
+        bottom = qMax(bottom, this->bottom(i));
+    }
+
+    WindowQuadBuffer ret;
+    for (int i = 0; i < count(); ++i) {
+        const double quadLeft   = this->left(i);
+        const double quadRight  = this->right(i);
+        const double quadTop    = this->top(i);
+        const double quadBottom = this->bottom(i);
+
+        // sanity check, see BUG 390953
+        if (quadLeft == quadRight || quadTop == quadBottom) {
+            ret.appendQuad(*this, i);
+            continue;
+        }
+
+        // Compute the top-left corner of the first intersecting grid cell
+        const double xBegin = left + qFloor((quadLeft - left) / maxQuadSize) * maxQuadSize;
+        const double yBegin = top  + qFloor((quadTop  - top)  / maxQuadSize) * maxQuadSize;
+
+        // Loop over all intersecting cells and add sub-quads
+        for (double y = yBegin; y < quadBottom; y += maxQuadSize) {
+            const double y0 = qMax(y, quadTop);
+            const double y1 = qMin(quadBottom, y + maxQuadSize);
+
+            for (double x = xBegin; x < quadRight; x += maxQuadSize) {
+                const double x0 = qMax(x, quadLeft);
+                const double x1 = qMin(quadRight, x + maxQuadSize);
+
+                ret.appendSubQuad(*this, i, x0, y0, x1, y1);
+            }
+        }
+    }
+
+    return ret;
+}
+
+WindowQuadBuffer WindowQuadBuffer::makeRegularGrid(int xSubdivisions, int ySubdivisions) const
+{
+    if (isEmpty())
+        return *this;
+
+    // Find the bounding rectangle
+    double left = this->left(0);
+    double right = this->right(0);
+    double top = this->top(0);
+    double bottom = this->bottom(0);
+    for (int i = 1; i < count(); ++i) {
+        left   = qMin(left,   this->left(i));
+        right  = qMax(right,  this->right(i));
+        top    = qMin(top,    this->top(i));
+        bottom = qMax(bottom, this->bottom(i));
+    }
+
+    const double xIncrement = (right - left) / xSubdivisions;
+    const double yIncrement = (bottom - top) / ySubdivisions;
+
+    WindowQuadBuffer ret;
+    ret.reserve(xSubdivisions * ySubdivisions);
+    for (int i = 0; i < count(); ++i) {
+        const double quadLeft   = this->left(i);
+        const double quadRight  = this->right(i);
+        const double quadTop    = this->top(i);
+        const double quadBottom = this->bottom(i);
+
+        // sanity check, see BUG 390953
+        if (quadLeft == quadRight || quadTop == quadBottom) {
+            ret.appendQuad(*this, i);
+            continue;
+        }
+
+        // Compute the top-left corner of the first intersecting grid cell
+        const double xBegin = left + qFloor((quadLeft - left) / xIncrement) * xIncrement;
+        const double yBegin = top  + qFloor((quadTop  - top)  / yIncrement) * yIncrement;
+
+        // Loop over all intersecting cells and add sub-quads
+        for (double y = yBegin; y < quadBottom; y += yIncrement) {
+            const double y0 = qMax(y, quadTop);
+            const double y1 = qMin(quadBottom, y + yIncrement);
+
+            for (double x = xBegin; x < quadRight; x += xIncrement) {
+                const double x0 = qMax(x, quadLeft);
+                const double x1 = qMin(quadRight, x + xIncrement);
+
+                ret.appendSubQuad(*this, i, x0, y0, x1, y1);
+            }
+        }
+    }
+
+    return ret;
+}
+
+void WindowQuadBuffer::transform(const QMatrix4x4 &matrix)
+{
+    const float m00 = matrix(0, 0);
+    const float m01 = matrix(0, 1);
+    const float m03 = matrix(0, 3);
+    const float m10 = matrix(1, 0);
+    const float m11 = matrix(1, 1);
+    const float m13 = matrix(1, 3);
+    float *x = m_x.data();
+    float *y = m_y.data();
+    const int vertexCount = m_x.count();
+
+    // there are always four vertices per quad, so no remainder to take care of
+#ifdef HAVE_SSE2
+    const __m128 a00 = _mm_set1_ps(m00);
+    const __m128 a01 = _mm_set1_ps(m01);
+    const __m128 a03 = _mm_set1_ps(m03);
+    const __m128 a10 = _mm_set1_ps(m10);
+    const __m128 a11 = _mm_set1_ps(m11);
+    const __m128 a13 = _mm_set1_ps(m13);
+    for (int i = 0; i < vertexCount; i += 4) {
+        const __m128 vx = _mm_loadu_ps(x + i);
+        const __m128 vy = _mm_loadu_ps(y + i);
+        _mm_storeu_ps(x + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(a00, vx), _mm_mul_ps(a01, vy)), a03));
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(a10, vx), _mm_mul_ps(a11, vy)), a13));
+    }
+#else
+    for (int i = 0; i < vertexCount; ++i) {
+        const float vx = x[i];
+        const float vy = y[i];
+        x[i] = m00 * vx + m01 * vy + m03;
+        y[i] = m10 * vx + m11 * vy + m13;
+    }
+#endif
+}
+
+QRectF WindowQuadBuffer::boundingRect() const
+{
+    if (m_x.isEmpty()) {
+        return QRectF();
+    }
+    const auto x = std::minmax_element(m_x.constBegin(), m_x.constEnd());
+    const auto y = std::minmax_element(m_y.constBegin(), m_y.constEnd());
+    return QRectF(QPointF(*x.first, *y.first), QPointF(*x.second, *y.second));
+}
+
+#ifdef HAVE_SSE2
+static inline void storeVertex(float *destination, __m128 vertex, bool aligned)
+{
+    if (aligned) {
+        _mm_stream_ps(destination, vertex);
+    } else {
+        _mm_storeu_ps(destination, vertex);
+    }
+}
+#endif
+
+void WindowQuadBuffer::makeInterleavedArrays(unsigned int type, GLVertex2D *vertices, const QMatrix4x4 &textureMatrix) const
+{
+    // Since we know that the texture matrix just scales and translates
+    // we can use this information to optimize the transformation
+    const float coeffU = textureMatrix(0, 0);
+    const float coeffV = textureMatrix(1, 1);
+    const float offsetU = textureMatrix(0, 3);
+    const float offsetV = textureMatrix(1, 3);
+
+    assert(type == GL_QUADS || type == GL_TRIANGLES);
+    const bool triangles = type == GL_TRIANGLES;
+
+    const float *x = m_x.constData();
+    const float *y = m_y.constData();
+    const float *u = m_u.constData();
+    const float *v = m_v.constData();
+    float *out = reinterpret_cast<float *>(vertices);
+
+#ifdef HAVE_SSE2
+    const bool aligned = !(intptr_t(out) & 0xf);
+    const __m128 cu = _mm_set1_ps(coeffU);
+    const __m128 cv = _mm_set1_ps(coeffV);
+    const __m128 ou = _mm_set1_ps(offsetU);
+    const __m128 ov = _mm_set1_ps(offsetV);
+    for (int i = 0; i < count(); ++i) {
+        // one register per component of the four vertices, transposed into one per vertex
+        __m128 v0 = _mm_loadu_ps(x + i * 4);
+        __m128 v1 = _mm_loadu_ps(y + i * 4);
+        __m128 v2 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(u + i * 4), cu), ou);
+        __m128 v3 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(v + i * 4), cv), ov);
+        _MM_TRANSPOSE4_PS(v0, v1, v2, v3);
+
+        if (triangles) {
+            // First triangle
+            storeVertex(out,      v1, aligned); // Top-right
+            storeVertex(out + 4,  v0, aligned); // Top-left
+            storeVertex(out + 8,  v3, aligned); // Bottom-left
+            // Second triangle
+            storeVertex(out + 12, v3, aligned); // Bottom-left
+            storeVertex(out + 16, v2, aligned); // Bottom-right
+            storeVertex(out + 20, v1, aligned); // Top-right
+            out += 24;
+        } else {
+            storeVertex(out,      v0, aligned); // Top-left
+            storeVertex(out + 4,  v1, aligned); // Top-right
+            storeVertex(out + 8,  v2, aligned); // Bottom-right
+            storeVertex(out + 12, v3, aligned); // Bottom-left
+            out += 16;
+        }
+    }
+#else
+    // Note: The positions in a WindowQuad are stored in clockwise order
+    static const int quadOrder[] = { 0, 1, 2, 3 };
+    static const int triangleOrder[] = { 1, 0, 3, 3, 2, 1 };
+    const int *order = triangles ? triangleOrder : quadOrder;
+    const int verticesPerQuad = triangles ? 6 : 4;
+    for (int i = 0; i < count(); ++i) {
+        for (int j = 0; j < verticesPerQuad; ++j) {
+            const int vertex = i * 4 + order[j];
+            *out++ = x[vertex];
+            *out++ = y[vertex];
+            *out++ = u[vertex] * coeffU + offsetU;
+            *out++ = v[vertex] * coeffV + offsetV;
+        }
+    }
+#endif
+}
+
 /***************************************************************
  PaintClipper
 ***************************************************************/
@@ -188,7 +188,7 @@ X-KDE-Library=kwin4_effect_cooleffect
 
 #define KWIN_EFFECT_API_MAKE_VERSION( major, minor ) (( major ) << 8 | ( minor ))
 #define KWIN_EFFECT_API_VERSION_MAJOR 0
-#define KWIN_EFFECT_API_VERSION_MINOR 226
+#define KWIN_EFFECT_API_VERSION_MINOR 227
 #define KWIN_EFFECT_API_VERSION KWIN_EFFECT_API_MAKE_VERSION( \
         KWIN_EFFECT_API_VERSION_MAJOR, KWIN_EFFECT_API_VERSION_MINOR )
 
@@ -571,6 +571,45 @@ public:
      **/
     virtual int requestedEffectChainPosition() const;
 
+    /**
+     * Whether the Effect prevents that an opaque fullscreen window gets scanned out
+     * directly instead of being composited. The Effect is only asked while it is active.
+     *
+     * An Effect which does not alter a fullscreen window which covers the whole screen,
+     * e.g. because it only paints behind translucent windows, should return @c false.
+     *
+     * Default implementation returns @c true.
+     *
+     * @since 5.14
+     **/
+    virtual bool blocksDirectScanout() const;
+
+    /**
+     * Whether the Effect may need windows which are completely hidden behind opaque windows.
+     * The Effect is only asked while it is active. If no active Effect needs them, the hidden
+     * windows are neither passed through prePaintWindow nor painted at all.
+     *
+     * An Effect which neither transforms windows nor changes their opacity, e.g. because it
+     * only paints behind translucent windows, should return @c false.
+     *
+     * Default implementation returns @c true.
+     *
+     * @since 5.14
+     **/
+    virtual bool needsOccludedWindows() const;
+
+    /**
+     * Whether buildQuads() may be invoked from other threads, concurrently for different
+     * windows. While all active Effects support it, the window quads are built in parallel.
+     *
+     * An Effect which does not override buildQuads() can return @c true.
+     *
+     * Default implementation returns @c false.
+     *
+     * @since 5.14
+     **/
+    virtual bool supportsConcurrentBuildQuads() const;
+
 
     /**
      * A touch point was pressed.
@@ -2364,6 +2403,84 @@ public:
     bool isTransformed() const;
 };
 
+/**
+ * @short Window quads stored as contiguous float arrays.
+ *
+ * WindowQuadList keeps every WindowQuad in a heap allocated node with six doubles per vertex.
+ * WindowQuadBuffer stores the positions and texture coordinates of all quads in one float array
+ * per component instead, four entries per quad in the vertex order of WindowQuad. That way the
+ * splitting, transforming and interleaving work on whole quads at once and can use SIMD.
+ *
+ * The original positions are not stored, the buffer holds the quads as they are going to be
+ * painted. Like the methods of WindowQuadList, the splitting methods expect quads which are
+ * not transformed.
+ *
+ * The arrays keep their memory on clear(), a buffer which is reused for every frame does not
+ * allocate once it has grown to the needed size.
+ *
+ * @since 5.14
+ **/
+class KWINEFFECTS_EXPORT WindowQuadBuffer
+{
+public:
+    WindowQuadBuffer();
+    explicit WindowQuadBuffer(const WindowQuadList &quads);
+
+    int count() const {
+        return m_info.count();
+    }
+    bool isEmpty() const {
+        return m_info.isEmpty();
+    }
+    void clear();
+    void reserve(int quads);
+    void append(const WindowQuad &quad);
+    void append(const WindowQuadList &quads);
+    WindowQuadType type(int index) const {
+        return m_info.at(index).type;
+    }
+    /**
+     * @returns the quad at @p index, its original position is the current one.
+     **/
+    WindowQuad at(int index) const;
+    WindowQuadList toList() const;
+
+    WindowQuadBuffer splitAtX(double x) const;
+    WindowQuadBuffer splitAtY(double y) const;
+    WindowQuadBuffer makeGrid(int maxQuadSize) const;
+    WindowQuadBuffer makeRegularGrid(int xSubdivisions, int ySubdivisions) const;
+    /**
+     * Maps all positions with the 2D affine part of @p matrix.
+     **/
+    void transform(const QMatrix4x4 &matrix);
+    /**
+     * @returns the smallest rect containing the current positions of all quads.
+     **/
+    QRectF boundingRect() const;
+    /**
+     * Same as WindowQuadList::makeInterleavedArrays.
+     **/
+    void makeInterleavedArrays(unsigned int type, GLVertex2D *vertices, const QMatrix4x4 &textureMatrix) const;
+
+private:
+    struct QuadInfo {
+        WindowQuadType type;
+        int id;
+        bool uvSwapped;
+    };
+    void appendSubQuad(const WindowQuadBuffer &source, int index, double x1, double y1, double x2, double y2);
+    void appendQuad(const WindowQuadBuffer &source, int index);
+    double left(int index) const;
+    double right(int index) const;
+    double top(int index) const;
+    double bottom(int index) const;
+    QVector<float> m_x;
+    QVector<float> m_y;
+    QVector<float> m_u;
+    QVector<float> m_v;
+    QVector<QuadInfo> m_info;
+};
+
 class KWINEFFECTS_EXPORT WindowPrePaintData
 {
 public:
@@ -305,7 +305,8 @@ void GLTexturePrivate::initStatic()
         s_supportsARGB32 = QSysInfo::ByteOrder == QSysInfo::LittleEndian &&
             hasGLExtension(QByteArrayLiteral("GL_EXT_texture_format_BGRA8888"));
 
-        s_supportsUnpack = hasGLExtension(QByteArrayLiteral("GL_EXT_unpack_subimage"));
+        // the unpack parameters are core in OpenGL ES 3.0
+        s_supportsUnpack = hasGLVersion(3, 0) || hasGLExtension(QByteArrayLiteral("GL_EXT_unpack_subimage"));
     }
 }
 
@@ -334,25 +335,61 @@ void GLTexture::update(const QImage &image, const QPoint &offset, const QRect &s
 
     Q_D(GLTexture);
 
-    bool useUnpack = !src.isNull() && d->s_supportsUnpack && d->s_supportsARGB32 && image.format() == QImage::Format_ARGB32_Premultiplied;
+    // what to upload from client memory if the upload buffer declines
+    QImage source = image;
+    QRect sourceRect = src;
+
+    if (GLPixelUploadBuffer *uploadBuffer = GLPixelUploadBuffer::instance()) {
+        QImage::Format format = QImage::Format_ARGB32_Premultiplied;
+        GLenum glFormat = GL_BGRA;
+        GLenum type = GL_UNSIGNED_INT_8_8_8_8_REV;
+        if (GLPlatform::instance()->isGLES()) {
+            type = GL_UNSIGNED_BYTE;
+            if (d->s_supportsARGB32) {
+                glFormat = GL_BGRA_EXT;
+            } else {
+                format = QImage::Format_RGBA8888_Premultiplied;
+                glFormat = GL_RGBA;
+            }
+        }
+        // the upload buffer picks the source rect, only a differently formatted image needs a copy
+        QImage im = image;
+        QRect rect = src.isNull() ? image.rect() : src;
+        if (image.format() != format) {
+            im = (src.isNull() ? image : image.copy(src)).convertToFormat(format);
+            rect = im.rect();
+            // do not convert again below
+            source = im;
+            sourceRect = QRect();
+        }
+        bind();
+        const bool uploaded = uploadBuffer->upload(d->m_target, im.constBits(), im.bytesPerLine(), {rect},
+                                                   offset - rect.topLeft(), glFormat, type);
+        unbind();
+        if (uploaded) {
+            return;
+        }
+    }
+
+    bool useUnpack = !sourceRect.isNull() && d->s_supportsUnpack && d->s_supportsARGB32 && source.format() == QImage::Format_ARGB32_Premultiplied;
 
-    int width = image.width();
-    int height = image.height();
+    int width = source.width();
+    int height = source.height();
     QImage tmpImage;
 
-    if (!src.isNull()) {
+    if (!sourceRect.isNull()) {
         if (useUnpack) {
-            glPixelStorei(GL_UNPACK_ROW_LENGTH, image.width());
-            glPixelStorei(GL_UNPACK_SKIP_PIXELS, src.x());
-            glPixelStorei(GL_UNPACK_SKIP_ROWS, src.y());
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, source.width());
+            glPixelStorei(GL_UNPACK_SKIP_PIXELS, sourceRect.x());
+            glPixelStorei(GL_UNPACK_SKIP_ROWS, sourceRect.y());
         } else {
-            tmpImage = image.copy(src);
+            tmpImage = source.copy(sourceRect);
         }
-        width = src.width();
-        height = src.height();
+        width = sourceRect.width();
+        height = sourceRect.height();
     }
 
-    const QImage &img = tmpImage.isNull() ? image : tmpImage;
+    const QImage &img = tmpImage.isNull() ? source : tmpImage;
 
     bind();
 
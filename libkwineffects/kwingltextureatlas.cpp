@@ -0,0 +1,416 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "kwingltextureatlas.h"
+#include "kwingltexture.h"
+#include "kwinglutils.h"
+#include "logging_p.h"
+
+#include <QHash>
+#include <QImage>
+#include <QMatrix4x4>
+#include <QVector>
+
+#include <algorithm>
+#include <limits>
+
+namespace KWin
+{
+
+/**
+ * One texture of the atlas together with the skyline describing its free space.
+ **/
+class AtlasPage
+{
+public:
+    explicit AtlasPage(const QSize &size);
+
+    bool allocate(const QSize &size, QRect *rect);
+    void release(const QRect &rect);
+    void reset();
+    int reservedArea() const;
+
+    QScopedPointer<GLTexture> texture;
+    QSize size;
+    int usedArea = 0;
+    int allocations = 0;
+    /**
+     * Set when repacking did not work out, cleared when the page changes.
+     **/
+    bool repackFailed = false;
+
+private:
+    int fit(int index, const QSize &size) const;
+
+    struct Segment {
+        int x;
+        int y;
+        int width;
+    };
+    QVector<Segment> m_skyline;
+};
+
+AtlasPage::AtlasPage(const QSize &size)
+    : texture(new GLTexture(GL_RGBA8, size.width(), size.height()))
+    , size(size)
+{
+    texture->setYInverted(true);
+    texture->setWrapMode(GL_CLAMP_TO_EDGE);
+    texture->clear();
+    reset();
+}
+
+void AtlasPage::reset()
+{
+    m_skyline = { Segment{0, 0, size.width()} };
+    usedArea = 0;
+    allocations = 0;
+}
+
+int AtlasPage::fit(int index, const QSize &size) const
+{
+    const Segment &first = m_skyline.at(index);
+    if (first.x + size.width() > this->size.width()) {
+        return -1;
+    }
+    // the skyline spans the whole page, so the segments cannot run out here
+    int y = 0;
+    int widthLeft = size.width();
+    for (int i = index; widthLeft > 0; ++i) {
+        const Segment &segment = m_skyline.at(i);
+        y = qMax(y, segment.y);
+        if (y + size.height() > this->size.height()) {
+            return -1;
+        }
+        widthLeft -= segment.width;
+    }
+    return y;
+}
+
+bool AtlasPage::allocate(const QSize &size, QRect *rect)
+{
+    int bestIndex = -1;
+    int bestBottom = std::numeric_limits<int>::max();
+    int bestWidth = std::numeric_limits<int>::max();
+    int bestY = 0;
+    for (int i = 0; i < m_skyline.count(); ++i) {
+        const int y = fit(i, size);
+        if (y < 0) {
+            continue;
+        }
+        const int bottom = y + size.height();
+        if (bottom < bestBottom || (bottom == bestBottom && m_skyline.at(i).width < bestWidth)) {
+            bestIndex = i;
+            bestBottom = bottom;
+            bestWidth = m_skyline.at(i).width;
+            bestY = y;
+        }
+    }
+    if (bestIndex < 0) {
+        return false;
+    }
+
+    const QRect allocated(m_skyline.at(bestIndex).x, bestY, size.width(), size.height());
+    m_skyline.insert(bestIndex, Segment{allocated.x(), bestBottom, allocated.width()});
+
+    // cut the segments now lying below the new one
+    for (int i = bestIndex + 1; i < m_skyline.count();) {
+        const Segment &previous = m_skyline.at(i - 1);
+        const int overlap = previous.x + previous.width - m_skyline.at(i).x;
+        if (overlap <= 0) {
+            break;
+        }
+        if (m_skyline.at(i).width <= overlap) {
+            m_skyline.remove(i);
+            continue;
+        }
+        m_skyline[i].x += overlap;
+        m_skyline[i].width -= overlap;
+        break;
+    }
+
+    for (int i = 0; i + 1 < m_skyline.count();) {
+        if (m_skyline.at(i).y == m_skyline.at(i + 1).y) {
+            m_skyline[i].width += m_skyline.at(i + 1).width;
+            m_skyline.remove(i + 1);
+        } else {
+            ++i;
+        }
+    }
+
+    usedArea += allocated.width() * allocated.height();
+    ++allocations;
+    repackFailed = false;
+    *rect = allocated;
+    return true;
+}
+
+void AtlasPage::release(const QRect &rect)
+{
+    usedArea -= rect.width() * rect.height();
+    repackFailed = false;
+    if (--allocations == 0) {
+        reset();
+    }
+}
+
+int AtlasPage::reservedArea() const
+{
+    int area = 0;
+    for (const Segment &segment : m_skyline) {
+        area += segment.y * segment.width;
+    }
+    return area;
+}
+
+class GLTextureAtlasPrivate
+{
+public:
+    struct Allocation {
+        AtlasPage *page;
+        /**
+         * Includes the gap to the next allocation.
+         **/
+        QRect rect;
+    };
+
+    ~GLTextureAtlasPrivate() {
+        qDeleteAll(pages);
+    }
+
+    void repack(AtlasPage *page);
+    static bool copy(GLTexture *source, GLTexture *target, const QVector<QPair<QRect, QRect>> &moves);
+
+    QSize pageSize;
+    bool pageSizeLimited = false;
+    int maxPages;
+    QVector<AtlasPage *> pages;
+    QHash<quint32, Allocation> allocations;
+    quint32 nextId = 1;
+};
+
+bool GLTextureAtlasPrivate::copy(GLTexture *source, GLTexture *target, const QVector<QPair<QRect, QRect>> &moves)
+{
+    GLRenderTarget renderTarget(*target);
+    if (!renderTarget.valid()) {
+        return false;
+    }
+
+    // both textures are addressed the way they are stored, the orientation does not matter
+    QVector<float> vertices;
+    QVector<float> texCoords;
+    vertices.reserve(moves.count() * 12);
+    texCoords.reserve(moves.count() * 12);
+    const float width = source->width();
+    const float height = source->height();
+    for (const auto &move : moves) {
+        const QRectF from(move.first.x() / width, move.first.y() / height,
+                          move.first.width() / width, move.first.height() / height);
+        const QRect &to = move.second;
+        vertices << to.left() << to.top() << to.right() + 1 << to.top() << to.right() + 1 << to.bottom() + 1
+                 << to.left() << to.top() << to.right() + 1 << to.bottom() + 1 << to.left() << to.bottom() + 1;
+        texCoords << from.left() << from.top() << from.right() << from.top() << from.right() << from.bottom()
+                  << from.left() << from.top() << from.right() << from.bottom() << from.left() << from.bottom();
+    }
+
+    QMatrix4x4 projection;
+    projection.ortho(0, target->width(), 0, target->height(), -1, 1);
+
+    GLRenderTarget::pushRenderTarget(&renderTarget);
+    ShaderBinder binder(ShaderTrait::MapTexture);
+    binder.shader()->setUniform(GLShader::ModelViewProjectionMatrix, projection);
+    source->setFilter(GL_NEAREST);
+    source->bind();
+
+    GLVertexBuffer *vbo = GLVertexBuffer::streamingBuffer();
+    vbo->reset();
+    vbo->setData(vertices.count() / 2, 2, vertices.constData(), texCoords.constData());
+    vbo->render(GL_TRIANGLES);
+
+    source->unbind();
+    GLRenderTarget::popRenderTarget();
+    return true;
+}
+
+void GLTextureAtlasPrivate::repack(AtlasPage *page)
+{
+    if (!GLRenderTarget::supported()) {
+        return;
+    }
+    page->repackFailed = true;
+
+    QVector<quint32> ids;
+    for (auto it = allocations.constBegin(); it != allocations.constEnd(); ++it) {
+        if (it.value().page == page) {
+            ids << it.key();
+        }
+    }
+    // tall rectangles first leave the least gaps in the skyline
+    std::sort(ids.begin(), ids.end(), [this] (quint32 a, quint32 b) {
+        return allocations.value(a).rect.height() > allocations.value(b).rect.height();
+    });
+
+    QScopedPointer<AtlasPage> packed(new AtlasPage(pageSize));
+    QVector<QPair<QRect, QRect>> moves;
+    moves.reserve(ids.count());
+    for (quint32 id : qAsConst(ids)) {
+        const QRect &from = allocations.value(id).rect;
+        QRect to;
+        if (!packed->allocate(from.size(), &to)) {
+            return;
+        }
+        moves << qMakePair(from, to);
+    }
+    if (!copy(page->texture.data(), packed->texture.data(), moves)) {
+        return;
+    }
+
+    AtlasPage *replacement = packed.take();
+    for (int i = 0; i < ids.count(); ++i) {
+        Allocation &allocation = allocations[ids.at(i)];
+        allocation.page = replacement;
+        allocation.rect = moves.at(i).second;
+    }
+    pages[pages.indexOf(page)] = replacement;
+    delete page;
+}
+
+GLTextureAtlas::GLTextureAtlas(const QSize &pageSize, int maxPages)
+    : d(new GLTextureAtlasPrivate)
+{
+    d->pageSize = pageSize;
+    d->maxPages = maxPages;
+}
+
+GLTextureAtlas::~GLTextureAtlas() = default;
+
+quint32 GLTextureAtlas::allocate(const QSize &size)
+{
+    if (size.isEmpty()) {
+        return 0;
+    }
+    if (!d->pageSizeLimited) {
+        // the atlas may be created before there is a current context
+        GLint limit = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &limit);
+        if (limit > 0) {
+            d->pageSize = d->pageSize.boundedTo(QSize(limit, limit));
+        }
+        d->pageSizeLimited = true;
+    }
+    // keep a row and a column free towards the next allocation
+    const QSize padded = size + QSize(1, 1);
+    if (padded.width() > d->pageSize.width() || padded.height() > d->pageSize.height()) {
+        return 0;
+    }
+
+    QRect rect;
+    AtlasPage *page = nullptr;
+    for (AtlasPage *candidate : qAsConst(d->pages)) {
+        if (candidate->allocate(padded, &rect)) {
+            page = candidate;
+            break;
+        }
+    }
+    if (!page) {
+        if (d->pages.count() >= d->maxPages) {
+            return 0;
+        }
+        page = new AtlasPage(d->pageSize);
+        if (!page->texture->texture()) {
+            qCWarning(LIBKWINGLUTILS) << "Failed to create a texture atlas page of size" << d->pageSize;
+            delete page;
+            return 0;
+        }
+        d->pages << page;
+        page->allocate(padded, &rect);
+    }
+
+    const quint32 id = d->nextId++;
+    d->allocations.insert(id, GLTextureAtlasPrivate::Allocation{page, rect});
+    return id;
+}
+
+void GLTextureAtlas::release(quint32 id)
+{
+    const auto it = d->allocations.find(id);
+    if (it == d->allocations.end()) {
+        return;
+    }
+    it.value().page->release(it.value().rect);
+    d->allocations.erase(it);
+}
+
+void GLTextureAtlas::clear(quint32 id)
+{
+    const auto it = d->allocations.constFind(id);
+    if (it == d->allocations.constEnd()) {
+        return;
+    }
+    QImage image(it.value().rect.size(), QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    it.value().page->texture->update(image, it.value().rect.topLeft());
+}
+
+GLTexture *GLTextureAtlas::texture(quint32 id) const
+{
+    const auto it = d->allocations.constFind(id);
+    return it == d->allocations.constEnd() ? nullptr : it.value().page->texture.data();
+}
+
+QRect GLTextureAtlas::rect(quint32 id) const
+{
+    const auto it = d->allocations.constFind(id);
+    if (it == d->allocations.constEnd()) {
+        return QRect();
+    }
+    const QRect &rect = it.value().rect;
+    return QRect(rect.topLeft(), rect.size() - QSize(1, 1));
+}
+
+void GLTextureAtlas::defragment()
+{
+    // keep one page around, windows come and go all the time
+    for (int i = d->pages.count() - 1; i > 0; --i) {
+        if (d->pages.at(i)->allocations == 0) {
+            delete d->pages.takeAt(i);
+        }
+    }
+    const int pageArea = d->pageSize.width() * d->pageSize.height();
+    const auto pages = d->pages;
+    for (AtlasPage *page : pages) {
+        // released rectangles below the skyline can only be reused by repacking
+        if (page->allocations > 0 && !page->repackFailed &&
+                page->reservedArea() > pageArea * 3 / 4 && page->usedArea < pageArea / 2) {
+            d->repack(page);
+        }
+    }
+}
+
+int GLTextureAtlas::pageCount() const
+{
+    return d->pages.count();
+}
+
+int GLTextureAtlas::allocationCount() const
+{
+    return d->allocations.count();
+}
+
+} // namespace
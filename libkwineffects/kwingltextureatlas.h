@@ -0,0 +1,108 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+
+#ifndef KWIN_GLTEXTUREATLAS_H
+#define KWIN_GLTEXTUREATLAS_H
+
+#include <kwinglutils_export.h>
+
+#include <QRect>
+#include <QScopedPointer>
+#include <QSize>
+
+/** @addtogroup kwineffects */
+/** @{ */
+
+namespace KWin
+{
+
+class GLTexture;
+class GLTextureAtlasPrivate;
+
+/**
+ * @brief Packs many small images into a few shared textures.
+ *
+ * The atlas hands out rectangles on RGBA pages of a fixed size. Things painted from the
+ * same page can be drawn with a single texture bind, which allows to batch draws across
+ * windows. Rectangles are allocated with a skyline packer, there is an unused row and column
+ * between them so that linear filtering does not bleed neighbours in.
+ *
+ * The pages use the same orientation as a GLTexture created from a QImage, i.e. they are
+ * Y-inverted and rect() is in the coordinates of the image uploaded into it.
+ *
+ * Allocations which do not fit into any page, e.g. because they are larger than a page,
+ * fail and the caller is expected to use a texture of its own instead.
+ *
+ * Pages are only ever dropped or repacked by defragment(), which has to be called at a
+ * point when no draw referencing the atlas is pending, e.g. before a frame gets painted.
+ * @since 5.14
+ **/
+class KWINGLUTILS_EXPORT GLTextureAtlas
+{
+public:
+    /**
+     * Creates an atlas with pages of @p pageSize, limited to the maximum texture size.
+     * Pages are created when needed, so there does not have to be a current context yet.
+     * No more than @p maxPages pages are created.
+     **/
+    explicit GLTextureAtlas(const QSize &pageSize = QSize(2048, 2048), int maxPages = 8);
+    ~GLTextureAtlas();
+
+    /**
+     * Reserves a rectangle of @p size. The contents of the rectangle are undefined.
+     * @returns an id for the allocation or @c 0 if there is no space left
+     **/
+    quint32 allocate(const QSize &size);
+    /**
+     * Gives the rectangle of allocation @p id back to the atlas.
+     **/
+    void release(quint32 id);
+    /**
+     * Fills the rectangle of allocation @p id with transparent pixels.
+     **/
+    void clear(quint32 id);
+
+    /**
+     * The page holding allocation @p id. It may change with defragment().
+     **/
+    GLTexture *texture(quint32 id) const;
+    /**
+     * The rectangle on the page for allocation @p id. It may change with defragment().
+     **/
+    QRect rect(quint32 id) const;
+
+    /**
+     * Deletes unused pages and repacks pages whose free space got too fragmented
+     * for new allocations. Moved allocations keep their contents.
+     **/
+    void defragment();
+
+    int pageCount() const;
+    int allocationCount() const;
+
+private:
+    QScopedPointer<GLTextureAtlasPrivate> d;
+};
+
+} // namespace
+
+/** @} */
+
+#endif
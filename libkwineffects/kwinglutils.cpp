@@ -32,7 +32,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QPixmap>
 #include <QImage>
 #include <QHash>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
 #include <QVector2D>
 #include <QVector3D>
 #include <QVector4D>
@@ -60,6 +67,44 @@ namespace KWin
 // List of all supported GL extensions
 static QList<QByteArray> glExtensions;
 
+/**
+ * Keeps the binaries of linked programs on disk, so that shaders only get compiled the
+ * first time they are used with a driver.
+ *
+ * Programs are looked up by a hash of their prepared sources and attribute bindings in a
+ * directory named after the vendor, renderer and version string of the driver. After a
+ * driver update the cache starts out empty. The directories of drivers no session used
+ * for s_programCacheMaxAgeDays are removed.
+ *
+ * Setting the environment variable KWIN_GL_PROGRAM_CACHE to 0 disables the cache.
+ **/
+class GLProgramCache
+{
+public:
+    static GLProgramCache *instance();
+    static void cleanup();
+
+    bool isEnabled() const {
+        return m_enabled;
+    }
+    QByteArray key(const QByteArray &vertexSource, const QByteArray &fragmentSource, const QByteArray &bindings) const;
+    /**
+     * Loads the binary stored for @p key into @p program. Returns @c false if there is none
+     * or the driver rejected it, in which case the program has to be linked from source.
+     **/
+    bool load(GLuint program, const QByteArray &key);
+    void store(GLuint program, const QByteArray &key);
+
+private:
+    GLProgramCache();
+    QString filePath(const QByteArray &key) const;
+
+    bool m_enabled = false;
+    QString m_directory;
+    QVector<GLint> m_formats;
+    static GLProgramCache *s_instance;
+};
+
 
 // Functions
 
@@ -83,13 +128,16 @@ void initGL(std::function<resolveFuncPtr(const char*)> resolveFunction)
     GLTexturePrivate::initStatic();
     GLRenderTarget::initStatic();
     GLVertexBuffer::initStatic();
+    GLPixelUploadBuffer::initStatic();
 }
 
 void cleanupGL()
 {
     ShaderManager::cleanup();
+    GLProgramCache::cleanup();
     GLTexturePrivate::cleanup();
     GLRenderTarget::cleanup();
+    GLPixelUploadBuffer::cleanup();
     GLVertexBuffer::cleanup();
     GLPlatform::cleanup();
 
@@ -145,6 +193,169 @@ bool checkGLError(const char* txt)
     return hasError;
 }
 
+//****************************************
+// GLProgramCache
+//****************************************
+
+static const quint32 s_programCacheMagic = 0x4b575042; // "KWPB"
+// touched whenever a session starts using the directory of a driver
+static const QString s_programCacheLastUsed = QStringLiteral("last-used");
+static const int s_programCacheMaxAgeDays = 30;
+
+GLProgramCache *GLProgramCache::s_instance = nullptr;
+
+GLProgramCache *GLProgramCache::instance()
+{
+    if (!s_instance) {
+        s_instance = new GLProgramCache;
+    }
+    return s_instance;
+}
+
+void GLProgramCache::cleanup()
+{
+    delete s_instance;
+    s_instance = nullptr;
+}
+
+GLProgramCache::GLProgramCache()
+{
+    if (qgetenv("KWIN_GL_PROGRAM_CACHE") == QByteArrayLiteral("0")) {
+        return;
+    }
+
+    GLPlatform *platform = GLPlatform::instance();
+    if (platform->isGLES()) {
+        if (!hasGLVersion(3, 0)) {
+            return;
+        }
+    } else if (!hasGLVersion(4, 1) && !hasGLExtension(QByteArrayLiteral("GL_ARB_get_program_binary"))) {
+        return;
+    }
+
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+    if (count <= 0) {
+        qCDebug(LIBKWINGLUTILS) << "Driver does not support any program binary format";
+        return;
+    }
+    m_formats.resize(count);
+    glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, m_formats.data());
+
+    QCryptographicHash driver(QCryptographicHash::Sha1);
+    driver.addData(platform->glVendorString());
+    driver.addData("\n", 1);
+    driver.addData(platform->glRendererString());
+    driver.addData("\n", 1);
+    driver.addData(platform->glVersionString());
+    const QString driverDirectory = QString::fromLatin1(driver.result().toHex());
+
+    QDir base(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QStringLiteral("/kwin/glprograms"));
+    if (!base.mkpath(driverDirectory)) {
+        qCWarning(LIBKWINGLUTILS) << "Failed to create the program cache in" << base.path();
+        return;
+    }
+    m_directory = base.filePath(driverDirectory) + QLatin1Char('/');
+
+    // sessions on other GPUs, nested or running at the same time use their own directories,
+    // so only the ones no session used for a while are removed, e.g. after a driver update
+    QFile lastUsed(m_directory + s_programCacheLastUsed);
+    if (lastUsed.open(QIODevice::WriteOnly)) {
+        lastUsed.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+        lastUsed.close();
+    }
+    const QDateTime staleBefore = QDateTime::currentDateTimeUtc().addDays(-s_programCacheMaxAgeDays);
+    const QFileInfoList entries = base.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QFileInfo &entry : entries) {
+        if (entry.fileName() == driverDirectory) {
+            continue;
+        }
+        const QFileInfo entryLastUsed(entry.filePath() + QLatin1Char('/') + s_programCacheLastUsed);
+        const QDateTime used = entryLastUsed.exists() ? entryLastUsed.lastModified() : entry.lastModified();
+        if (used < staleBefore) {
+            QDir(entry.filePath()).removeRecursively();
+        }
+    }
+
+    m_enabled = true;
+}
+
+QByteArray GLProgramCache::key(const QByteArray &vertexSource, const QByteArray &fragmentSource, const QByteArray &bindings) const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(vertexSource);
+    hash.addData("\0", 1);
+    hash.addData(fragmentSource);
+    hash.addData("\0", 1);
+    hash.addData(bindings);
+    return hash.result();
+}
+
+QString GLProgramCache::filePath(const QByteArray &key) const
+{
+    return m_directory + QString::fromLatin1(key.toHex());
+}
+
+bool GLProgramCache::load(GLuint program, const QByteArray &key)
+{
+    QFile file(filePath(key));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    quint32 magic = 0;
+    quint32 format = 0;
+    QByteArray binary;
+    stream >> magic >> format >> binary;
+    // an unknown format would raise a GL error
+    if (stream.status() != QDataStream::Ok || magic != s_programCacheMagic ||
+            binary.isEmpty() || !m_formats.contains(GLint(format))) {
+        file.remove();
+        return false;
+    }
+
+    glProgramBinary(program, format, binary.constData(), binary.size());
+
+    GLint status = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status == 0) {
+        // e.g. a driver update that did not change the version string
+        qCDebug(LIBKWINGLUTILS) << "Driver rejected cached program binary" << file.fileName();
+        file.remove();
+        return false;
+    }
+    return true;
+}
+
+void GLProgramCache::store(GLuint program, const QByteArray &key)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    QByteArray binary(length, Qt::Uninitialized);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+    if (length <= 0) {
+        return;
+    }
+    binary.truncate(length);
+
+    QSaveFile file(filePath(key));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCDebug(LIBKWINGLUTILS) << "Failed to write program binary" << file.fileName();
+        return;
+    }
+    QDataStream stream(&file);
+    stream << s_programCacheMagic << quint32(format) << binary;
+    if (!file.commit()) {
+        qCDebug(LIBKWINGLUTILS) << "Failed to write program binary" << file.fileName();
+    }
+}
+
 //****************************************
 // GLShader
 //****************************************
@@ -153,6 +364,7 @@ GLShader::GLShader(unsigned int flags)
     : mValid(false)
     , mLocationsResolved(false)
     , mExplicitLinking(flags & ExplicitLinking)
+    , mCompilePending(false)
 {
     mProgram = glCreateProgram();
 }
@@ -161,6 +373,7 @@ GLShader::GLShader(const QString& vertexfile, const QString& fragmentfile, unsig
     : mValid(false)
     , mLocationsResolved(false)
     , mExplicitLinking(flags & ExplicitLinking)
+    , mCompilePending(false)
 {
     mProgram = glCreateProgram();
     loadFromFiles(vertexfile, fragmentfile);
@@ -194,6 +407,36 @@ bool GLShader::loadFromFiles(const QString &vertexFile, const QString &fragmentF
 
 bool GLShader::link()
 {
+    // linking resets all uniforms
+    mUniformValues.clear();
+
+    QByteArray cacheKey;
+    if (mCompilePending) {
+        mCompilePending = false;
+        const QByteArray vertexSource = mVertexSource;
+        const QByteArray fragmentSource = mFragmentSource;
+        mVertexSource.clear();
+        mFragmentSource.clear();
+
+        GLProgramCache *cache = GLProgramCache::instance();
+        cacheKey = cache->key(prepareSource(GL_VERTEX_SHADER, vertexSource),
+                              prepareSource(GL_FRAGMENT_SHADER, fragmentSource),
+                              mBindings);
+        if (cache->load(mProgram, cacheKey)) {
+            mValid = true;
+            return mValid;
+        }
+
+        mValid = false;
+        if (!vertexSource.isEmpty() && !compile(mProgram, GL_VERTEX_SHADER, vertexSource)) {
+            return false;
+        }
+        if (!fragmentSource.isEmpty() && !compile(mProgram, GL_FRAGMENT_SHADER, fragmentSource)) {
+            return false;
+        }
+        glProgramParameteri(mProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
     // Be optimistic
     mValid = true;
 
@@ -217,6 +460,10 @@ bool GLShader::link()
         qCDebug(LIBKWINGLUTILS) << "Shader link log:" << log;
     }
 
+    if (mValid && !cacheKey.isEmpty()) {
+        GLProgramCache::instance()->store(mProgram, cacheKey);
+    }
+
     return mValid;
 }
 
@@ -286,6 +533,19 @@ bool GLShader::load(const QByteArray &vertexSource, const QByteArray &fragmentSo
 
     mValid = false;
 
+    // With the program cache the sources only get compiled if link() finds no binary
+    // for them, which needs the attribute bindings made in between
+    if (GLProgramCache::instance()->isEnabled()) {
+        mVertexSource = vertexSource;
+        mFragmentSource = fragmentSource;
+        mCompilePending = true;
+
+        if (mExplicitLinking)
+            return true;
+
+        return link();
+    }
+
     // Compile the vertex shader
     if (!vertexSource.isEmpty()) {
         bool success = compile(mProgram, GL_VERTEX_SHADER, vertexSource);
@@ -312,10 +572,12 @@ bool GLShader::load(const QByteArray &vertexSource, const QByteArray &fragmentSo
 void GLShader::bindAttributeLocation(const char *name, int index)
 {
     glBindAttribLocation(mProgram, index, name);
+    mBindings += "a:" + QByteArray(name) + '=' + QByteArray::number(index) + ';';
 }
 
 void GLShader::bindFragDataLocation(const char *name, int index)
 {
+    mBindings += "f:" + QByteArray(name) + '=' + QByteArray::number(index) + ';';
     if (!GLPlatform::instance()->isGLES() && (hasGLVersion(3, 0) || hasGLExtension(QByteArrayLiteral("GL_EXT_gpu_shader4"))))
         glBindFragDataLocation(mProgram, index, name);
 }
@@ -443,9 +705,51 @@ bool GLShader::setUniform(const char *name, const QColor& color)
     return setUniform(location, color);
 }
 
+// uniform locations are small integers in practice, larger ones are not cached
+static const int s_uniformCacheSize = 64;
+static quint64 s_uniformUpdates = 0;
+static quint64 s_skippedUniformUpdates = 0;
+
+quint64 GLShader::uniformUpdateCount()
+{
+    return s_uniformUpdates;
+}
+
+quint64 GLShader::skippedUniformUpdateCount()
+{
+    return s_skippedUniformUpdates;
+}
+
+void GLShader::invalidateUniforms()
+{
+    mUniformValues.clear();
+}
+
+bool GLShader::isUniformCurrent(int location, const void *data, int size)
+{
+    static const bool s_enabled = qgetenv("KWIN_GL_UNIFORM_CACHE") != QByteArrayLiteral("0");
+    if (!s_enabled || location >= s_uniformCacheSize) {
+        ++s_uniformUpdates;
+        return false;
+    }
+
+    if (mUniformValues.count() <= location) {
+        mUniformValues.resize(location + 1);
+    }
+    UniformValue &value = mUniformValues[location];
+    if (value.size == size && memcmp(value.data, data, size) == 0) {
+        ++s_skippedUniformUpdates;
+        return true;
+    }
+    value.size = size;
+    memcpy(value.data, data, size);
+    ++s_uniformUpdates;
+    return false;
+}
+
 bool GLShader::setUniform(int location, float value)
 {
-    if (location >= 0) {
+    if (location >= 0 && !isUniformCurrent(location, &value, sizeof(value))) {
         glUniform1f(location, value);
     }
     return (location >= 0);
@@ -453,7 +757,7 @@ bool GLShader::setUniform(int location, float value)
 
 bool GLShader::setUniform(int location, int value)
 {
-    if (location >= 0) {
+    if (location >= 0 && !isUniformCurrent(location, &value, sizeof(value))) {
         glUniform1i(location, value);
     }
     return (location >= 0);
@@ -461,24 +765,27 @@ bool GLShader::setUniform(int location, int value)
 
 bool GLShader::setUniform(int location, const QVector2D &value)
 {
-    if (location >= 0) {
-        glUniform2fv(location, 1, (const GLfloat*)&value);
+    const GLfloat v[2] = { value.x(), value.y() };
+    if (location >= 0 && !isUniformCurrent(location, v, sizeof(v))) {
+        glUniform2fv(location, 1, v);
     }
     return (location >= 0);
 }
 
 bool GLShader::setUniform(int location, const QVector3D &value)
 {
-    if (location >= 0) {
-        glUniform3fv(location, 1, (const GLfloat*)&value);
+    const GLfloat v[3] = { value.x(), value.y(), value.z() };
+    if (location >= 0 && !isUniformCurrent(location, v, sizeof(v))) {
+        glUniform3fv(location, 1, v);
     }
     return (location >= 0);
 }
 
 bool GLShader::setUniform(int location, const QVector4D &value)
 {
-    if (location >= 0) {
-        glUniform4fv(location, 1, (const GLfloat*)&value);
+    const GLfloat v[4] = { value.x(), value.y(), value.z(), value.w() };
+    if (location >= 0 && !isUniformCurrent(location, v, sizeof(v))) {
+        glUniform4fv(location, 1, v);
     }
     return (location >= 0);
 }
@@ -492,15 +799,18 @@ bool GLShader::setUniform(int location, const QMatrix4x4 &value)
         for (int i = 0; i < 16; ++i) {
             m[i] = data[i];
         }
-        glUniformMatrix4fv(location, 1, GL_FALSE, m);
+        if (!isUniformCurrent(location, m, sizeof(m))) {
+            glUniformMatrix4fv(location, 1, GL_FALSE, m);
+        }
     }
     return (location >= 0);
 }
 
 bool GLShader::setUniform(int location, const QColor &color)
 {
-    if (location >= 0) {
-        glUniform4f(location, color.redF(), color.greenF(), color.blueF(), color.alphaF());
+    const GLfloat v[4] = { GLfloat(color.redF()), GLfloat(color.greenF()), GLfloat(color.blueF()), GLfloat(color.alphaF()) };
+    if (location >= 0 && !isUniformCurrent(location, v, sizeof(v))) {
+        glUniform4fv(location, 1, v);
     }
     return (location >= 0);
 }
@@ -2316,4 +2626,232 @@ GLVertexBuffer *GLVertexBuffer::streamingBuffer()
     return GLVertexBufferPrivate::streamingBuffer;
 }
 
+
+
+// ------------------------------------------------------------------
+
+
+
+class GLPixelUploadBufferPrivate
+{
+public:
+    /**
+     * Returns where @p size bytes can be written to and stores their offset in the
+     * buffer in @p offset. The buffer is bound to GL_PIXEL_UNPACK_BUFFER.
+     **/
+    uchar *allocate(size_t size, size_t *offset);
+    bool reallocate(size_t size);
+    /**
+     * Waits until the GPU read everything written before the absolute position @p end.
+     **/
+    bool awaitConsumed(quint64 end);
+
+    struct Block {
+        GLsync sync;
+        quint64 begin;
+    };
+
+    bool persistent = false;
+    GLuint buffer = 0;
+    size_t capacity = 0;
+    uchar *map = nullptr;
+    // bytes written into the ring so far, the offset is this modulo the capacity
+    quint64 position = 0;
+    quint64 lastBegin = 0;
+    std::deque<Block> blocks;
+};
+
+// below this the overhead of the buffer outweighs the copy the driver does
+static const size_t s_minimumPixelUploadSize = 64 * 1024;
+
+uchar *GLPixelUploadBufferPrivate::allocate(size_t size, size_t *offset)
+{
+    if (!persistent) {
+        if (buffer == 0) {
+            glGenBuffers(1, &buffer);
+        }
+        // orphan the storage, the driver keeps the old one around while it is in use
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        *offset = 0;
+        return (uchar *) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    }
+
+    if (unlikely(size > capacity) && !reallocate(size)) {
+        return nullptr;
+    }
+
+    quint64 begin = position;
+    if (begin % capacity + size > capacity) {
+        // wrap around
+        begin += capacity - begin % capacity;
+    }
+    // the data of the previous lap is overwritten
+    if (begin + size > capacity && !awaitConsumed(begin + size - capacity)) {
+        return nullptr;
+    }
+    position = begin + size;
+    lastBegin = begin;
+
+    *offset = begin % capacity;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    return map + *offset;
+}
+
+bool GLPixelUploadBufferPrivate::reallocate(size_t size)
+{
+    if (buffer != 0) {
+        // deleting the buffer also unmaps it, the GPU keeps the storage while it uses it
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+        map = nullptr;
+    }
+    for (const Block &block : blocks) {
+        glDeleteSync(block.sync);
+    }
+    blocks.clear();
+    position = 0;
+
+    capacity = align(qMax<size_t>(size * 2, 4 * 1024 * 1024), 64 * 1024);
+
+    const GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, capacity, nullptr, access);
+    map = (uchar *) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, capacity, access);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (!map) {
+        qCWarning(LIBKWINGLUTILS) << "Failed to map the pixel upload buffer";
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+        capacity = 0;
+        return false;
+    }
+    return true;
+}
+
+bool GLPixelUploadBufferPrivate::awaitConsumed(quint64 end)
+{
+    // the GPU finishes the uploads in order, the last one touching the range covers all of them
+    GLsync sync = nullptr;
+    while (!blocks.empty() && blocks.front().begin < end) {
+        if (sync) {
+            glDeleteSync(sync);
+        }
+        sync = blocks.front().sync;
+        blocks.pop_front();
+    }
+    if (!sync) {
+        return true;
+    }
+
+    GLint status = GL_UNSIGNALED;
+    glGetSynciv(sync, GL_SYNC_STATUS, 1, nullptr, &status);
+    if (status != GL_SIGNALED) {
+        qCDebug(LIBKWINGLUTILS) << "Stalling on pixel upload fence";
+        const GLenum ret = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        if (ret == GL_TIMEOUT_EXPIRED || ret == GL_WAIT_FAILED) {
+            qCCritical(LIBKWINGLUTILS) << "Wait failed";
+            glDeleteSync(sync);
+            return false;
+        }
+    }
+    glDeleteSync(sync);
+    return true;
+}
+
+GLPixelUploadBuffer *GLPixelUploadBuffer::s_instance = nullptr;
+
+GLPixelUploadBuffer::GLPixelUploadBuffer(bool persistent)
+    : d(new GLPixelUploadBufferPrivate)
+{
+    d->persistent = persistent;
+}
+
+GLPixelUploadBuffer::~GLPixelUploadBuffer()
+{
+    for (const GLPixelUploadBufferPrivate::Block &block : d->blocks) {
+        glDeleteSync(block.sync);
+    }
+    if (d->buffer) {
+        glDeleteBuffers(1, &d->buffer);
+    }
+    delete d;
+}
+
+bool GLPixelUploadBuffer::upload(GLenum target, const uchar *bits, int bytesPerLine, const QVector<QRect> &rects,
+                                 const QPoint &translation, GLenum format, GLenum type)
+{
+    size_t size = 0;
+    for (const QRect &rect : rects) {
+        size += rect.width() * rect.height() * 4;
+    }
+    if (size < s_minimumPixelUploadSize) {
+        return false;
+    }
+
+    size_t offset = 0;
+    uchar *data = d->allocate(size, &offset);
+    if (!data) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return false;
+    }
+
+    // pack the rectangles tightly, one after the other
+    uchar *dst = data;
+    for (const QRect &rect : rects) {
+        const int rowSize = rect.width() * 4;
+        const uchar *src = bits + rect.y() * bytesPerLine + rect.x() * 4;
+        for (int y = 0; y < rect.height(); ++y) {
+            memcpy(dst, src, rowSize);
+            dst += rowSize;
+            src += bytesPerLine;
+        }
+    }
+    if (!d->persistent) {
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+
+    for (const QRect &rect : rects) {
+        glTexSubImage2D(target, 0, rect.x() + translation.x(), rect.y() + translation.y(),
+                        rect.width(), rect.height(), format, type, reinterpret_cast<const GLvoid *>(offset));
+        offset += rect.width() * rect.height() * 4;
+    }
+
+    if (d->persistent) {
+        d->blocks.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), d->lastBegin});
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return true;
+}
+
+GLPixelUploadBuffer *GLPixelUploadBuffer::instance()
+{
+    return s_instance;
+}
+
+void GLPixelUploadBuffer::initStatic()
+{
+    if (qgetenv("KWIN_PBO_UPLOAD") == QByteArrayLiteral("0")) {
+        return;
+    }
+    bool havePixelBuffers;
+    if (GLPlatform::instance()->isGLES()) {
+        havePixelBuffers = hasGLVersion(3, 0);
+    } else {
+        havePixelBuffers = hasGLVersion(2, 1) || hasGLExtension(QByteArrayLiteral("GL_ARB_pixel_buffer_object"));
+    }
+    if (!havePixelBuffers || !GLVertexBufferPrivate::hasMapBufferRange) {
+        return;
+    }
+    s_instance = new GLPixelUploadBuffer(GLVertexBufferPrivate::haveBufferStorage && GLVertexBufferPrivate::haveSyncFences);
+}
+
+void GLPixelUploadBuffer::cleanup()
+{
+    delete s_instance;
+    s_instance = nullptr;
+}
+
 } // namespace
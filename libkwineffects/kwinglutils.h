@@ -28,8 +28,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "kwingltexture.h"
 
 // Qt
+#include <QRect>
 #include <QSize>
 #include <QStack>
+#include <QVector>
 
 /** @addtogroup kwineffects */
 /** @{ */
@@ -66,6 +68,15 @@ bool KWINGLUTILS_EXPORT checkGLError(const char* txt);
 
 QList<QByteArray> KWINGLUTILS_EXPORT openGLExtensions();
 
+/**
+ * @short Wraps a linked GLSL program.
+ *
+ * Each shader remembers the values it uploaded through setUniform and skips uploading the
+ * same value again. GL does not tell when a uniform got changed behind its back, so code
+ * setting uniforms of a GLShader's program with glUniform directly has to either use only
+ * locations never set through setUniform, or call invalidateUniforms() afterwards. The cache
+ * can be disabled by setting the environment variable KWIN_GL_UNIFORM_CACHE to 0.
+ **/
 class KWINGLUTILS_EXPORT GLShader
 {
 public:
@@ -155,6 +166,24 @@ public:
     bool setUniform(ColorUniform uniform,  const QVector4D &value);
     bool setUniform(ColorUniform uniform,  const QColor &value);
 
+    /**
+     * Forgets the uniform values uploaded through setUniform, so that the next call uploads
+     * its value in any case. To be called after setting uniforms with glUniform directly.
+     * @since 5.14
+     **/
+    void invalidateUniforms();
+
+    /**
+     * The number of uniform values uploaded to GL since startup.
+     * @see skippedUniformUpdateCount
+     **/
+    static quint64 uniformUpdateCount();
+    /**
+     * The number of setUniform calls which did not reach GL since startup, because the
+     * program already had the value.
+     **/
+    static quint64 skippedUniformUpdateCount();
+
 protected:
     GLShader(unsigned int flags = NoFlags);
     bool loadFromFiles(const QString& vertexfile, const QString& fragmentfile);
@@ -166,10 +195,28 @@ protected:
     void resolveLocations();
 
 private:
+    /**
+     * Returns @c true if the uniform at @p location already has the @p size bytes of
+     * @p data, otherwise remembers them as its value.
+     **/
+    bool isUniformCurrent(int location, const void *data, int size);
+
+    struct UniformValue {
+        int size = 0;
+        quint32 data[16];
+    };
+
     unsigned int mProgram;
     bool mValid:1;
     bool mLocationsResolved:1;
     bool mExplicitLinking:1;
+    bool mCompilePending:1;
+    // kept until link() when the program may be loaded from the program cache
+    QByteArray mVertexSource;
+    QByteArray mFragmentSource;
+    QByteArray mBindings;
+    // indexed by location, for the locations below s_uniformCacheSize
+    QVector<UniformValue> mUniformValues;
     int mMatrixLocation[MatrixCount];
     int mVec2Location[Vec2UniformCount];
     int mVec4Location[Vec4UniformCount];
@@ -816,6 +863,62 @@ private:
     static qreal s_virtualScreenScale;
 };
 
+class GLPixelUploadBufferPrivate;
+
+/**
+ * @short Streams texture uploads through pixel buffer objects.
+ *
+ * Uploading with glTexSubImage2D from client memory blocks until the driver copied the
+ * pixels, which includes waiting for the GPU if it still reads from the texture. This
+ * class copies the pixels into a pixel buffer object instead and lets the GPU transfer
+ * them into the texture on its own.
+ *
+ * If GL_ARB_buffer_storage (GL_EXT_buffer_storage on OpenGL ES) and sync objects are
+ * available, the pixel buffer is a persistently mapped ring whose space is recycled once
+ * a fence tells that the GPU consumed it. Otherwise the buffer is orphaned for each upload.
+ *
+ * Setting the environment variable KWIN_PBO_UPLOAD to @c 0 disables it.
+ * @since 5.14
+ **/
+class KWINGLUTILS_EXPORT GLPixelUploadBuffer
+{
+public:
+    ~GLPixelUploadBuffer();
+
+    /**
+     * Uploads the rectangles @p rects of an image with 32 bits per pixel at @p bits into the
+     * texture bound to @p target. Each rectangle ends up at its position translated by
+     * @p translation. @p format and @p type are passed on to glTexSubImage2D.
+     *
+     * The unpack parameters have to be at their defaults.
+     *
+     * @returns @c false if nothing was uploaded, e.g. because the rectangles are too small
+     * to be worth it. The caller has to upload from client memory in that case.
+     **/
+    bool upload(GLenum target, const uchar *bits, int bytesPerLine, const QVector<QRect> &rects,
+                const QPoint &translation, GLenum format, GLenum type);
+
+    /**
+     * @returns the shared upload buffer or @c nullptr if pixel buffer objects cannot be used
+     **/
+    static GLPixelUploadBuffer *instance();
+
+    /**
+     * @internal
+     */
+    static void initStatic();
+
+    /**
+     * @internal
+     */
+    static void cleanup();
+
+private:
+    explicit GLPixelUploadBuffer(bool persistent);
+    GLPixelUploadBufferPrivate *const d;
+    static GLPixelUploadBuffer *s_instance;
+};
+
 } // namespace
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(KWin::ShaderTraits)
@@ -29,6 +29,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "pointer_input.h"
 #include "scene.h"
 #include "screenedge.h"
+#include "vblankclock.h"
 #include "wayland_server.h"
 #include "colorcorrection/manager.h"
 
@@ -144,6 +145,8 @@ void Platform::setSoftWareCursor(bool set)
         disconnect(Cursor::self(), &Cursor::posChanged, this, &Platform::triggerCursorRepaint);
         disconnect(this, &Platform::cursorChanged, this, &Platform::triggerCursorRepaint);
     }
+    // paints the cursor into the scene or removes the last one painted
+    triggerCursorRepaint();
 }
 
 void Platform::triggerCursorRepaint()
@@ -484,6 +487,23 @@ void Platform::createEffectsHandler(Compositor *compositor, Scene *scene)
     new EffectsHandlerImpl(compositor, scene);
 }
 
+VBlankClock *Platform::vblankClock()
+{
+    const auto outs = enabledOutputs();
+    if (!outs.isEmpty()) {
+        return outs.first()->vblankClock();
+    }
+    if (!m_fallbackVBlankClock) {
+        m_fallbackVBlankClock = new VBlankClock(this);
+    }
+    return m_fallbackVBlankClock;
+}
+
+int Platform::frameQueueDepth() const
+{
+    return 1;
+}
+
 QString Platform::supportInformation() const
 {
     return QStringLiteral("Name: %1\n").arg(metaObject()->className());
@@ -56,6 +56,7 @@ class Scene;
 class Screens;
 class ScreenEdges;
 class Toplevel;
+class VBlankClock;
 class WaylandCursorTheme;
 
 namespace Decoration
@@ -421,6 +422,25 @@ public:
         return Outputs();
     }
 
+    /**
+     * The VBlankClock the Compositor should align its repaints to.
+     *
+     * The default implementation returns the clock of the first enabled output. Platforms
+     * without outputs get a software clock, the Compositor sets its refresh rate. Such
+     * platforms can feed the clock with presentation timestamps if available.
+     **/
+    virtual VBlankClock *vblankClock();
+    /**
+     * The number of frames an output can have waiting for scanout if outputs are repainted
+     * independently. With @c 1 the next frame is only rendered once the last one reached the
+     * screen, which gives the lowest latency. With @c 2 a frame is rendered while the last
+     * one still waits for the page flip, so paint times slightly above one refresh cycle do
+     * not halve the frame rate.
+     *
+     * The default implementation returns @c 1.
+     **/
+    virtual int frameQueueDepth() const;
+
     /*
      * A string of information to include in kwin debug output
      * It should not be translated.
@@ -531,6 +551,7 @@ private:
     int m_hideCursorCounter = 0;
     ColorCorrect::Manager *m_colorCorrect = nullptr;
     bool m_supportsGammaControl = false;
+    VBlankClock *m_fallbackVBlankClock = nullptr;
 };
 
 }
@@ -24,6 +24,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "options.h"
 #include "platform.h"
 #include "scene.h"
+#include "shm_upload.h"
 #include "wayland_server.h"
 #include <KWayland/Server/buffer_interface.h>
 #include <KWayland/Server/display.h>
@@ -35,6 +36,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 // Qt
 #include <QOpenGLContext>
 #include <QOpenGLFramebufferObject>
+#include <QtMath>
 
 #include <memory>
 
@@ -47,6 +49,8 @@ typedef GLboolean(*eglQueryWaylandBufferWL_func)(EGLDisplay dpy, struct wl_resou
 eglBindWaylandDisplayWL_func eglBindWaylandDisplayWL = nullptr;
 eglUnbindWaylandDisplayWL_func eglUnbindWaylandDisplayWL = nullptr;
 eglQueryWaylandBufferWL_func eglQueryWaylandBufferWL = nullptr;
+typedef EGLBoolean(*eglSwapBuffersWithDamage_func)(EGLDisplay dpy, EGLSurface surface, EGLint *rects, EGLint n_rects);
+eglSwapBuffersWithDamage_func eglSwapBuffersWithDamage = nullptr;
 
 #ifndef EGL_WAYLAND_BUFFER_WL
 #define EGL_WAYLAND_BUFFER_WL                   0x31D5
@@ -150,6 +154,40 @@ void AbstractEglBackend::initBufferAge()
     }
 }
 
+void AbstractEglBackend::initSwapBuffersWithDamage()
+{
+    eglSwapBuffersWithDamage = nullptr;
+    if (qgetenv("KWIN_USE_SWAP_WITH_DAMAGE") == "0") {
+        return;
+    }
+    if (hasExtension(QByteArrayLiteral("EGL_KHR_swap_buffers_with_damage"))) {
+        eglSwapBuffersWithDamage = (eglSwapBuffersWithDamage_func)eglGetProcAddress("eglSwapBuffersWithDamageKHR");
+    } else if (hasExtension(QByteArrayLiteral("EGL_EXT_swap_buffers_with_damage"))) {
+        eglSwapBuffersWithDamage = (eglSwapBuffersWithDamage_func)eglGetProcAddress("eglSwapBuffersWithDamageEXT");
+    }
+}
+
+EGLBoolean AbstractEglBackend::swapBuffers(EGLSurface surface, const QRegion &damage, const QRect &geometry, qreal scale)
+{
+    const QRegion region = damage.intersected(geometry);
+    if (!eglSwapBuffersWithDamage || region.isEmpty()) {
+        return eglSwapBuffers(m_display, surface);
+    }
+    // the rectangles are in buffer pixels with the origin in the bottom left corner
+    const int height = qCeil(geometry.height() * scale);
+    QVector<EGLint> rects;
+    rects.reserve(region.rectCount() * 4);
+    for (const QRect &r : region) {
+        const QRect rect = r.translated(-geometry.topLeft());
+        const int left = qFloor(rect.x() * scale);
+        const int top = qFloor(rect.y() * scale);
+        const int right = qCeil((rect.x() + rect.width()) * scale);
+        const int bottom = qCeil((rect.y() + rect.height()) * scale);
+        rects << left << height - bottom << right - left << bottom - top;
+    }
+    return eglSwapBuffersWithDamage(m_display, surface, rects.data(), rects.count() / 4);
+}
+
 void AbstractEglBackend::initWayland()
 {
     if (!WaylandServer::self()) {
@@ -375,6 +413,9 @@ void AbstractEglTexture::updateTexture(WindowPixmap *pixmap)
     auto s = pixmap->surface();
     if (!buffer->shmBuffer()) {
         q->bind();
+        // the swizzle for shm buffers would apply to the image as well
+        setShmSwizzle(false, false);
+        m_shmFormat = QImage::Format_Invalid;
         EGLImageKHR image = attach(buffer);
         q->unbind();
         if (image != EGL_NO_IMAGE_KHR) {
@@ -397,47 +438,113 @@ void AbstractEglTexture::updateTexture(WindowPixmap *pixmap)
     s->resetTrackedDamage();
     auto scale = s->scale(); //damage is normalised, so needs converting up to match texture
 
+    if (image.format() != m_shmFormat) {
+        // a different kind of buffer got attached, the whole texture has to be specified anew
+        specifyShmTexture(image);
+        q->unbind();
+        return;
+    }
+
+    const QVector<QRect> rects = shmUploadRects(damage, scale, image.rect());
+    if (const ShmUpload upload = shmUpload(image)) {
+        // large damage goes through a pixel buffer, so that the GPU copies it into the texture
+        // while the compositor goes on
+        GLPixelUploadBuffer *uploadBuffer = GLPixelUploadBuffer::instance();
+        if (uploadBuffer && uploadBuffer->upload(m_target, image.constBits(), image.bytesPerLine(), rects,
+                                                 QPoint(), upload.format, GL_UNSIGNED_BYTE)) {
+            q->unbind();
+            return;
+        }
+        // upload straight from the client's buffer
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, image.bytesPerLine() / 4);
+        for (const QRect &rect : rects) {
+            glPixelStorei(GL_UNPACK_SKIP_PIXELS, rect.x());
+            glPixelStorei(GL_UNPACK_SKIP_ROWS, rect.y());
+            glTexSubImage2D(m_target, 0, rect.x(), rect.y(), rect.width(), rect.height(),
+                            upload.format, GL_UNSIGNED_BYTE, image.constBits());
+        }
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+        q->unbind();
+        return;
+    }
+
     // TODO: this should be shared with GLTexture::update
     if (GLPlatform::instance()->isGLES()) {
         if (s_supportsARGB32 && (image.format() == QImage::Format_ARGB32 || image.format() == QImage::Format_ARGB32_Premultiplied)) {
             const QImage im = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
-            for (const QRect &rect : damage.rects()) {
-                auto scaledRect = QRect(rect.x() * scale, rect.y() * scale, rect.width() * scale, rect.height() * scale);
-                glTexSubImage2D(m_target, 0, scaledRect.x(), scaledRect.y(), scaledRect.width(), scaledRect.height(),
-                                GL_BGRA_EXT, GL_UNSIGNED_BYTE, im.copy(scaledRect).bits());
+            for (const QRect &rect : rects) {
+                glTexSubImage2D(m_target, 0, rect.x(), rect.y(), rect.width(), rect.height(),
+                                GL_BGRA_EXT, GL_UNSIGNED_BYTE, im.copy(rect).bits());
             }
         } else {
             const QImage im = image.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
-            for (const QRect &rect : damage.rects()) {
-                auto scaledRect = QRect(rect.x() * scale, rect.y() * scale, rect.width() * scale, rect.height() * scale);
-                glTexSubImage2D(m_target, 0, scaledRect.x(), scaledRect.y(), scaledRect.width(), scaledRect.height(),
-                                GL_RGBA, GL_UNSIGNED_BYTE, im.copy(scaledRect).bits());
+            for (const QRect &rect : rects) {
+                glTexSubImage2D(m_target, 0, rect.x(), rect.y(), rect.width(), rect.height(),
+                                GL_RGBA, GL_UNSIGNED_BYTE, im.copy(rect).bits());
             }
         }
     } else {
         const QImage im = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
-        for (const QRect &rect : damage.rects()) {
-            auto scaledRect = QRect(rect.x() * scale, rect.y() * scale, rect.width() * scale, rect.height() * scale);
-            glTexSubImage2D(m_target, 0, scaledRect.x(), scaledRect.y(), scaledRect.width(), scaledRect.height(),
-                            GL_BGRA, GL_UNSIGNED_BYTE, im.copy(scaledRect).bits());
+        for (const QRect &rect : rects) {
+            glTexSubImage2D(m_target, 0, rect.x(), rect.y(), rect.width(), rect.height(),
+                            GL_BGRA, GL_UNSIGNED_BYTE, im.copy(rect).bits());
         }
     }
     q->unbind();
 }
 
-bool AbstractEglTexture::loadShmTexture(const QPointer< KWayland::Server::BufferInterface > &buffer)
+AbstractEglTexture::ShmUpload AbstractEglTexture::shmUpload(const QImage &image)
 {
-    const QImage &image = buffer->data();
-    if (image.isNull()) {
-        return false;
+    ShmUpload upload;
+    if (!s_supportsUnpack || image.bytesPerLine() % 4) {
+        return upload;
+    }
+    const bool opaque = image.format() == QImage::Format_RGB32;
+    if (!opaque && image.format() != QImage::Format_ARGB32_Premultiplied) {
+        return upload;
+    }
+    if (!GLPlatform::instance()->isGLES()) {
+        // the alpha byte of a buffer without alpha is ignored by a RGB texture
+        upload.internalFormat = opaque ? GL_RGB8 : GL_RGBA8;
+        upload.format = GL_BGRA;
+        return upload;
+    }
+    // the pixels are only stored in BGRA order on little endian systems,
+    // everything else is sorted out by swizzling instead of converting
+    if (QSysInfo::ByteOrder != QSysInfo::LittleEndian || (opaque && !s_supportsTextureSwizzle)) {
+        return upload;
+    }
+    if (s_supportsARGB32) {
+        upload.internalFormat = GL_BGRA_EXT;
+        upload.format = GL_BGRA_EXT;
+    } else if (s_supportsTextureSwizzle) {
+        upload.internalFormat = GL_RGBA;
+        upload.format = GL_RGBA;
+        upload.swapRedBlue = true;
+    } else {
+        return upload;
     }
+    upload.opaque = opaque;
+    return upload;
+}
 
-    glGenTextures(1, &m_texture);
-    q->setWrapMode(GL_CLAMP_TO_EDGE);
-    q->setFilter(GL_LINEAR);
-    q->bind();
-
+bool AbstractEglTexture::specifyShmTexture(const QImage &image)
+{
     const QSize &size = image.size();
+    m_shmFormat = image.format();
+
+    if (const ShmUpload upload = shmUpload(image)) {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, image.bytesPerLine() / 4);
+        glTexImage2D(m_target, 0, upload.internalFormat, size.width(), size.height(), 0,
+                     upload.format, GL_UNSIGNED_BYTE, image.constBits());
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        setShmSwizzle(upload.swapRedBlue, upload.opaque);
+        return true;
+    }
+    setShmSwizzle(false, false);
+
     // TODO: this should be shared with GLTexture(const QImage&, GLenum)
     GLenum format = 0;
     switch (image.format()) {
@@ -449,6 +556,7 @@ bool AbstractEglTexture::loadShmTexture(const QPointer< KWayland::Server::Buffer
         format = GL_RGB8;
         break;
     default:
+        m_shmFormat = QImage::Format_Invalid;
         return false;
     }
     if (GLPlatform::instance()->isGLES()) {
@@ -462,13 +570,42 @@ bool AbstractEglTexture::loadShmTexture(const QPointer< KWayland::Server::Buffer
                          0, GL_RGBA, GL_UNSIGNED_BYTE, im.bits());
         }
     } else {
+        const QImage im = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
         glTexImage2D(m_target, 0, format, size.width(), size.height(), 0,
-                    GL_BGRA, GL_UNSIGNED_BYTE, image.bits());
+                    GL_BGRA, GL_UNSIGNED_BYTE, im.bits());
+    }
+    return true;
+}
+
+void AbstractEglTexture::setShmSwizzle(bool swapRedBlue, bool opaque)
+{
+    if (!swapRedBlue && !opaque && !m_shmSwizzled) {
+        return;
+    }
+    q->setSwizzle(swapRedBlue ? GL_BLUE : GL_RED, GL_GREEN, swapRedBlue ? GL_RED : GL_BLUE, opaque ? GL_ONE : GL_ALPHA);
+    m_shmSwizzled = swapRedBlue || opaque;
+}
+
+bool AbstractEglTexture::loadShmTexture(const QPointer< KWayland::Server::BufferInterface > &buffer)
+{
+    const QImage &image = buffer->data();
+    if (image.isNull()) {
+        return false;
+    }
+
+    glGenTextures(1, &m_texture);
+    q->setWrapMode(GL_CLAMP_TO_EDGE);
+    q->setFilter(GL_LINEAR);
+    q->bind();
+
+    if (!specifyShmTexture(image)) {
+        q->unbind();
+        return false;
     }
 
     q->unbind();
     q->setYInverted(true);
-    m_size = size;
+    m_size = image.size();
     updateMatrix();
     return true;
 }
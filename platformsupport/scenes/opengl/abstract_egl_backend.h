@@ -22,6 +22,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "backend.h"
 #include "texture.h"
 
+#include <QImage>
 #include <QObject>
 #include <epoxy/egl.h>
 #include <fixx11h.h>
@@ -70,6 +71,17 @@ protected:
     bool initEglAPI();
     void initKWinGL();
     void initBufferAge();
+    /**
+     * Resolves EGL_KHR_swap_buffers_with_damage or EGL_EXT_swap_buffers_with_damage,
+     * unless disabled through the environment variable KWIN_USE_SWAP_WITH_DAMAGE=0.
+     **/
+    void initSwapBuffersWithDamage();
+    /**
+     * Swaps the buffers of @p surface, which shows @p geometry at @p scale. If supported
+     * the compositor gets told that only @p damage changed since the previous frame,
+     * an empty @p damage swaps the whole surface.
+     **/
+    EGLBoolean swapBuffers(EGLSurface surface, const QRegion &damage, const QRect &geometry, qreal scale = 1.0);
     void initClientExtensions();
     void initWayland();
     bool hasClientExtension(const QByteArray &ext) const;
@@ -108,6 +120,27 @@ protected:
     }
 
 private:
+    /**
+     * How the pixels of a shm buffer can be handed to GL as they are.
+     **/
+    struct ShmUpload {
+        GLenum internalFormat = 0;
+        GLenum format = 0;
+        bool swapRedBlue = false;
+        bool opaque = false;
+        explicit operator bool() const {
+            return format != 0;
+        }
+    };
+    /**
+     * Returns a null ShmUpload if @p image has to be converted before uploading it.
+     **/
+    static ShmUpload shmUpload(const QImage &image);
+    /**
+     * Uploads all of @p image into the bound texture.
+     **/
+    bool specifyShmTexture(const QImage &image);
+    void setShmSwizzle(bool swapRedBlue, bool opaque);
     bool loadShmTexture(const QPointer<KWayland::Server::BufferInterface> &buffer);
     bool loadEglTexture(const QPointer<KWayland::Server::BufferInterface> &buffer);
     EGLImageKHR attach(const QPointer<KWayland::Server::BufferInterface> &buffer);
@@ -115,6 +148,9 @@ private:
     SceneOpenGLTexture *q;
     AbstractEglBackend *m_backend;
     EGLImageKHR m_image;
+    // the format of the shm buffer the texture was specified from
+    QImage::Format m_shmFormat = QImage::Format_Invalid;
+    bool m_shmSwizzled = false;
 };
 
 }
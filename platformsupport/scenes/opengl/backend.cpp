@@ -22,6 +22,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <kwineffects.h>
 #include <logging.h>
 
+#include "scene.h"
 #include "screens.h"
 
 #include <epoxy/gl.h>
@@ -58,26 +59,13 @@ void OpenGLBackend::idle()
 
 void OpenGLBackend::addToDamageHistory(const QRegion &region)
 {
-    if (m_damageHistory.count() > 10)
-        m_damageHistory.removeLast();
-
-    m_damageHistory.prepend(region);
+    m_damageJournal.add(region);
 }
 
 QRegion OpenGLBackend::accumulatedDamageHistory(int bufferAge) const
 {
-    QRegion region;
-
-    // Note: An age of zero means the buffer contents are undefined
-    if (bufferAge > 0 && bufferAge <= m_damageHistory.count()) {
-        for (int i = 0; i < bufferAge - 1; i++)
-            region |= m_damageHistory[i];
-    } else {
-        const QSize &s = screens()->size();
-        region = QRegion(0, 0, s.width(), s.height());
-    }
-
-    return region;
+    const QSize &s = screens()->size();
+    return m_damageJournal.accumulate(bufferAge, QRegion(0, 0, s.width(), s.height()));
 }
 
 OverlayWindow* OpenGLBackend::overlayWindow()
@@ -103,6 +91,26 @@ bool OpenGLBackend::perScreenRendering() const
     return false;
 }
 
+bool OpenGLBackend::directScanout(int screenId, KWayland::Server::SurfaceInterface *surface)
+{
+    Q_UNUSED(screenId)
+    Q_UNUSED(surface)
+    return false;
+}
+
+QVector<OverlayCandidate> OpenGLBackend::assignOverlays(int screenId, const QVector<OverlayCandidate> &candidates)
+{
+    Q_UNUSED(screenId)
+    Q_UNUSED(candidates)
+    return QVector<OverlayCandidate>();
+}
+
+bool OpenGLBackend::presentOverlays(int screenId)
+{
+    Q_UNUSED(screenId)
+    return false;
+}
+
 void OpenGLBackend::copyPixels(const QRegion &region)
 {
     const int height = screens()->size().height();
@@ -21,16 +21,28 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef KWIN_SCENE_OPENGL_BACKEND_H
 #define KWIN_SCENE_OPENGL_BACKEND_H
 
+#include "damagejournal.h"
+
 #include <QElapsedTimer>
 #include <QRegion>
+#include <QVector>
 
 #include <kwin_export.h>
 
+namespace KWayland
+{
+namespace Server
+{
+class SurfaceInterface;
+}
+}
+
 namespace KWin
 {
 class OpenGLBackend;
 class OverlayWindow;
 class SceneOpenGL;
+struct OverlayCandidate;
 class SceneOpenGLTexture;
 class SceneOpenGLTexturePrivate;
 class WindowPixmap;
@@ -91,6 +103,31 @@ public:
      **/
     virtual bool perScreenRendering() const;
     virtual QRegion prepareRenderingForScreen(int screenId);
+    /**
+     * @brief Presents the current buffer of @p surface on screen @p screenId without compositing.
+     *
+     * The SceneOpenGL only calls this if the surface covers the whole screen and nothing needs to
+     * be painted on top of it. If the backend cannot scan the buffer out it returns @c false and the
+     * screen gets rendered as usual.
+     * Default implementation returns @c false.
+     **/
+    virtual bool directScanout(int screenId, KWayland::Server::SurfaceInterface *surface);
+    /**
+     * @brief Assigns @p candidates to hardware planes of screen @p screenId for the next present.
+     *
+     * The candidates are ordered topmost first. The SceneOpenGL still composites the returned
+     * candidates, unless presentOverlays succeeds because nothing but them changed.
+     * Default implementation assigns none.
+     *
+     * @return The candidates which are going to be shown on a plane.
+     **/
+    virtual QVector<OverlayCandidate> assignOverlays(int screenId, const QVector<OverlayCandidate> &candidates);
+    /**
+     * @brief Presents the overlays assigned to screen @p screenId on top of the last rendered frame.
+     *
+     * Default implementation returns @c false.
+     **/
+    virtual bool presentOverlays(int screenId);
     /**
      * @brief Compositor is going into idle mode, flushes any pending paints.
      **/
@@ -310,7 +347,7 @@ private:
     /**
      * @brief The damage history for the past 10 frames.
      */
-    QList<QRegion> m_damageHistory;
+    DamageJournal m_damageJournal;
     /**
      * @brief Timer to measure how long a frame renders.
      **/
@@ -0,0 +1,62 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "damagejournal.h"
+
+namespace KWin
+{
+
+DamageJournal::DamageJournal(int capacity)
+    : m_frames(qMax(capacity, 1))
+{
+}
+
+void DamageJournal::add(const QRegion &region)
+{
+    m_newest = (m_newest + 1) % m_frames.count();
+    m_frames[m_newest] = region;
+    m_count = qMin(m_count + 1, m_frames.count());
+}
+
+QRegion DamageJournal::accumulate(int bufferAge, const QRegion &fallback) const
+{
+    // a buffer of age n lacks the damage of the n - 1 frames presented after it. The
+    // journal also has to know the frame of the buffer itself, after a clear() the
+    // age reported for the surface tells nothing about what is on screen
+    if (bufferAge <= 0 || bufferAge > m_count) {
+        return fallback;
+    }
+    QRegion region;
+    for (int i = 0; i < bufferAge - 1; ++i) {
+        const int index = (m_newest - i + m_frames.count()) % m_frames.count();
+        region |= m_frames.at(index);
+    }
+    return region;
+}
+
+void DamageJournal::clear()
+{
+    for (QRegion &frame : m_frames) {
+        frame = QRegion();
+    }
+    m_newest = -1;
+    m_count = 0;
+}
+
+}
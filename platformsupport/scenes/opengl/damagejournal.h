@@ -0,0 +1,75 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#ifndef KWIN_DAMAGE_JOURNAL_H
+#define KWIN_DAMAGE_JOURNAL_H
+
+#include <QRegion>
+#include <QVector>
+
+#include <kwin_export.h>
+
+namespace KWin
+{
+
+/**
+ * @brief The damage of the last frames presented on one surface.
+ *
+ * The journal is a ring of the regions posted with the most recent frames. Given the
+ * age of the back buffer (as reported by EGL_EXT_buffer_age or GLX_EXT_buffer_age) it
+ * tells which area has to be repainted on top of the frame's own damage to bring the
+ * buffer up to date.
+ **/
+class KWIN_EXPORT DamageJournal
+{
+public:
+    explicit DamageJournal(int capacity = 10);
+
+    /**
+     * Records @p region as the damage of the frame which just got presented.
+     **/
+    void add(const QRegion &region);
+    /**
+     * Returns the damage accumulated since a buffer of @p bufferAge was presented.
+     * An age of zero means the buffer contents are undefined; in that case and if
+     * the frame of the buffer is not in the journal, @p fallback is returned.
+     **/
+    QRegion accumulate(int bufferAge, const QRegion &fallback) const;
+    /**
+     * Forgets all recorded frames, e.g. after something else than the surface's own
+     * buffers got presented.
+     **/
+    void clear();
+
+    int count() const {
+        return m_count;
+    }
+    int capacity() const {
+        return m_frames.count();
+    }
+
+private:
+    QVector<QRegion> m_frames;
+    int m_newest = -1;
+    int m_count = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,53 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "shm_upload.h"
+
+namespace KWin
+{
+
+static int area(const QRect &rect)
+{
+    return rect.width() * rect.height();
+}
+
+QVector<QRect> shmUploadRects(const QRegion &damage, int scale, const QRect &bounds, int slack)
+{
+    QVector<QRect> rects;
+    rects.reserve(damage.rectCount());
+    for (const QRect &rect : damage) {
+        const QRect scaled = QRect(rect.topLeft() * scale, rect.size() * scale).intersected(bounds);
+        if (scaled.isEmpty()) {
+            continue;
+        }
+        if (!rects.isEmpty()) {
+            // the rectangles of a region are sorted, so neighbours are usually close
+            QRect &previous = rects.last();
+            const QRect united = previous | scaled;
+            if (area(united) - area(previous) - area(scaled) <= slack) {
+                previous = united;
+                continue;
+            }
+        }
+        rects << scaled;
+    }
+    return rects;
+}
+
+}
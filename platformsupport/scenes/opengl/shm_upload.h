@@ -0,0 +1,42 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#ifndef KWIN_SCENE_OPENGL_SHM_UPLOAD_H
+#define KWIN_SCENE_OPENGL_SHM_UPLOAD_H
+
+#include <QRect>
+#include <QRegion>
+#include <QVector>
+
+#include <kwin_export.h>
+
+namespace KWin
+{
+
+/**
+ * Returns the rectangles to upload from a shm buffer for the surface damage @p damage.
+ * The damage is scaled by the buffer @p scale and limited to @p bounds. A rectangle is
+ * merged into the previous one if that uploads at most @p slack additional pixels, as
+ * each rectangle costs a glTexSubImage2D call.
+ **/
+KWIN_EXPORT QVector<QRect> shmUploadRects(const QRegion &damage, int scale, const QRect &bounds, int slack = 4096);
+
+}
+
+#endif
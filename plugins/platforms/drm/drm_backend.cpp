@@ -30,6 +30,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "scene_qpainter_drm_backend.h"
 #include "screens_drm.h"
 #include "udev.h"
+#include "vblankclock.h"
 #include "wayland_server.h"
 #if HAVE_GBM
 #include "egl_gbm_backend.h"
@@ -76,6 +77,11 @@ DrmBackend::DrmBackend(QObject *parent)
 {
     setSupportsGammaControl(true);
     handleOutputs();
+    bool ok = false;
+    const int depth = qEnvironmentVariableIntValue("KWIN_DRM_FRAME_QUEUE_DEPTH", &ok);
+    if (ok) {
+        m_frameQueueDepth = qBound(1, depth, 2);
+    }
 }
 
 DrmBackend::~DrmBackend()
@@ -192,6 +198,8 @@ void DrmBackend::reactivate()
             o->showCursor();
             o->moveCursor(cp);
         }
+    } else if (m_softwareCursorFallback) {
+        updateCursor();
     }
     // restart compositor
     m_pageFlipsPending = 0;
@@ -207,13 +215,17 @@ void DrmBackend::deactivate()
         return;
     }
     // block compositor
-    if (m_pageFlipsPending == 0 && Compositor::self()) {
+    if (Compositor::self() && !Compositor::self()->isBufferSwapPending()) {
         Compositor::self()->aboutToSwapBuffers();
     }
     // hide cursor and disable
     for (auto it = m_outputs.constBegin(); it != m_outputs.constEnd(); ++it) {
         DrmOutput *o = *it;
         o->hideCursor();
+        // reactivate restarts the compositor with whatever it renders then
+        if (o->dropQueuedBuffer()) {
+            m_pageFlipsPending--;
+        }
     }
     m_active = false;
 }
@@ -221,23 +233,29 @@ void DrmBackend::deactivate()
 void DrmBackend::pageFlipHandler(int fd, unsigned int frame, unsigned int sec, unsigned int usec, void *data)
 {
     Q_UNUSED(fd)
-    Q_UNUSED(frame)
-    Q_UNUSED(sec)
-    Q_UNUSED(usec)
     auto output = reinterpret_cast<DrmOutput*>(data);
+    // page flip timestamps are on CLOCK_MONOTONIC, see DRM_CAP_TIMESTAMP_MONOTONIC
+    output->vblankClock()->notifyVBlank(qint64(sec) * 1000000000 + qint64(usec) * 1000, frame);
     output->pageFlipped();
     output->m_backend->m_pageFlipsPending--;
+    // the frame rendered meanwhile gets the next page flip
+    bool queuedFrameLost = false;
+    if (output->m_queuedBuffer && !output->presentQueuedBuffer()) {
+        queuedFrameLost = true;
+        output->m_backend->m_pageFlipsPending--;
+    }
     if (output->m_backend->m_pageFlipsPending == 0) {
-        // TODO: improve, this currently means we wait for all page flips or all outputs.
-        // It would be better to driver the repaint per output
-
         if (output->m_dpmsAtomicOffPending) {
             output->m_modesetRequested = true;
             output->dpmsAtomicOff();
         }
-
-        if (Compositor::self()) {
-            Compositor::self()->bufferSwapComplete();
+    }
+    // the Compositor decides whether it waits for all outputs or drives them independently
+    if (Compositor::self()) {
+        Compositor::self()->bufferSwapComplete(output);
+        if (queuedFrameLost) {
+            Compositor::self()->bufferSwapDiscarded(output);
+            Compositor::self()->addRepaint(output->geometry());
         }
     }
 }
@@ -608,23 +626,37 @@ DrmOutput *DrmBackend::findOutput(const QByteArray &uuid)
     return nullptr;
 }
 
-void DrmBackend::present(DrmBuffer *buffer, DrmOutput *output)
+bool DrmBackend::present(DrmBuffer *buffer, DrmOutput *output)
 {
     if (!buffer || buffer->bufferId() == 0) {
         if (m_deleteBufferAfterPageFlip) {
             delete buffer;
         }
-        return;
+        return false;
     }
 
     if (output->present(buffer)) {
         m_pageFlipsPending++;
-        if (m_pageFlipsPending == 1 && Compositor::self()) {
-            Compositor::self()->aboutToSwapBuffers();
+        if (Compositor::self()) {
+            Compositor::self()->aboutToSwapBuffers(output);
         }
+        return true;
     } else if (m_deleteBufferAfterPageFlip) {
         delete buffer;
     }
+    return false;
+}
+
+bool DrmBackend::presentOverlays(DrmOutput *output)
+{
+    if (!output->presentOverlays()) {
+        return false;
+    }
+    m_pageFlipsPending++;
+    if (Compositor::self()) {
+        Compositor::self()->aboutToSwapBuffers(output);
+    }
+    return true;
 }
 
 void DrmBackend::initCursor()
@@ -639,7 +671,8 @@ void DrmBackend::initCursor()
             for (auto it = m_outputs.constBegin(); it != m_outputs.constEnd(); ++it) {
                 if (m_cursorEnabled) {
                     if (!(*it)->showCursor()) {
-                        setSoftWareCursor(true);
+                        fallBackToSoftwareCursor();
+                        return;
                     }
                 } else {
                     (*it)->hideCursor();
@@ -670,18 +703,44 @@ void DrmBackend::setCursor()
     if (m_cursorEnabled) {
         for (auto it = m_outputs.constBegin(); it != m_outputs.constEnd(); ++it) {
             if (!(*it)->showCursor()) {
-                setSoftWareCursor(true);
+                fallBackToSoftwareCursor();
+                markCursorAsRendered();
+                return;
             }
         }
+        if (m_softwareCursorFallback) {
+            // the cursor planes work again, pointer motion no longer needs a repaint
+            qCDebug(KWIN_DRM) << "Hardware cursor recovered";
+            m_softwareCursorFallback = false;
+            setSoftWareCursor(false);
+        }
     }
     markCursorAsRendered();
 }
 
-void DrmBackend::updateCursor()
+void DrmBackend::fallBackToSoftwareCursor()
 {
+    if (!m_active) {
+        // expected while another session is DRM master, reactivate sets the cursor again
+        return;
+    }
+    for (auto it = m_outputs.constBegin(); it != m_outputs.constEnd(); ++it) {
+        (*it)->hideCursor();
+    }
     if (usesSoftwareCursor()) {
         return;
     }
+    qCWarning(KWIN_DRM) << "Failed to show the hardware cursor, falling back to software cursor";
+    m_softwareCursorFallback = true;
+    setSoftWareCursor(true);
+}
+
+void DrmBackend::updateCursor()
+{
+    // a cursor change retries the hardware cursor, a software cursor means a repaint for every motion
+    if (usesSoftwareCursor() && !m_softwareCursorFallback) {
+        return;
+    }
     if (isCursorHidden()) {
         return;
     }
@@ -715,7 +774,7 @@ void DrmBackend::doHideCursor()
 
 void DrmBackend::moveCursor()
 {
-    if (!m_cursorEnabled || isCursorHidden()) {
+    if (!m_cursorEnabled || isCursorHidden() || usesSoftwareCursor()) {
         return;
     }
     for (auto it = m_outputs.constBegin(); it != m_outputs.constEnd(); ++it) {
@@ -756,6 +815,12 @@ DrmSurfaceBuffer *DrmBackend::createBuffer(const std::shared_ptr<GbmSurface> &su
     DrmSurfaceBuffer *b = new DrmSurfaceBuffer(m_fd, surface);
     return b;
 }
+
+DrmClientBuffer *DrmBackend::createBuffer(const std::shared_ptr<DrmClientImport> &import, KWayland::Server::BufferInterface *buffer)
+{
+    DrmClientBuffer *b = new DrmClientBuffer(m_fd, import, buffer);
+    return b;
+}
 #endif
 
 void DrmBackend::outputDpmsChanged()
@@ -779,6 +844,14 @@ QVector<CompositingType> DrmBackend::supportedCompositors() const
 #endif
 }
 
+int DrmBackend::frameQueueDepth() const
+{
+    // QPainter alternates between two dumb buffers, one of them is always on screen. GBM surfaces
+    // provide enough buffers for the one on screen, the pending flip, the queued frame and the
+    // one getting rendered.
+    return m_deleteBufferAfterPageFlip ? m_frameQueueDepth : 1;
+}
+
 QString DrmBackend::supportInformation() const
 {
     QString supportInfo;
@@ -787,6 +860,7 @@ QString DrmBackend::supportInformation() const
     s << "Name: " << "DRM" << endl;
     s << "Active: " << m_active << endl;
     s << "Atomic Mode Setting: " << m_atomicModeSetting << endl;
+    s << "Frame queue depth: " << frameQueueDepth() << endl;
     return supportInfo;
 }
 
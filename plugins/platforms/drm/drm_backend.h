@@ -46,6 +46,7 @@ namespace KWayland
 {
 namespace Server
 {
+class BufferInterface;
 class OutputInterface;
 class OutputDeviceInterface;
 class OutputChangeSet;
@@ -84,8 +85,10 @@ public:
     DrmDumbBuffer *createBuffer(const QSize &size);
 #if HAVE_GBM
     DrmSurfaceBuffer *createBuffer(const std::shared_ptr<GbmSurface> &surface);
+    DrmClientBuffer *createBuffer(const std::shared_ptr<DrmClientImport> &import, KWayland::Server::BufferInterface *buffer);
 #endif
-    void present(DrmBuffer *buffer, DrmOutput *output);
+    bool present(DrmBuffer *buffer, DrmOutput *output);
+    bool presentOverlays(DrmOutput *output);
 
     int fd() const {
         return m_fd;
@@ -117,6 +120,7 @@ public:
     bool atomicModeSetting() const {
         return m_atomicModeSetting;
     }
+    int frameQueueDepth() const override;
 
     void setGbmDevice(gbm_device *device) {
         m_gbmDevice = device;
@@ -158,6 +162,7 @@ private:
     void updateCursor();
     void moveCursor();
     void initCursor();
+    void fallBackToSoftwareCursor();
     void outputDpmsChanged();
     void readOutputsConfiguration();
     QByteArray generateOutputConfigurationUuid() const;
@@ -179,6 +184,9 @@ private:
     bool m_deleteBufferAfterPageFlip;
     bool m_atomicModeSetting = false;
     bool m_cursorEnabled = false;
+    int m_frameQueueDepth = 1;
+    // the hardware cursor failed at runtime and gets retried on cursor changes
+    bool m_softwareCursorFallback = false;
     QSize m_cursorSize;
     int m_pageFlipsPending = 0;
     bool m_active = false;
@@ -23,6 +23,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "logging.h"
 
+#include <KWayland/Server/buffer_interface.h>
+
 // system
 #include <sys/mman.h>
 #include <errno.h>
@@ -59,10 +61,77 @@ DrmSurfaceBuffer::~DrmSurfaceBuffer()
     releaseGbm();
 }
 
+bool DrmSurfaceBuffer::needsModeChange(DrmBuffer *b) const
+{
+    if (DrmSurfaceBuffer *sb = dynamic_cast<DrmSurfaceBuffer*>(b)) {
+        return hasBo() != sb->hasBo();
+    } else if (DrmClientBuffer *cb = dynamic_cast<DrmClientBuffer*>(b)) {
+        return hasBo() != cb->hasBo();
+    } else {
+        return true;
+    }
+}
+
 void DrmSurfaceBuffer::releaseGbm()
 {
     m_surface->releaseBuffer(m_bo);
     m_bo = nullptr;
 }
 
+// DrmClientImport
+DrmClientImport::DrmClientImport(int fd, gbm_bo *bo)
+    : m_fd(fd)
+    , m_bo(bo)
+    , m_size(gbm_bo_get_width(bo), gbm_bo_get_height(bo))
+    , m_format(gbm_bo_get_format(bo))
+{
+    if (drmModeAddFB(fd, m_size.width(), m_size.height(), 24, 32, gbm_bo_get_stride(m_bo), gbm_bo_get_handle(m_bo).u32, &m_bufferId) != 0) {
+        qCWarning(KWIN_DRM) << "drmModeAddFB for client buffer failed";
+    }
+}
+
+DrmClientImport::~DrmClientImport()
+{
+    if (m_bufferId) {
+        drmModeRmFB(m_fd, m_bufferId);
+    }
+    gbm_bo_destroy(m_bo);
+}
+
+// DrmClientBuffer
+DrmClientBuffer::DrmClientBuffer(int fd, const std::shared_ptr<DrmClientImport> &import, KWayland::Server::BufferInterface *buffer)
+    : DrmBuffer(fd)
+    , m_buffer(buffer)
+    , m_import(import)
+{
+    m_buffer->ref();
+    m_bufferId = m_import->bufferId();
+    m_size = m_import->size();
+}
+
+DrmClientBuffer::~DrmClientBuffer()
+{
+    // gone if the client destroyed the buffer while it was on screen
+    if (m_buffer) {
+        m_buffer->unref();
+    }
+}
+
+bool DrmClientBuffer::needsModeChange(DrmBuffer *b) const
+{
+    if (DrmClientBuffer *cb = dynamic_cast<DrmClientBuffer*>(b)) {
+        return hasBo() != cb->hasBo();
+    } else if (DrmSurfaceBuffer *sb = dynamic_cast<DrmSurfaceBuffer*>(b)) {
+        return hasBo() != sb->hasBo();
+    } else {
+        return true;
+    }
+}
+
+void DrmClientBuffer::releaseGbm()
+{
+    // the import is shared with the cache, it goes away together with the client's buffer
+    m_released = true;
+}
+
 }
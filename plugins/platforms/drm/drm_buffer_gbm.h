@@ -23,6 +23,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "drm_buffer.h"
 
+#include <KWayland/Server/buffer_interface.h>
+
+#include <QPointer>
+
 #include <memory>
 
 struct gbm_bo;
@@ -38,13 +42,7 @@ public:
     DrmSurfaceBuffer(int fd, const std::shared_ptr<GbmSurface> &surface);
     ~DrmSurfaceBuffer();
 
-    bool needsModeChange(DrmBuffer *b) const override {
-        if (DrmSurfaceBuffer *sb = dynamic_cast<DrmSurfaceBuffer*>(b)) {
-            return hasBo() != sb->hasBo();
-        } else {
-            return true;
-        }
-    }
+    bool needsModeChange(DrmBuffer *b) const override;
 
     bool hasBo() const {
         return m_bo != nullptr;
@@ -61,6 +59,69 @@ private:
     gbm_bo *m_bo = nullptr;
 };
 
+/**
+ * @brief The framebuffer of a Wayland client's buffer imported through GBM.
+ *
+ * Shared by the cache of the imports and the DrmClientBuffers showing it, so a buffer attached
+ * again does not get imported again and the framebuffer stays until it is no longer on screen.
+ **/
+class DrmClientImport
+{
+public:
+    DrmClientImport(int fd, gbm_bo *bo);
+    ~DrmClientImport();
+
+    quint32 bufferId() const {
+        return m_bufferId;
+    }
+
+    const QSize &size() const {
+        return m_size;
+    }
+
+    uint32_t format() const {
+        return m_format;
+    }
+
+private:
+    int m_fd;
+    gbm_bo *m_bo;
+    quint32 m_bufferId = 0;
+    QSize m_size;
+    uint32_t m_format;
+};
+
+/**
+ * @brief A buffer of a Wayland client shown through direct scanout or on an overlay plane.
+ *
+ * Keeps a reference on the client's buffer, so the client does not reuse it while it is on screen.
+ * The client may still destroy the buffer, the framebuffer keeps the memory alive until it got
+ * replaced on screen.
+ **/
+class DrmClientBuffer : public DrmBuffer
+{
+public:
+    DrmClientBuffer(int fd, const std::shared_ptr<DrmClientImport> &import, KWayland::Server::BufferInterface *buffer);
+    ~DrmClientBuffer();
+
+    bool needsModeChange(DrmBuffer *b) const override;
+
+    bool hasBo() const {
+        return !m_released;
+    }
+
+    uint32_t format() const {
+        return m_import->format();
+    }
+
+    void releaseGbm() override;
+
+private:
+    QPointer<KWayland::Server::BufferInterface> m_buffer;
+    std::shared_ptr<DrmClientImport> m_import;
+    bool m_released = false;
+};
+
 }
 
 #endif
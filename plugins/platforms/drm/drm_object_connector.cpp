@@ -52,6 +52,7 @@ bool DrmConnector::initProps()
 {
     setPropertyNames( {
         QByteArrayLiteral("CRTC_ID"),
+        QByteArrayLiteral("vrr_capable"),
     });
 
     drmModeObjectProperties *properties = drmModeObjectGetProperties(fd(), m_id, DRM_MODE_OBJECT_CONNECTOR);
@@ -68,6 +69,22 @@ bool DrmConnector::initProps()
     return true;
 }
 
+bool DrmConnector::isVrrCapable() const
+{
+    auto property = m_props.at(int(PropertyIndex::VrrCapable));
+    return property && property->value() != 0;
+}
+
+bool DrmConnector::atomicPopulate(drmModeAtomicReq *req)
+{
+    // vrr_capable is immutable, the kernel rejects commits containing it
+    auto property = m_props.at(int(PropertyIndex::CrtcId));
+    if (!property) {
+        return true;
+    }
+    return atomicAddProperty(req, property);
+}
+
 bool DrmConnector::isConnected()
 {
     ScopedDrmPointer<_drmModeConnector, &drmModeFreeConnector> con(drmModeGetConnector(fd(), m_id));
@@ -36,6 +36,7 @@ public:
 
     enum class PropertyIndex {
         CrtcId = 0,
+        VrrCapable,
         Count
     };
 
@@ -45,6 +46,12 @@ public:
     
     bool initProps();
     bool isConnected();
+    /**
+     * Whether the connected display supports a variable refresh rate, e.g. Adaptive-Sync.
+     **/
+    bool isVrrCapable() const;
+
+    bool atomicPopulate(drmModeAtomicReq *req) override;
 
 
 private:
@@ -57,6 +57,7 @@ bool DrmCrtc::initProps()
     setPropertyNames({
         QByteArrayLiteral("MODE_ID"),
         QByteArrayLiteral("ACTIVE"),
+        QByteArrayLiteral("VRR_ENABLED"),
     });
 
     drmModeObjectProperties *properties = drmModeObjectGetProperties(fd(), m_id, DRM_MODE_OBJECT_CRTC);
@@ -73,6 +74,15 @@ bool DrmCrtc::initProps()
     return true;
 }
 
+bool DrmCrtc::atomicPopulateVrr(drmModeAtomicReq *req)
+{
+    auto property = m_props.at(int(PropertyIndex::VrrEnabled));
+    if (!property) {
+        return false;
+    }
+    return atomicAddProperty(req, property);
+}
+
 void DrmCrtc::flipBuffer()
 {
     if (m_currentBuffer && m_backend->deleteBufferAfterPageFlip() && m_currentBuffer != m_nextBuffer) {
@@ -45,6 +45,7 @@ public:
     enum class PropertyIndex {
         ModeId = 0,
         Active,
+        VrrEnabled,
         Count
     };
     
@@ -67,6 +68,14 @@ public:
     void flipBuffer();
     bool blank();
 
+    bool supportsVrr() const {
+        return m_props.at(int(PropertyIndex::VrrEnabled)) != nullptr;
+    }
+    /**
+     * Adds only the VRR_ENABLED property to @p req, toggling it does not need a modeset.
+     **/
+    bool atomicPopulateVrr(drmModeAtomicReq *req);
+
     int getGammaRampSize() const {
         return m_gammaRampSize;
     }
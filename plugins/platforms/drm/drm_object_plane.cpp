@@ -74,7 +74,8 @@ bool DrmPlane::initProps()
         QByteArrayLiteral("CRTC_H"),
         QByteArrayLiteral("FB_ID"),
         QByteArrayLiteral("CRTC_ID"),
-        QByteArrayLiteral("rotation")
+        QByteArrayLiteral("rotation"),
+        QByteArrayLiteral("zpos")
     });
 
     QVector<QByteArray> typeNames = {
@@ -164,13 +165,44 @@ DrmPlane::Transformations DrmPlane::transformation()
     return Transformations(Transformation::Rotate0);
 }
 
+void DrmPlane::setGeometry(uint32_t crtcId, const QSize &bufferSize, const QRect &geometry)
+{
+    // source coordinates are 16.16 fixed point
+    setValue(int(PropertyIndex::SrcX), 0);
+    setValue(int(PropertyIndex::SrcY), 0);
+    setValue(int(PropertyIndex::SrcW), bufferSize.width() << 16);
+    setValue(int(PropertyIndex::SrcH), bufferSize.height() << 16);
+    setValue(int(PropertyIndex::CrtcX), geometry.x());
+    setValue(int(PropertyIndex::CrtcY), geometry.y());
+    setValue(int(PropertyIndex::CrtcW), geometry.width());
+    setValue(int(PropertyIndex::CrtcH), geometry.height());
+    setValue(int(PropertyIndex::CrtcId), crtcId);
+}
+
+void DrmPlane::disable()
+{
+    setNext(nullptr);
+    setGeometry(0, QSize(0, 0), QRect(0, 0, 0, 0));
+}
+
+bool DrmPlane::isAbove(DrmPlane *other)
+{
+    auto zpos = m_props.at(int(PropertyIndex::Zpos));
+    auto otherZpos = other->m_props.at(int(PropertyIndex::Zpos));
+    if (!zpos || !otherZpos) {
+        return type() == TypeIndex::Overlay && other->type() == TypeIndex::Primary;
+    }
+    return zpos->value() > otherZpos->value();
+}
+
 bool DrmPlane::atomicPopulate(drmModeAtomicReq *req)
 {
     bool ret = true;
 
     for (int i = 1; i < m_props.size(); i++) {
         auto property = m_props.at(i);
-        if (!property) {
+        // the stacking order is left as it is, zpos might be immutable
+        if (!property || i == int(PropertyIndex::Zpos)) {
             continue;
         }
         ret &= atomicAddProperty(req, property);
@@ -21,6 +21,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define KWIN_DRM_OBJECT_PLANE_H
 
 #include "drm_object.h"
+
+#include <QRect>
 // drm
 #include <xf86drmMode.h>
 
@@ -49,6 +51,7 @@ public:
         FbId,
         CrtcId,
         Rotation,
+        Zpos,
         Count
     };
 
@@ -92,6 +95,19 @@ public:
     void setNext(DrmBuffer *b);
     void setTransformation(Transformations t);
     Transformations transformation();
+    /**
+     * Shows the whole buffer set with setNext at @p geometry on the CRTC @p crtcId.
+     **/
+    void setGeometry(uint32_t crtcId, const QSize &bufferSize, const QRect &geometry);
+    /**
+     * Unsets the buffer and the CRTC, so that the plane gets disabled with the next commit.
+     **/
+    void disable();
+    /**
+     * Whether the plane is shown above @p other. Without a zpos property the
+     * overlay planes are above the primary plane.
+     **/
+    bool isAbove(DrmPlane *other);
 
     bool atomicPopulate(drmModeAtomicReq *req);
     void flipBuffer();
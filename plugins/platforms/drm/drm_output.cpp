@@ -23,6 +23,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "drm_object_crtc.h"
 #include "drm_object_connector.h"
 
+#include <algorithm>
 #include <errno.h>
 
 #include "composite.h"
@@ -31,6 +32,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "main.h"
 #include "orientation_sensor.h"
 #include "screens_drm.h"
+#include "vblankclock.h"
 #include "wayland_server.h"
 // KWayland
 #include <KWayland/Server/display.h>
@@ -84,10 +86,20 @@ void DrmOutput::teardown()
         }
         m_primaryPlane->setCurrent(nullptr);
     }
+    for (DrmPlane *p : qAsConst(m_overlayPlanes)) {
+        p->setOutput(nullptr);
+        if (m_backend->deleteBufferAfterPageFlip()) {
+            delete p->current();
+        }
+        p->setCurrent(nullptr);
+        p->disable();
+    }
+    m_overlayPlanes.clear();
 
     m_crtc->setOutput(nullptr);
     m_conn->setOutput(nullptr);
 
+    dropQueuedBuffer();
     delete m_cursor[0];
     delete m_cursor[1];
     if (!m_pageFlipPending) {
@@ -108,6 +120,8 @@ void DrmOutput::releaseGbm()
 
 bool DrmOutput::hideCursor()
 {
+    // whoever takes over might move the cursor, so the next move must reach the crtc
+    m_cursorPosValid = false;
     return drmModeSetCursor(m_backend->fd(), m_crtc->id(), 0, 0, 0) == 0;
 }
 
@@ -158,6 +172,9 @@ void DrmOutput::updateCursor()
 
 void DrmOutput::moveCursor(const QPoint &globalPos)
 {
+    if (!m_cursor[m_cursorIndex]) {
+        return;
+    }
     QMatrix4x4 matrix;
     QMatrix4x4 hotspotMatrix;
     if (orientation() == Qt::InvertedLandscapeOrientation) {
@@ -174,7 +191,18 @@ void DrmOutput::moveCursor(const QPoint &globalPos)
     const auto outputGlobalPos = AbstractOutput::globalPos();
     matrix.translate(-outputGlobalPos.x(), -outputGlobalPos.y());
     const QPoint p = matrix.map(globalPos) - hotspotMatrix.map(m_backend->softwareCursorHotspot());
-    drmModeMoveCursor(m_backend->fd(), m_crtc->id(), p.x(), p.y());
+    // every output gets every pointer motion, only bother the crtc the cursor is or was on
+    const bool onOutput = QRect(p, m_cursor[m_cursorIndex]->size()).intersects(QRect(0, 0, m_mode.hdisplay, m_mode.vdisplay));
+    if (m_cursorPosValid && (p == m_cursorPos || (!onOutput && !m_cursorOnOutput))) {
+        return;
+    }
+    if (drmModeMoveCursor(m_backend->fd(), m_crtc->id(), p.x(), p.y()) != 0) {
+        m_cursorPosValid = false;
+        return;
+    }
+    m_cursorPos = p;
+    m_cursorOnOutput = onOutput;
+    m_cursorPosValid = true;
 }
 
 QSize DrmOutput::pixelSize() const
@@ -284,6 +312,7 @@ bool DrmOutput::init(drmModeConnector *connector)
         if (!initPrimaryPlane()) {
             return false;
         }
+        initOverlayPlanes();
     } else if (!m_crtc->blank()) {
         return false;
     }
@@ -313,6 +342,7 @@ bool DrmOutput::init(drmModeConnector *connector)
     setRawPhysicalSize(physicalSize);
 
     initOutputDevice(connector);
+    vblankClock()->setRefreshRate(refreshRateForMode(&m_mode));
 
     setEnabled(true);
     return true;
@@ -626,6 +656,22 @@ void DrmOutput::initEdid(drmModeConnector *connector)
     m_edid.physicalSize = extractPhysicalSize(edid.data());
 }
 
+bool DrmOutput::isVrrCapable() const
+{
+    if (!m_backend->atomicModeSetting() || qEnvironmentVariableIsSet("KWIN_DRM_NO_VRR")) {
+        return false;
+    }
+    return m_conn->isVrrCapable() && m_crtc->supportsVrr();
+}
+
+void DrmOutput::setVrrEnabled(bool enabled)
+{
+    if (!enabled) {
+        m_vrrFailed = false;
+    }
+    m_vrrRequested = enabled && !m_vrrFailed && isVrrCapable();
+}
+
 bool DrmOutput::initPrimaryPlane()
 {
     for (int i = 0; i < m_backend->planes().size(); ++i) {
@@ -681,6 +727,37 @@ bool DrmOutput::initCursorPlane()       // TODO: Add call in init (but needs lay
     return false;
 }
 
+void DrmOutput::initOverlayPlanes()
+{
+    if (qEnvironmentVariableIsSet("KWIN_DRM_NO_OVERLAYS")) {
+        return;
+    }
+    // leave planes which can be used on multiple CRTCs for the other outputs
+    const int maxOverlayPlanes = 2;
+    for (int i = 0; i < m_backend->planes().size() && m_overlayPlanes.size() < maxOverlayPlanes; ++i) {
+        DrmPlane* p = m_backend->planes()[i];
+        if (!p) {
+            continue;
+        }
+        if (p->type() != DrmPlane::TypeIndex::Overlay) {
+            continue;
+        }
+        if (p->output()) {     // Plane already has an output
+            continue;
+        }
+        if (!p->isCrtcSupported(m_crtc->resIndex())) {
+            continue;
+        }
+        // client surfaces are shown on top of the composited frame
+        if (!p->isAbove(m_primaryPlane)) {
+            continue;
+        }
+        p->setOutput(this);
+        m_overlayPlanes << p;
+        qCDebug(KWIN_DRM) << "Initialized overlay plane" << p->id() << "on CRTC" << m_crtc->id();
+    }
+}
+
 void DrmOutput::initDpms(drmModeConnector *connector)
 {
     for (int i = 0; i < connector->count_props; ++i) {
@@ -712,7 +789,7 @@ void DrmOutput::setDpms(DrmOutput::DpmsMode mode)
         if (mode == DpmsMode::On) {
             if (m_pageFlipPending) {
                 m_pageFlipPending = false;
-                Compositor::self()->bufferSwapComplete();
+                Compositor::self()->bufferSwapComplete(this);
             }
             dpmsOnHandler();
         } else {
@@ -901,6 +978,7 @@ void DrmOutput::updateMode(int modeIndex)
     }
     m_mode = connector->modes[modeIndex];
     m_modesetRequested = true;
+    vblankClock()->setRefreshRate(refreshRateForMode(&m_mode));
     emit modeChanged();
 }
 
@@ -919,7 +997,9 @@ void DrmOutput::pageFlipped()
     // TODO: split up DrmOutput in two for dumb and egl/gbm surface buffer compatible subclasses completely?
     if (m_backend->deleteBufferAfterPageFlip()) {
         if (m_backend->atomicModeSetting()) {
-            if (!m_primaryPlane->next()) {
+            // commits of overlays only keep the buffer of the primary plane
+            const bool primaryFlipped = m_nextPlanesFlipList.contains(m_primaryPlane);
+            if (primaryFlipped ? !m_primaryPlane->next() : m_nextPlanesFlipList.isEmpty()) {
                 // on manual vt switch
                 // TODO: when we later use overlay planes it might happen, that we have a page flip with only
                 //       damage on one of these, and therefore the primary plane has no next buffer
@@ -953,10 +1033,23 @@ void DrmOutput::pageFlipped()
         }
         m_crtc->flipBuffer();
     }
+#if HAVE_GBM
+    DrmBuffer *current = m_backend->atomicModeSetting() ? m_primaryPlane->current() : m_crtc->current();
+    setDirectScanout(dynamic_cast<DrmClientBuffer*>(current) != nullptr);
+#endif
 }
 
 bool DrmOutput::present(DrmBuffer *buffer)
 {
+    const bool flipPending = m_backend->atomicModeSetting() ? m_pageFlipPending : m_crtc->next() != nullptr;
+    if (flipPending) {
+        // the Compositor only renders ahead if the backend allows it
+        if (m_queuedBuffer || m_backend->frameQueueDepth() < 2 || !LogindIntegration::self()->isActiveSession()) {
+            return false;
+        }
+        m_queuedBuffer = buffer;
+        return true;
+    }
     if (m_backend->atomicModeSetting()) {
         return presentAtomically(buffer);
     } else {
@@ -964,6 +1057,33 @@ bool DrmOutput::present(DrmBuffer *buffer)
     }
 }
 
+bool DrmOutput::presentQueuedBuffer()
+{
+    DrmBuffer *buffer = m_queuedBuffer;
+    m_queuedBuffer = nullptr;
+    if (m_deleted || m_dpmsAtomicOffPending || m_dpmsModePending != DpmsMode::On) {
+        delete buffer;
+        return false;
+    }
+    const bool ok = m_backend->atomicModeSetting() ? presentAtomically(buffer) : presentLegacy(buffer);
+    if (!ok) {
+        delete buffer;
+    }
+    return ok;
+}
+
+bool DrmOutput::dropQueuedBuffer()
+{
+    if (!m_queuedBuffer) {
+        return false;
+    }
+    // either the buffer of a GBM surface or a directly scanned out DrmClientBuffer, which
+    // releases its reference on the client's buffer while the import stays cached
+    delete m_queuedBuffer;
+    m_queuedBuffer = nullptr;
+    return true;
+}
+
 bool DrmOutput::dpmsAtomicOff()
 {
     m_dpmsAtomicOffPending = false;
@@ -1002,14 +1122,17 @@ bool DrmOutput::presentAtomically(DrmBuffer *buffer)
 
     m_primaryPlane->setNext(buffer);
     m_nextPlanesFlipList << m_primaryPlane;
+    addOverlaysToFlipList();
 
     if (!doAtomicCommit(AtomicCommitMode::Test)) {
         //TODO: When we use planes for layered rendering, fallback to renderer instead. Also for direct scanout?
         //TODO: Probably should undo setNext and reset the flip list
         qCDebug(KWIN_DRM) << "Atomic test commit failed. Aborting present.";
+        m_overlayTests.clear();
         // go back to previous state
         if (m_lastWorkingState.valid) {
             m_mode = m_lastWorkingState.mode;
+            vblankClock()->setRefreshRate(refreshRateForMode(&m_mode));
             setOrientation(m_lastWorkingState.orientation);
             setGlobalPos(m_lastWorkingState.globalPos);
             if (m_primaryPlane) {
@@ -1029,9 +1152,11 @@ bool DrmOutput::presentAtomically(DrmBuffer *buffer)
     if (!doAtomicCommit(AtomicCommitMode::Real)) {
         qCDebug(KWIN_DRM) << "Atomic commit failed. This should have never happened! Aborting present.";
         //TODO: Probably should undo setNext and reset the flip list
+        m_overlayTests.clear();
         return false;
     }
     if (wasModeset) {
+        m_overlayTests.clear();
         // store current mode set as new good state
         m_lastWorkingState.mode = m_mode;
         m_lastWorkingState.orientation = orientation();
@@ -1045,6 +1170,109 @@ bool DrmOutput::presentAtomically(DrmBuffer *buffer)
     return true;
 }
 
+void DrmOutput::clearOverlays()
+{
+    // the buffers are on their way to the screen
+    if (m_pageFlipPending) {
+        return;
+    }
+    for (DrmPlane *p : qAsConst(m_overlayPlanes)) {
+        if (m_backend->deleteBufferAfterPageFlip()) {
+            delete p->next();
+        }
+        p->disable();
+    }
+    m_assignedOverlays.clear();
+}
+
+bool DrmOutput::assignOverlay(DrmBuffer *buffer, uint32_t format, const QRect &geometry)
+{
+    if (m_pageFlipPending || m_modesetRequested || m_dpmsModePending != DpmsMode::On || !m_primaryPlane->current()) {
+        return false;
+    }
+    auto it = std::find_if(m_overlayPlanes.constBegin(), m_overlayPlanes.constEnd(),
+        [format] (DrmPlane *p) {
+            return !p->next() && p->formats().contains(format);
+        }
+    );
+    if (it == m_overlayPlanes.constEnd()) {
+        return false;
+    }
+    DrmPlane *p = *it;
+    p->setNext(buffer);
+    p->setGeometry(m_crtc->id(), buffer->size(), geometry);
+    m_assignedOverlays << OverlayState{p, buffer->bufferId(), geometry};
+    if (!testOverlays()) {
+        p->disable();
+        m_assignedOverlays.removeLast();
+        return false;
+    }
+    return true;
+}
+
+bool DrmOutput::testOverlays()
+{
+    // the primary plane keeps what it shows now
+    const quint32 primaryBufferId = m_primaryPlane->current()->bufferId();
+    for (const OverlayTest &test : qAsConst(m_overlayTests)) {
+        if (test.primaryBufferId == primaryBufferId && test.overlays == m_assignedOverlays) {
+            return test.passed;
+        }
+    }
+
+    drmModeAtomicReq *req = drmModeAtomicAlloc();
+    if (!req) {
+        return false;
+    }
+    m_primaryPlane->setValue(int(DrmPlane::PropertyIndex::FbId), primaryBufferId);
+    bool ret = m_primaryPlane->atomicPopulate(req);
+    for (DrmPlane *p : qAsConst(m_overlayPlanes)) {
+        ret &= p->atomicPopulate(req);
+    }
+    ret = ret && drmModeAtomicCommit(m_backend->fd(), req, DRM_MODE_ATOMIC_TEST_ONLY, this) == 0;
+    drmModeAtomicFree(req);
+
+    // enough for every step of assigning all overlay planes in the last frames
+    const int maxOverlayTests = 2 * m_overlayPlanes.count() + 2;
+    m_overlayTests.prepend({primaryBufferId, m_assignedOverlays, ret});
+    if (m_overlayTests.count() > maxOverlayTests) {
+        m_overlayTests.removeLast();
+    }
+    return ret;
+}
+
+void DrmOutput::addOverlaysToFlipList()
+{
+    for (DrmPlane *p : qAsConst(m_overlayPlanes)) {
+        // planes showing a buffer are disabled if they did not get a new one
+        if (p->next() || p->current()) {
+            m_nextPlanesFlipList << p;
+        }
+    }
+}
+
+bool DrmOutput::presentOverlays()
+{
+    if (!m_backend->atomicModeSetting() || m_pageFlipPending || m_modesetRequested || !m_primaryPlane->current()) {
+        return false;
+    }
+    if (!LogindIntegration::self()->isActiveSession()) {
+        return false;
+    }
+    addOverlaysToFlipList();
+    if (m_nextPlanesFlipList.isEmpty()) {
+        return false;
+    }
+    m_primaryPlane->setValue(int(DrmPlane::PropertyIndex::FbId), m_primaryPlane->current()->bufferId());
+    if (!doAtomicCommit(AtomicCommitMode::Real)) {
+        // a framebuffer id got reused or the hardware state changed since the test
+        m_overlayTests.clear();
+        return false;
+    }
+    m_pageFlipPending = true;
+    return true;
+}
+
 bool DrmOutput::presentLegacy(DrmBuffer *buffer)
 {
     if (m_crtc->next()) {
@@ -1088,10 +1316,21 @@ bool DrmOutput::doAtomicCommit(AtomicCommitMode mode)
 {
     drmModeAtomicReq *req = drmModeAtomicAlloc();
 
-    auto errorHandler = [this, mode, req] () {
+    const bool vrrChanged = m_vrrRequested != m_vrrEnabled;
+    if (vrrChanged) {
+        m_crtc->setValue(int(DrmCrtc::PropertyIndex::VrrEnabled), m_vrrRequested);
+    }
+
+    auto errorHandler = [this, mode, req, vrrChanged] () {
         if (mode == AtomicCommitMode::Test) {
             // TODO: when we later test overlay planes, make sure we change only the right stuff back
         }
+        if (vrrChanged) {
+            // don't try again until the Compositor disables it or the mode changes
+            m_crtc->setValue(int(DrmCrtc::PropertyIndex::VrrEnabled), m_vrrEnabled);
+            m_vrrFailed = m_vrrRequested;
+            m_vrrRequested = m_vrrEnabled;
+        }
         if (req) {
             drmModeAtomicFree(req);
         }
@@ -1106,7 +1345,15 @@ bool DrmOutput::doAtomicCommit(AtomicCommitMode mode)
 
         // TODO: see above, rework later for overlay planes!
         for (DrmPlane *p : m_nextPlanesFlipList) {
-            p->setNext(nullptr);
+            if (p == m_primaryPlane) {
+                // the buffer is deleted by the caller
+                p->setNext(nullptr);
+                continue;
+            }
+            if (m_backend->deleteBufferAfterPageFlip()) {
+                delete p->next();
+            }
+            p->disable();
         }
         m_nextPlanesFlipList.clear();
 
@@ -1156,6 +1403,11 @@ bool DrmOutput::doAtomicCommit(AtomicCommitMode mode)
         ret &= p->atomicPopulate(req);
     }
 
+    if (vrrChanged && !(flags & DRM_MODE_ATOMIC_ALLOW_MODESET)) {
+        // a modeset populates all properties of the crtc anyway
+        ret &= m_crtc->atomicPopulateVrr(req);
+    }
+
     if (!ret) {
         qCWarning(KWIN_DRM) << "Failed to populate atomic planes. Abort atomic commit!";
         errorHandler();
@@ -1163,6 +1415,19 @@ bool DrmOutput::doAtomicCommit(AtomicCommitMode mode)
     }
 
     if (drmModeAtomicCommit(m_backend->fd(), req, flags, this)) {
+        if (mode == AtomicCommitMode::Test && vrrChanged) {
+            // the driver might just refuse the refresh rate, so the frame is tested again without it
+            qCDebug(KWIN_DRM) << "Atomic test commit with variable refresh rate"
+                              << (m_vrrRequested ? "enabled" : "disabled") << "failed on" << name();
+            m_crtc->setValue(int(DrmCrtc::PropertyIndex::VrrEnabled), m_vrrEnabled);
+            m_vrrFailed = m_vrrRequested;
+            m_vrrRequested = m_vrrEnabled;
+            if ((flags & DRM_MODE_ATOMIC_ALLOW_MODESET) && m_dpmsModePending == DpmsMode::On) {
+                drmModeDestroyPropertyBlob(m_backend->fd(), m_blobId);
+            }
+            drmModeAtomicFree(req);
+            return doAtomicCommit(mode);
+        }
         qCWarning(KWIN_DRM) << "Atomic request failed to commit:" << strerror(errno);
         errorHandler();
         return false;
@@ -1172,6 +1437,12 @@ bool DrmOutput::doAtomicCommit(AtomicCommitMode mode)
         qCDebug(KWIN_DRM) << "Atomic Modeset successful.";
         m_modesetRequested = false;
         m_dpmsMode = m_dpmsModePending;
+        // the new mode might support a variable refresh rate
+        m_vrrFailed = false;
+    }
+    if (mode == AtomicCommitMode::Real && vrrChanged) {
+        qCDebug(KWIN_DRM) << "Variable refresh rate" << (m_vrrRequested ? "enabled" : "disabled") << "on" << name();
+        m_vrrEnabled = m_vrrRequested;
     }
 
     drmModeAtomicFree(req);
@@ -1211,6 +1482,17 @@ bool DrmOutput::atomicReqModesetPopulate(drmModeAtomicReq *req, bool enable)
     bool ret = true;
     ret &= m_conn->atomicPopulate(req);
     ret &= m_crtc->atomicPopulate(req);
+    if (!enable) {
+        for (DrmPlane *p : qAsConst(m_overlayPlanes)) {
+            if (m_backend->deleteBufferAfterPageFlip()) {
+                delete p->current();
+                delete p->next();
+            }
+            p->setCurrent(nullptr);
+            p->disable();
+            ret &= p->atomicPopulate(req);
+        }
+    }
 
     return ret;
 }
@@ -64,9 +64,30 @@ public:
     void updateCursor();
     void moveCursor(const QPoint &globalPos);
     bool init(drmModeConnector *connector);
+    /**
+     * Shows @p buffer with the next page flip. If a page flip is pending already and the
+     * backend allows a frame queue, @p buffer waits for it and is presented with
+     * presentQueuedBuffer.
+     **/
     bool present(DrmBuffer *buffer);
     void pageFlipped();
 
+    /**
+     * Disables the overlay planes assigned since the last commit again.
+     **/
+    void clearOverlays();
+    /**
+     * Tries to show @p buffer of @p format on a free overlay plane at @p geometry, in pixels of
+     * the output, together with the overlays assigned before. This is verified with a test-only
+     * commit, unless the same buffers were assigned in the same way in one of the last frames.
+     * On success the output takes the ownership of @p buffer and shows it with the next commit.
+     **/
+    bool assignOverlay(DrmBuffer *buffer, uint32_t format, const QRect &geometry);
+    /**
+     * Commits the assigned overlays while the primary plane keeps its buffer.
+     **/
+    bool presentOverlays();
+
     /**
      * Enable or disable the output.
      * This differs from setDpms as it also
@@ -79,6 +100,12 @@ public:
 
     QSize pixelSize() const override;
 
+    bool isVrrCapable() const override;
+    void setVrrEnabled(bool enabled) override;
+    bool isVrrEnabled() const override {
+        return m_vrrEnabled;
+    }
+
     int currentRefreshRate() const;
     // These values are defined by the kernel
     enum class DpmsMode {
@@ -112,6 +139,8 @@ private:
     DrmOutput(DrmBackend *backend);
 
     bool presentAtomically(DrmBuffer *buffer);
+    bool presentQueuedBuffer();
+    bool dropQueuedBuffer();
 
     enum class AtomicCommitMode {
         Test,
@@ -130,6 +159,9 @@ private:
     void initOutput();
     bool initPrimaryPlane();
     bool initCursorPlane();
+    void initOverlayPlanes();
+    bool testOverlays();
+    void addOverlaysToFlipList();
 
     void dpmsOnHandler();
     void dpmsOffHandler();
@@ -157,10 +189,35 @@ private:
     uint32_t m_blobId = 0;
     DrmPlane* m_primaryPlane = nullptr;
     DrmPlane* m_cursorPlane = nullptr;
+    QVector<DrmPlane*> m_overlayPlanes;
+    struct OverlayState {
+        DrmPlane *plane;
+        quint32 bufferId;
+        QRect geometry;
+        bool operator==(const OverlayState &other) const {
+            return plane == other.plane && bufferId == other.bufferId && geometry == other.geometry;
+        }
+    };
+    struct OverlayTest {
+        quint32 primaryBufferId;
+        QVector<OverlayState> overlays;
+        bool passed;
+    };
+    // the overlays assigned since the last commit
+    QVector<OverlayState> m_assignedOverlays;
+    // results of the last test commits, the same assignment as in a previous frame is not tested again
+    QVector<OverlayTest> m_overlayTests;
     QVector<DrmPlane*> m_nextPlanesFlipList;
     bool m_pageFlipPending = false;
+    // rendered while the page flip was pending, presented once it happened
+    DrmBuffer *m_queuedBuffer = nullptr;
     bool m_dpmsAtomicOffPending = false;
     bool m_modesetRequested = true;
+    // VRR_ENABLED as committed and as it should be with the next commit
+    bool m_vrrEnabled = false;
+    bool m_vrrRequested = false;
+    // enabling VRR got refused, it's not requested again until it is disabled or the mode changes
+    bool m_vrrFailed = false;
 
     struct {
         Qt::ScreenOrientation orientation;
@@ -172,6 +229,10 @@ private:
     DrmDumbBuffer *m_cursor[2] = {nullptr, nullptr};
     int m_cursorIndex = 0;
     bool m_hasNewCursor = false;
+    // last position passed to drmModeMoveCursor, in crtc coordinates
+    QPoint m_cursorPos;
+    bool m_cursorOnOutput = false;
+    bool m_cursorPosValid = false;
     bool m_internal = false;
     bool m_deleted = false;
 };
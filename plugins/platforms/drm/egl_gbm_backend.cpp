@@ -25,9 +25,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "gbm_surface.h"
 #include "logging.h"
 #include "options.h"
+#include "scene.h"
 #include "screens.h"
 // kwin libs
 #include <kwinglplatform.h>
+// KWayland
+#include <KWayland/Server/buffer_interface.h>
+#include <KWayland/Server/surface_interface.h>
 // Qt
 #include <QOpenGLContext>
 // system
@@ -39,6 +43,7 @@ namespace KWin
 EglGbmBackend::EglGbmBackend(DrmBackend *b)
     : AbstractEglBackend()
     , m_backend(b)
+    , m_directScanout(!qEnvironmentVariableIsSet("KWIN_DRM_NO_DIRECT_SCANOUT"))
 {
     // Egl is always direct rendering
     setIsDirectRendering(true);
@@ -71,6 +76,8 @@ void EglGbmBackend::cleanupSurfaces()
         cleanupOutput(*it);
     }
     m_outputs.clear();
+    // the buffers still on screen keep their imports
+    m_imports.clear();
 }
 
 void EglGbmBackend::cleanupOutput(const Output &o)
@@ -129,6 +136,7 @@ void EglGbmBackend::init()
 
     initKWinGL();
     initBufferAge();
+    initSwapBuffersWithDamage();
     initWayland();
     initRemotePresent();
 }
@@ -299,13 +307,18 @@ void EglGbmBackend::present()
 {
     for (auto &o: m_outputs) {
         makeContextCurrent(o);
-        presentOnOutput(o);
+        presentOnOutput(o, QRegion());
     }
 }
 
-void EglGbmBackend::presentOnOutput(EglGbmBackend::Output &o)
+void EglGbmBackend::presentOnOutput(EglGbmBackend::Output &o, const QRegion &damage)
 {
-    eglSwapBuffers(eglDisplay(), o.eglSurface);
+    // the damage is only known in compositor coordinates for outputs the scene does not rotate
+    if (o.output->orientation() == Qt::PrimaryOrientation) {
+        swapBuffers(o.eglSurface, damage, o.output->geometry(), o.output->scale());
+    } else {
+        eglSwapBuffers(eglDisplay(), o.eglSurface);
+    }
     o.buffer = m_backend->createBuffer(o.gbmSurface);
     if(m_remoteaccessManager && gbm_surface_has_free_buffers(o.gbmSurface->surface())) {
         // GBM surface is released on page flip so
@@ -342,19 +355,96 @@ QRegion EglGbmBackend::prepareRenderingForScreen(int screenId)
     const Output &o = m_outputs.at(screenId);
     makeContextCurrent(o);
     if (supportsBufferAge()) {
-        QRegion region;
+        return o.damageJournal.accumulate(o.bufferAge, o.output->geometry());
+    }
+    return QRegion();
+}
 
-        // Note: An age of zero means the buffer contents are undefined
-        if (o.bufferAge > 0 && o.bufferAge <= o.damageHistory.count()) {
-            for (int i = 0; i < o.bufferAge - 1; i++)
-                region |= o.damageHistory[i];
-        } else {
-            region = o.output->geometry();
+DrmClientBuffer *EglGbmBackend::importBuffer(KWayland::Server::BufferInterface *buffer)
+{
+    if (!buffer || !buffer->resource()) {
+        return nullptr;
+    }
+    auto it = m_imports.constFind(buffer);
+    if (it == m_imports.constEnd()) {
+        std::shared_ptr<DrmClientImport> import;
+        if (gbm_bo *bo = gbm_bo_import(m_backend->gbmDevice(), GBM_BO_IMPORT_WL_BUFFER, buffer->resource(), GBM_BO_USE_SCANOUT)) {
+            const uint32_t format = gbm_bo_get_format(bo);
+            if (format != GBM_FORMAT_XRGB8888 && format != GBM_FORMAT_ARGB8888) {
+                gbm_bo_destroy(bo);
+            } else {
+                import = std::make_shared<DrmClientImport>(m_backend->fd(), bo);
+                if (import->bufferId() == 0) {
+                    import.reset();
+                }
+            }
         }
+        // a client attaches the buffers of its swapchain over and over again
+        it = m_imports.insert(buffer, import);
+        connect(buffer, &KWayland::Server::BufferInterface::aboutToBeDestroyed, this,
+            [this] (KWayland::Server::BufferInterface *destroyed) {
+                m_imports.remove(destroyed);
+            }
+        );
+    }
+    if (!it.value()) {
+        return nullptr;
+    }
+    return m_backend->createBuffer(it.value(), buffer);
+}
 
-        return region;
+bool EglGbmBackend::directScanout(int screenId, KWayland::Server::SurfaceInterface *surface)
+{
+    // remote access only gets the buffers of the GBM surface
+    if (!m_directScanout || (m_remoteaccessManager && m_remoteaccessManager->isBound())) {
+        return false;
     }
-    return QRegion();
+    Output &o = m_outputs[screenId];
+    o.output->clearOverlays();
+    DrmClientBuffer *buffer = importBuffer(surface->buffer());
+    if (!buffer) {
+        return false;
+    }
+    if (buffer->size() != o.output->pixelSize()) {
+        delete buffer;
+        return false;
+    }
+    // on failure the buffer got deleted and the frame is composited as usual
+    if (!m_backend->present(buffer, o.output)) {
+        return false;
+    }
+    // the buffers of the GBM surface do not know what happened on screen meanwhile
+    o.damageJournal.clear();
+    return true;
+}
+
+QVector<OverlayCandidate> EglGbmBackend::assignOverlays(int screenId, const QVector<OverlayCandidate> &candidates)
+{
+    QVector<OverlayCandidate> assigned;
+    DrmOutput *output = m_outputs.at(screenId).output;
+    output->clearOverlays();
+    if (!m_directScanout || (m_remoteaccessManager && m_remoteaccessManager->isBound())) {
+        return assigned;
+    }
+    for (const OverlayCandidate &candidate : candidates) {
+        DrmClientBuffer *buffer = importBuffer(candidate.surface->buffer());
+        if (!buffer) {
+            continue;
+        }
+        // the scene only offers surfaces on unscaled and unrotated outputs
+        const QRect geometry = candidate.geometry.translated(-output->geometry().topLeft());
+        if (buffer->size() == geometry.size() && output->assignOverlay(buffer, buffer->format(), geometry)) {
+            assigned << candidate;
+        } else {
+            delete buffer;
+        }
+    }
+    return assigned;
+}
+
+bool EglGbmBackend::presentOverlays(int screenId)
+{
+    return m_backend->presentOverlays(m_outputs.at(screenId).output);
 }
 
 void EglGbmBackend::endRenderingFrame(const QRegion &renderedRegion, const QRegion &damagedRegion)
@@ -366,7 +456,8 @@ void EglGbmBackend::endRenderingFrame(const QRegion &renderedRegion, const QRegi
 void EglGbmBackend::endRenderingFrameForScreen(int screenId, const QRegion &renderedRegion, const QRegion &damagedRegion)
 {
     Output &o = m_outputs[screenId];
-    if (damagedRegion.intersected(o.output->geometry()).isEmpty() && screenId == 0) {
+    const QRegion damage = damagedRegion.intersected(o.output->geometry());
+    if (damage.isEmpty()) {
 
         // If the damaged region of a window is fully occluded, the only
         // rendering done, if any, will have been to repair a reused back
@@ -378,27 +469,14 @@ void EglGbmBackend::endRenderingFrameForScreen(int screenId, const QRegion &rend
         if (!renderedRegion.intersected(o.output->geometry()).isEmpty())
             glFlush();
 
-        for (auto &o: m_outputs) {
-            o.bufferAge = 1;
-        }
+        o.bufferAge = 1;
         return;
     }
-    presentOnOutput(o);
+    presentOnOutput(o, damage);
 
     // Save the damaged region to history
-    // Note: damage history is only collected for the first screen. For any other screen full repaints
-    // are triggered. This is due to a limitation in Scene::paintGenericScreen which resets the Toplevel's
-    // repaint. So multiple calls to Scene::paintScreen as it's done in multi-output rendering only
-    // have correct damage information for the first screen. If we try to track damage nevertheless,
-    // it creates artifacts. So for the time being we work around the problem by only supporting buffer
-    // age on the first output. To properly support buffer age on all outputs the rendering needs to
-    // be refactored in general.
-    if (supportsBufferAge() && screenId == 0) {
-        if (o.damageHistory.count() > 10) {
-            o.damageHistory.removeLast();
-        }
-
-        o.damageHistory.prepend(damagedRegion.intersected(o.output->geometry()));
+    if (supportsBufferAge()) {
+        o.damageJournal.add(damage);
     }
 }
 
@@ -22,6 +22,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "abstract_egl_backend.h"
 #include "remoteaccess_manager.h"
 
+#include <QHash>
+
 #include <memory>
 
 struct gbm_surface;
@@ -30,6 +32,8 @@ namespace KWin
 {
 class DrmBackend;
 class DrmBuffer;
+class DrmClientBuffer;
+class DrmClientImport;
 class DrmOutput;
 class GbmSurface;
 
@@ -50,6 +54,9 @@ public:
     bool usesOverlayWindow() const override;
     bool perScreenRendering() const override;
     QRegion prepareRenderingForScreen(int screenId) override;
+    bool directScanout(int screenId, KWayland::Server::SurfaceInterface *surface) override;
+    QVector<OverlayCandidate> assignOverlays(int screenId, const QVector<OverlayCandidate> &candidates) override;
+    bool presentOverlays(int screenId) override;
     void init() override;
 
 protected:
@@ -70,16 +77,23 @@ private:
         /**
         * @brief The damage history for the past 10 frames.
         */
-        QList<QRegion> damageHistory;
+        DamageJournal damageJournal;
     };
     bool resetOutput(Output &output, DrmOutput *drmOutput);
     bool makeContextCurrent(const Output &output);
-    void presentOnOutput(Output &output);
+    void presentOnOutput(Output &output, const QRegion &damage);
     void cleanupOutput(const Output &output);
     void createOutput(DrmOutput *output);
+    DrmClientBuffer *importBuffer(KWayland::Server::BufferInterface *buffer);
     DrmBackend *m_backend;
     QVector<Output> m_outputs;
+    /**
+     * The imports of the client buffers offered for scanout, null for buffers which cannot be
+     * scanned out. Entries are removed when the client destroys the buffer.
+     **/
+    QHash<KWayland::Server::BufferInterface*, std::shared_ptr<DrmClientImport>> m_imports;
     QScopedPointer<RemoteAccessManager> m_remoteaccessManager;
+    bool m_directScanout;
     friend class EglGbmTexture;
 };
 
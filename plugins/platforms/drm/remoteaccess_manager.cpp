@@ -61,6 +61,11 @@ void RemoteAccessManager::releaseBuffer(const BufferHandle *buf)
     delete buf;
 }
 
+bool RemoteAccessManager::isBound() const
+{
+    return m_interface && m_interface->isBound();
+}
+
 void RemoteAccessManager::passBuffer(DrmOutput *output, DrmBuffer *buffer)
 {
     DrmSurfaceBuffer* gbmbuf = static_cast<DrmSurfaceBuffer *>(buffer);
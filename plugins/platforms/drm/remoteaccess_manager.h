@@ -46,6 +46,10 @@ public:
     virtual ~RemoteAccessManager();
 
     void passBuffer(DrmOutput *output, DrmBuffer *buffer);
+    /**
+     * Whether a client is bound to the interface and expects to get the buffers passed.
+     **/
+    bool isBound() const;
 
 signals:
     void bufferNoLongerNeeded(qint32 gbm_handle);
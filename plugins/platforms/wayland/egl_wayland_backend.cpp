@@ -24,6 +24,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "composite.h"
 #include "logging.h"
 #include "options.h"
+#include "screens.h"
 #include "wayland_backend.h"
 #include "wayland_server.h"
 #include <KWayland/Client/surface.h>
@@ -105,6 +106,7 @@ void EglWaylandBackend::init()
 
     initKWinGL();
     initBufferAge();
+    initSwapBuffersWithDamage();
     initWayland();
 }
 
@@ -192,15 +194,12 @@ void EglWaylandBackend::present()
     m_wayland->surface()->setupFrameCallback();
     Compositor::self()->aboutToSwapBuffers();
 
+    // the host compositor only needs to look at the area repainted in this frame
+    swapBuffers(surface(), lastDamage(), screens()->geometry());
     if (supportsBufferAge()) {
-        eglSwapBuffers(eglDisplay(), surface());
         eglQuerySurface(eglDisplay(), surface(), EGL_BUFFER_AGE_EXT, &m_bufferAge);
-        setLastDamage(QRegion());
-        return;
-    } else {
-        eglSwapBuffers(eglDisplay(), surface());
-        setLastDamage(QRegion());
     }
+    setLastDamage(QRegion());
 }
 
 void EglWaylandBackend::screenGeometryChanged(const QSize &size)
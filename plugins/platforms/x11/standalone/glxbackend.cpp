@@ -35,6 +35,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "screens.h"
 #include "xcbutils.h"
 #include "texture.h"
+#include "vblankclock.h"
 // kwin libs
 #include <kwinglplatform.h>
 #include <kwinglutils.h>
@@ -42,6 +43,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 // Qt
 #include <QDebug>
 #include <QOpenGLContext>
+#include <QTimer>
 #include <QX11Info>
 // system
 #include <unistd.h>
@@ -125,6 +127,10 @@ GlxBackend::~GlxBackend()
     if (isFailed()) {
         m_overlayWindow->destroy();
     }
+    delete m_swapFenceTimer;
+    if (m_swapFence) {
+        glDeleteSync(m_swapFence);
+    }
     // TODO: cleanup in error case
     // do cleanup after initBuffer()
     cleanupGL();
@@ -208,6 +214,7 @@ void GlxBackend::init()
     m_haveMESASwapControl   = hasExtension(QByteArrayLiteral("GLX_MESA_swap_control"));
     m_haveEXTSwapControl    = hasExtension(QByteArrayLiteral("GLX_EXT_swap_control"));
     m_haveSGISwapControl    = hasExtension(QByteArrayLiteral("GLX_SGI_swap_control"));
+    m_haveOMLSyncControl    = hasExtension(QByteArrayLiteral("GLX_OML_sync_control"));
     // only enable Intel swap event if env variable is set, see BUG 342582
     m_haveINTELSwapEvent    = hasExtension(QByteArrayLiteral("GLX_INTEL_swap_event"))
                                 && qgetenv("KWIN_USE_INTEL_SWAP_EVENT") == QByteArrayLiteral("1");
@@ -219,6 +226,18 @@ void GlxBackend::init()
 
     haveSwapInterval = m_haveMESASwapControl || m_haveEXTSwapControl || m_haveSGISwapControl;
 
+    // Drivers blocking on the swap are waited for with glXWaitGL, which stalls input
+    // and protocol handling for up to a frame. A fence polled from the event loop
+    // keeps it going, but adds up to a millisecond to noticing the swap completion.
+    m_asyncSwap = !m_haveINTELSwapEvent && (hasGLVersion(3, 2) || hasGLExtension(QByteArrayLiteral("GL_ARB_sync")))
+                    && qgetenv("KWIN_GLX_ASYNC_SWAP") == QByteArrayLiteral("1");
+    if (m_asyncSwap) {
+        m_swapFenceTimer = new QTimer;
+        m_swapFenceTimer->setSingleShot(true);
+        m_swapFenceTimer->setTimerType(Qt::PreciseTimer);
+        QObject::connect(m_swapFenceTimer, &QTimer::timeout, [this] { checkSwapFence(); });
+    }
+
     setSupportsBufferAge(false);
 
     if (hasExtension(QByteArrayLiteral("GLX_EXT_buffer_age"))) {
@@ -669,6 +688,40 @@ void GlxBackend::waitSync()
     }
 }
 
+void GlxBackend::checkSwapFence()
+{
+    if (!m_swapFence) {
+        return;
+    }
+    makeCurrent();
+    const GLenum result = glClientWaitSync(m_swapFence, 0, 0);
+    // never keep the compositor waiting for longer than a missed frame or two
+    if (result == GL_TIMEOUT_EXPIRED && m_swapFenceAge.elapsed() < 100) {
+        m_swapFenceTimer->start(1);
+        return;
+    }
+    if (result == GL_WAIT_FAILED) {
+        qCWarning(KWIN_X11STANDALONE) << "glClientWaitSync() on the swap fence failed";
+    }
+    glDeleteSync(m_swapFence);
+    m_swapFence = nullptr;
+    updateVBlankClock();
+    Compositor::self()->bufferSwapComplete();
+}
+
+void GlxBackend::updateVBlankClock()
+{
+    if (!m_haveOMLSyncControl) {
+        return;
+    }
+    int64_t ust, msc, sbc;
+    if (!glXGetSyncValuesOML(display(), glxWindow, &ust, &msc, &sbc)) {
+        return;
+    }
+    // the unadjusted system time is CLOCK_MONOTONIC in microseconds
+    kwinApp()->platform()->vblankClock()->notifyVBlank(ust * 1000, msc);
+}
+
 void GlxBackend::present()
 {
     if (lastDamage().isEmpty())
@@ -679,7 +732,8 @@ void GlxBackend::present()
     const bool fullRepaint = supportsBufferAge() || (lastDamage() == displayRegion);
 
     if (fullRepaint) {
-        if (m_haveINTELSwapEvent)
+        const bool asyncSwap = m_asyncSwap && haveSwapInterval && blocksForRetrace() && !gs_tripleBufferNeedsDetection;
+        if (m_haveINTELSwapEvent || asyncSwap)
             Compositor::self()->aboutToSwapBuffers();
 
         if (haveSwapInterval) {
@@ -707,6 +761,14 @@ void GlxBackend::present()
                     }
                     setBlocksForRetrace(result == 'd');
                 }
+            } else if (asyncSwap) {
+                // the swap completes once the commands queued up to here got executed
+                m_swapFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                glFlush();
+                m_swapFenceAge.start();
+                // nothing to look for before the vblank the swap waits for
+                const qint64 delay = kwinApp()->platform()->vblankClock()->nextVBlank() - VBlankClock::now();
+                m_swapFenceTimer->start(qMax<qint64>(0, delay / 1000000));
             } else if (blocksForRetrace()) {
                 // at least the nvidia blob manages to swap async, ie. return immediately on double
                 // buffering - what messes our timing calculation and leads to laggy behavior #346275
@@ -719,6 +781,7 @@ void GlxBackend::present()
         if (supportsBufferAge()) {
             glXQueryDrawable(display(), glxWindow, GLX_BACK_BUFFER_AGE_EXT, (GLuint *) &m_bufferAge);
         }
+        updateVBlankClock();
     } else if (m_haveMESACopySubBuffer) {
         foreach (const QRect & r, lastDamage().rects()) {
             // convert to OpenGL coordinates
@@ -27,8 +27,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <xcb/glx.h>
 #include <epoxy/glx.h>
 #include <fixx11h.h>
+#include <QElapsedTimer>
 #include <memory>
 
+class QTimer;
+
 namespace KWin
 {
 
@@ -88,6 +91,16 @@ private:
     bool checkVersion();
     void initExtensions();
     void waitSync();
+    /**
+     * Completes the buffer swap once the fence inserted after it signaled,
+     * otherwise checks again a little later.
+     **/
+    void checkSwapFence();
+    /**
+     * Feeds the Platform's VBlankClock with the time of the last vblank
+     * as reported by GLX_OML_sync_control.
+     **/
+    void updateVBlankClock();
     bool initRenderingContext();
     bool initFbConfig();
     void initVisualDepthHashTable();
@@ -116,8 +129,17 @@ private:
     bool m_haveEXTSwapControl = false;
     bool m_haveSGISwapControl = false;
     bool m_haveINTELSwapEvent = false;
+    bool m_haveOMLSyncControl = false;
     bool haveSwapInterval = false;
     bool haveWaitSync = false;
+    /**
+     * Whether to wait for blocking swaps with a fence polled from the event loop
+     * instead of glXWaitGL, see KWIN_GLX_ASYNC_SWAP.
+     **/
+    bool m_asyncSwap = false;
+    GLsync m_swapFence = nullptr;
+    QTimer *m_swapFenceTimer = nullptr;
+    QElapsedTimer m_swapFenceAge;
     Display *m_x11Display;
     SwapProfiler m_swapProfiler;
     friend class GlxTexture;
@@ -0,0 +1,193 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "drawlist.h"
+
+#include <stddef.h>
+#include <string.h>
+
+namespace KWin
+{
+
+// the index buffer used for GL_QUADS holds 16 bit indices relative to the base vertex
+static const int s_maxIndexedQuads = 0x4000;
+
+WindowDrawList::WindowDrawList()
+{
+}
+
+GLVertex2D *WindowDrawList::allocateVertices(int count, int *first)
+{
+    *first = m_vertices.count();
+    m_vertices.resize(*first + count);
+    return m_vertices.data() + *first;
+}
+
+void WindowDrawList::addDraw(const Draw &draw)
+{
+    m_draws.append(draw);
+}
+
+void WindowDrawList::sort()
+{
+    m_order.clear();
+    m_order.reserve(m_draws.count());
+
+    for (int i = 0; i < m_draws.count(); ++i) {
+        const Draw &draw = m_draws.at(i);
+
+        // move the draw up to the last one it can be merged with, e.g. the decoration
+        // of another window in the same atlas page, or else to the last one using the
+        // same shader, unless it would end up below something it overlaps
+        int position = m_order.count();
+        int target = -1;
+        for (int j = m_order.count() - 1; j >= 0; --j) {
+            const Draw &other = m_draws.at(m_order.at(j));
+            if (canMerge(other, draw)) {
+                target = j + 1;
+                break;
+            }
+            if (target < 0 && other.traits == draw.traits) {
+                target = j + 1;
+            }
+            if (other.bounds.intersects(draw.bounds)) {
+                break;
+            }
+        }
+        if (target >= 0) {
+            position = target;
+        }
+        m_order.insert(position, i);
+    }
+}
+
+bool WindowDrawList::canMerge(const Draw &first, const Draw &second) const
+{
+    return first.traits == second.traits &&
+           first.texture == second.texture &&
+           first.filter == second.filter &&
+           first.blend == second.blend &&
+           first.saturation == second.saturation &&
+           first.modulation == second.modulation &&
+           first.mvp == second.mvp;
+}
+
+void WindowDrawList::flush()
+{
+    if (m_draws.isEmpty()) {
+        return;
+    }
+
+    sort();
+
+    const bool indexedQuads = GLVertexBuffer::supportsIndexedQuads();
+    const GLenum primitiveType = indexedQuads ? GL_QUADS : GL_TRIANGLES;
+
+    const GLVertexAttrib attribs[] = {
+        { VA_Position, 2, GL_FLOAT, offsetof(GLVertex2D, position) },
+        { VA_TexCoord, 2, GL_FLOAT, offsetof(GLVertex2D, texcoord) },
+    };
+
+    GLVertexBuffer *vbo = GLVertexBuffer::streamingBuffer();
+    vbo->reset();
+    vbo->setAttribLayout(attribs, 2, sizeof(GLVertex2D));
+
+    // Upload in submission order, so that draws which get merged are contiguous
+    GLVertex2D *map = (GLVertex2D *) vbo->map(m_vertices.count() * sizeof(GLVertex2D));
+    int v = 0;
+    for (int index : qAsConst(m_order)) {
+        Draw &draw = m_draws[index];
+        memcpy(map + v, m_vertices.constData() + draw.firstVertex, draw.vertexCount * sizeof(GLVertex2D));
+        draw.firstVertex = v;
+        v += draw.vertexCount;
+    }
+    vbo->unmap();
+    vbo->bindArrays();
+
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    ShaderManager *shaderManager = ShaderManager::instance();
+    GLShader *shader = nullptr;
+    const Draw *previous = nullptr;
+    bool blend = false;
+
+    for (int i = 0; i < m_order.count();) {
+        const Draw &draw = m_draws.at(m_order.at(i));
+
+        int vertexCount = draw.vertexCount;
+        int next = i + 1;
+        for (; next < m_order.count(); ++next) {
+            const Draw &other = m_draws.at(m_order.at(next));
+            if (!canMerge(draw, other)) {
+                break;
+            }
+            if (indexedQuads && (vertexCount + other.vertexCount) / 4 > s_maxIndexedQuads) {
+                break;
+            }
+            vertexCount += other.vertexCount;
+        }
+
+        if (!previous || previous->traits != draw.traits) {
+            if (shader) {
+                shaderManager->popShader();
+            }
+            shader = shaderManager->pushShader(draw.traits);
+        }
+
+        // the shader skips values it already has
+        shader->setUniform(GLShader::ModelViewProjectionMatrix, draw.mvp);
+        shader->setUniform(GLShader::ModulationConstant, draw.modulation);
+        shader->setUniform(GLShader::Saturation, draw.saturation);
+
+        if (blend != draw.blend) {
+            if (draw.blend) {
+                glEnable(GL_BLEND);
+            } else {
+                glDisable(GL_BLEND);
+            }
+            blend = draw.blend;
+        }
+
+        if (!previous || previous->texture != draw.texture || previous->filter != draw.filter) {
+            draw.texture->setFilter(draw.filter);
+            draw.texture->setWrapMode(GL_CLAMP_TO_EDGE);
+            draw.texture->bind();
+        }
+
+        vbo->draw(primitiveType, draw.firstVertex, vertexCount);
+
+        previous = &draw;
+        i = next;
+    }
+
+    vbo->unbindArrays();
+
+    if (blend) {
+        glDisable(GL_BLEND);
+    }
+    if (shader) {
+        shaderManager->popShader();
+    }
+
+    m_vertices.clear();
+    m_draws.clear();
+    m_order.clear();
+}
+
+}
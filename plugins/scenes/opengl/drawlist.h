@@ -0,0 +1,111 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+
+#ifndef KWIN_SCENE_OPENGL_DRAWLIST_H
+#define KWIN_SCENE_OPENGL_DRAWLIST_H
+
+#include "kwinglutils.h"
+
+#include <QMatrix4x4>
+#include <QRectF>
+#include <QVector>
+#include <QVector4D>
+
+namespace KWin
+{
+
+/**
+ * @brief Collects the window draws of a paint pass and submits them at once.
+ *
+ * Instead of mapping the streaming vertex buffer and issuing a draw call per leaf node
+ * of every window, windows record their vertices and the state they need. flush() uploads
+ * the vertices of all recorded draws with a single map of the streaming buffer, reorders
+ * draws sharing all state, or else the shader, next to each other where the stacking order
+ * allows it, and merges consecutive draws sharing all state into one draw call. State is only changed
+ * when it differs from the previous draw.
+ *
+ * A draw may be moved before another one recorded earlier only if their bounds do not
+ * intersect, so the result is the same as painting them in order.
+ *
+ * Draws are submitted without scissoring, the vertices have to be clipped to the paint
+ * region of the window before they are recorded.
+ *
+ * Anything painting into the framebuffer without going through the list has to flush it
+ * first.
+ **/
+class WindowDrawList
+{
+public:
+    struct Draw {
+        ShaderTraits traits;
+        QMatrix4x4 mvp;
+        QVector4D modulation;
+        float saturation = 1.0;
+        GLTexture *texture = nullptr;
+        GLenum filter = GL_NEAREST;
+        bool blend = false;
+        /**
+         * The area covered by the vertices, in the coordinate system of @ref mvp.
+         **/
+        QRectF bounds;
+        int firstVertex = 0;
+        int vertexCount = 0;
+    };
+
+    WindowDrawList();
+
+    bool isEnabled() const {
+        return m_enabled;
+    }
+    /**
+     * Windows only record into an enabled list. Disabling the list does not flush it.
+     **/
+    void setEnabled(bool enabled) {
+        m_enabled = enabled;
+    }
+    bool isEmpty() const {
+        return m_draws.isEmpty();
+    }
+
+    /**
+     * Reserves @p count vertices for a draw and returns a pointer to them. The index of the
+     * first vertex is stored in @p first. The pointer is only valid until the next call.
+     **/
+    GLVertex2D *allocateVertices(int count, int *first);
+    void addDraw(const Draw &draw);
+    /**
+     * Submits and clears all recorded draws. Expects blending to be disabled and leaves
+     * it disabled.
+     **/
+    void flush();
+
+private:
+    void sort();
+    bool canMerge(const Draw &first, const Draw &second) const;
+
+    bool m_enabled = false;
+    QVector<GLVertex2D> m_vertices;
+    QVector<Draw> m_draws;
+    QVector<int> m_order;
+};
+
+}
+
+#endif
@@ -51,6 +51,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <KWayland/Server/subcompositor_interface.h>
 #include <KWayland/Server/surface_interface.h>
 
+#include <algorithm>
 #include <array>
 #include <cmath>
 #include <unistd.h>
@@ -62,6 +63,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QDBusInterface>
 #include <QGraphicsScale>
 #include <QStringList>
+#include <QTimer>
 #include <QVector2D>
 #include <QVector4D>
 #include <QMatrix4x4>
@@ -653,39 +655,24 @@ qint64 SceneOpenGL::paint(QRegion damage, ToplevelList toplevels)
     // repainted, and may be larger than updateRegion.
     QRegion updateRegion, validRegion;
     if (m_backend->perScreenRendering()) {
+        // painting the first screen resets the repaints of the windows, so the
+        // following screens would miss them in the damage they report
+        for (Toplevel *t : qAsConst(toplevels)) {
+            damage |= t->repaints();
+        }
         // trigger start render timer
         m_backend->prepareRenderingFrame();
         for (int i = 0; i < screens()->count(); ++i) {
-            const QRect &geo = screens()->geometry(i);
-            QRegion update;
-            QRegion valid;
-            // prepare rendering makes context current on the output
-            QRegion repaint = m_backend->prepareRenderingForScreen(i);
-            GLVertexBuffer::setVirtualScreenGeometry(geo);
-            GLRenderTarget::setVirtualScreenGeometry(geo);
-            GLVertexBuffer::setVirtualScreenScale(screens()->scale(i));
-            GLRenderTarget::setVirtualScreenScale(screens()->scale(i));
-
-            const GLenum status = glGetGraphicsResetStatus();
-            if (status != GL_NO_ERROR) {
-                handleGraphicsReset(status);
+            if (!paintScreenOnBackend(i, damage)) {
                 return 0;
             }
-
-            int mask = 0;
-            updateProjectionMatrix();
-            paintScreen(&mask, damage.intersected(geo), repaint, &update, &valid, projectionMatrix(), geo);   // call generic implementation
-            paintCursor();
-
-            GLVertexBuffer::streamingBuffer()->endOfFrame();
-
-            m_backend->endRenderingFrameForScreen(i, valid, update);
-
-            GLVertexBuffer::streamingBuffer()->framePosted();
         }
     } else {
         m_backend->makeCurrent();
         QRegion repaint = m_backend->prepareRenderingFrame();
+        if (m_decorationAtlas) {
+            m_decorationAtlas->defragment();
+        }
 
         const GLenum status = glGetGraphicsResetStatus();
         if (status != GL_NO_ERROR) {
@@ -718,11 +705,103 @@ qint64 SceneOpenGL::paint(QRegion damage, ToplevelList toplevels)
 
         GLVertexBuffer::streamingBuffer()->endOfFrame();
 
+        enterFramePhase(FrameTelemetry::Phase::Swap);
         m_backend->endRenderingFrame(validRegion, updateRegion);
 
         GLVertexBuffer::streamingBuffer()->framePosted();
     }
 
+    finishFrame();
+    return m_backend->renderTime();
+}
+
+bool SceneOpenGL::supportsOutputPainting() const
+{
+    return m_backend->perScreenRendering();
+}
+
+qint64 SceneOpenGL::paintOutput(int screenId, QRegion damage, ToplevelList toplevels)
+{
+    if (!m_backend->perScreenRendering() || screenId < 0 || screenId >= screens()->count()) {
+        return paint(damage, toplevels);
+    }
+    createStackingOrder(toplevels);
+
+    // trigger start render timer
+    m_backend->prepareRenderingFrame();
+    if (!paintScreenOnBackend(screenId, damage)) {
+        return 0;
+    }
+
+    finishFrame();
+    return m_backend->renderTime();
+}
+
+bool SceneOpenGL::paintScreenOnBackend(int screenId, const QRegion &damage)
+{
+    if (KWayland::Server::SurfaceInterface *surface = directScanoutCandidate(screenId)) {
+        enterFramePhase(FrameTelemetry::Phase::Swap);
+        if (m_backend->directScanout(screenId, surface)) {
+            resetRepaintsAfterDirectScanout(screenId);
+            return true;
+        }
+    }
+
+    const QRect &geo = screens()->geometry(screenId);
+    QRegion screenDamage = damage.intersected(geo);
+    // if nothing but the surfaces on overlay planes changed, the last frame can stay
+    const QVector<OverlayCandidate> overlays = m_backend->assignOverlays(screenId, overlayCandidates(screenId));
+    if (!overlays.isEmpty()) {
+        QRegion overlayRegion;
+        for (const OverlayCandidate &overlay : overlays) {
+            overlayRegion |= overlay.geometry;
+        }
+        if (!screenDamage.isEmpty() && screenDamage.subtracted(overlayRegion).isEmpty()) {
+            enterFramePhase(FrameTelemetry::Phase::Swap);
+            if (m_backend->presentOverlays(screenId)) {
+                m_overlayDamage[screenId] |= screenDamage;
+                resetRepaintsAfterDirectScanout(screenId);
+                return true;
+            }
+        }
+    }
+    screenDamage |= m_overlayDamage.take(screenId);
+
+    QRegion update;
+    QRegion valid;
+    // prepare rendering makes context current on the output
+    QRegion repaint = m_backend->prepareRenderingForScreen(screenId);
+    // nothing recorded refers to the atlas between two screens
+    if (m_decorationAtlas) {
+        m_decorationAtlas->defragment();
+    }
+    GLVertexBuffer::setVirtualScreenGeometry(geo);
+    GLRenderTarget::setVirtualScreenGeometry(geo);
+    GLVertexBuffer::setVirtualScreenScale(screens()->scale(screenId));
+    GLRenderTarget::setVirtualScreenScale(screens()->scale(screenId));
+
+    const GLenum status = glGetGraphicsResetStatus();
+    if (status != GL_NO_ERROR) {
+        handleGraphicsReset(status);
+        return false;
+    }
+
+    int mask = 0;
+    updateProjectionMatrix();
+    paintScreen(&mask, screenDamage, repaint, &update, &valid, projectionMatrix(), geo);   // call generic implementation
+    paintCursor();
+
+    GLVertexBuffer::streamingBuffer()->endOfFrame();
+
+    enterFramePhase(FrameTelemetry::Phase::Swap);
+    m_backend->endRenderingFrameForScreen(screenId, valid, update);
+
+    GLVertexBuffer::streamingBuffer()->framePosted();
+    return true;
+}
+
+void SceneOpenGL::finishFrame()
+{
     if (m_currentFence) {
         if (!m_syncManager->updateFences()) {
             qCDebug(KWIN_OPENGL) << "Aborting explicit synchronization with the X command stream.";
@@ -735,7 +814,6 @@ qint64 SceneOpenGL::paint(QRegion damage, ToplevelList toplevels)
 
     // do cleanup
     clearStackingOrder();
-    return m_backend->renderTime();
 }
 
 QMatrix4x4 SceneOpenGL::transformation(int mask, const ScreenPaintData &data) const
@@ -923,7 +1001,11 @@ Shadow *SceneOpenGL::createShadow(Toplevel *toplevel)
 
 Decoration::Renderer *SceneOpenGL::createDecorationRenderer(Decoration::DecoratedClientImpl *impl)
 {
-    return new SceneOpenGLDecorationRenderer(impl);
+    static const bool s_useAtlas = qgetenv("KWIN_DECORATION_ATLAS") != QByteArrayLiteral("0");
+    if (s_useAtlas && !m_decorationAtlas) {
+        m_decorationAtlas.reset(new GLTextureAtlas);
+    }
+    return new SceneOpenGLDecorationRenderer(impl, m_decorationAtlas);
 }
 
 bool SceneOpenGL::animationsSupported() const
@@ -1001,6 +1083,13 @@ SceneOpenGL2::SceneOpenGL2(OpenGLBackend *backend, QObject *parent)
         return;
     }
 
+    if (qgetenv("KWIN_GL_PRECOMPILE_SHADERS") != QByteArrayLiteral("0")) {
+        // one shader per tick, so that it never delays more than a single frame
+        m_precompileTimer = new QTimer(this);
+        m_precompileTimer->setInterval(100);
+        connect(m_precompileTimer, &QTimer::timeout, this, &SceneOpenGL2::precompileShaders);
+    }
+
     qCDebug(KWIN_OPENGL) << "OpenGL 2 compositing successfully initialized";
     init_ok = true;
 }
@@ -1009,6 +1098,38 @@ SceneOpenGL2::~SceneOpenGL2()
 {
 }
 
+void SceneOpenGL2::idle()
+{
+    SceneOpenGL::idle();
+    if (m_precompileTimer) {
+        m_precompileTimer->start();
+    }
+}
+
+void SceneOpenGL2::precompileShaders()
+{
+    // the combinations used by the scene and the common effects
+    static const ShaderTraits s_traits[] = {
+        ShaderTrait::MapTexture | ShaderTrait::Modulate,
+        ShaderTrait::MapTexture | ShaderTrait::Modulate | ShaderTrait::AdjustSaturation,
+        ShaderTrait::MapTexture | ShaderTrait::AdjustSaturation,
+        ShaderTrait::UniformColor,
+        ShaderTrait::UniformColor | ShaderTrait::Modulate,
+    };
+
+    // painted since the last idle pass, continue once the compositor is idle again
+    if (last_time.isValid() || !makeOpenGLContextCurrent()) {
+        m_precompileTimer->stop();
+        return;
+    }
+    ShaderManager::instance()->shader(s_traits[m_precompiledShaders++]);
+    if (m_precompiledShaders == int(sizeof(s_traits) / sizeof(s_traits[0]))) {
+        m_precompileTimer->stop();
+        m_precompileTimer->deleteLater();
+        m_precompileTimer = nullptr;
+    }
+}
+
 QMatrix4x4 SceneOpenGL2::createProjectionMatrix() const
 {
     // Create a perspective projection with a 60° field-of-view,
@@ -1050,7 +1171,9 @@ void SceneOpenGL2::paintSimpleScreen(int mask, QRegion region)
 {
     m_screenProjectionMatrix = m_projectionMatrix;
 
+    beginDrawList();
     Scene::paintSimpleScreen(mask, region);
+    endDrawList();
 }
 
 void SceneOpenGL2::paintGenericScreen(int mask, ScreenPaintData data)
@@ -1059,7 +1182,25 @@ void SceneOpenGL2::paintGenericScreen(int mask, ScreenPaintData data)
 
     m_screenProjectionMatrix = m_projectionMatrix * screenMatrix;
 
+    beginDrawList();
     Scene::paintGenericScreen(mask, data);
+    endDrawList();
+}
+
+void SceneOpenGL2::beginDrawList()
+{
+    // Desktop thumbnails paint the screen again while the outer pass is recording
+    m_drawList.flush();
+    // Effects may read back or redirect what has been painted so far, e.g. blur,
+    // so they get every window painted immediately. The scene itself only switches
+    // the render target for the lanczos filter, which flushes the list before.
+    m_drawList.setEnabled(!static_cast<EffectsHandlerImpl*>(effects)->hasActiveEffects());
+}
+
+void SceneOpenGL2::endDrawList()
+{
+    m_drawList.flush();
+    m_drawList.setEnabled(false);
 }
 
 void SceneOpenGL2::doPaintBackground(const QVector< float >& vertices)
@@ -1093,6 +1234,8 @@ void SceneOpenGL2::finalDrawWindow(EffectWindowImpl* w, int mask, QRegion region
 void SceneOpenGL2::performPaintWindow(EffectWindowImpl* w, int mask, QRegion region, WindowPaintData& data)
 {
     if (mask & PAINT_WINDOW_LANCZOS) {
+        // the filter paints into its own render target, e.g. for window thumbnails
+        m_drawList.flush();
         if (!m_lanczosFilter) {
             m_lanczosFilter = new LanczosFilter(this);
             // reset the lanczos filter when the screen gets resized
@@ -1166,35 +1309,110 @@ QMatrix4x4 SceneOpenGL::Window::transformation(int mask, const WindowPaintData &
     return matrix;
 }
 
-bool SceneOpenGL::Window::beginRenderWindow(int mask, const QRegion &region, WindowPaintData &data)
+// Up to this many quad and rect intersections trimming the quads of a transformed
+// window is cheaper than drawing it once for every rect of the clip region
+static const int s_maxQuadClipOperations = 1024;
+
+static WindowQuadList clipQuads(const WindowQuadList &quads, const QVector<QRectF> &rects)
+{
+    WindowQuadList clipped;
+    clipped.reserve(quads.count());
+
+    // split all quads in bounding rect with the actual rects in the region
+    foreach (const WindowQuad &quad, quads) {
+        const QRectF quadRect(QPointF(quad.left(), quad.top()), QPointF(quad.right(), quad.bottom()));
+        for (const QRectF &rf : rects) {
+            const QRectF &intersected = rf.intersected(quadRect);
+            if (intersected.isValid()) {
+                if (quadRect == intersected) {
+                    // case 1: completely contains, include and do not check other rects
+                    clipped << quad;
+                    break;
+                }
+                // case 2: intersection
+                clipped << quad.makeSubQuad(intersected.left(), intersected.top(), intersected.right(), intersected.bottom());
+            }
+        }
+    }
+    return clipped;
+}
+
+static QRectF quadsBoundingRect(const WindowQuadList &quads)
+{
+    if (quads.isEmpty()) {
+        return QRectF();
+    }
+    qreal left = quads.first().left();
+    qreal top = quads.first().top();
+    qreal right = quads.first().right();
+    qreal bottom = quads.first().bottom();
+    for (const WindowQuad &quad : quads) {
+        left = qMin(left, quad.left());
+        top = qMin(top, quad.top());
+        right = qMax(right, quad.right());
+        bottom = qMax(bottom, quad.bottom());
+    }
+    return QRectF(QPointF(left, top), QPointF(right, bottom));
+}
+
+static bool hasMappedSubSurfaces(WindowPixmap *pixmap)
+{
+    if (!pixmap) {
+        return false;
+    }
+    const auto &children = pixmap->children();
+    return std::any_of(children.constBegin(), children.constEnd(),
+        [] (WindowPixmap *child) {
+            return !child->subSurface().isNull() && !child->subSurface()->surface().isNull() && child->subSurface()->surface()->isMapped();
+        }
+    );
+}
+
+bool SceneOpenGL::Window::beginRenderWindow(int mask, QRegion &region, WindowPaintData &data)
 {
     if (region.isEmpty())
         return false;
 
-    m_hardwareClipping = region != infiniteRegion() && (mask & PAINT_WINDOW_TRANSFORMED) && !(mask & PAINT_SCREEN_TRANSFORMED);
-    if (region != infiniteRegion() && !m_hardwareClipping) {
-        WindowQuadList quads;
-        quads.reserve(data.quads.count());
-
-        const QRegion filterRegion = region.translated(-x(), -y());
-        // split all quads in bounding rect with the actual rects in the region
-        foreach (const WindowQuad &quad, data.quads) {
-            for (const QRect &r : filterRegion) {
-                const QRectF rf(r);
-                const QRectF quadRect(QPointF(quad.left(), quad.top()), QPointF(quad.right(), quad.bottom()));
-                const QRectF &intersected = rf.intersected(quadRect);
-                if (intersected.isValid()) {
-                    if (quadRect == intersected) {
-                        // case 1: completely contains, include and do not check other rects
-                        quads << quad;
-                        break;
-                    }
-                    // case 2: intersection
-                    quads << quad.makeSubQuad(intersected.left(), intersected.top(), intersected.right(), intersected.bottom());
-                }
+    m_hardwareClipping = false;
+    if (region == infiniteRegion()) {
+        // nothing to clip
+    } else if (!(mask & PAINT_WINDOW_TRANSFORMED) || (mask & PAINT_SCREEN_TRANSFORMED)) {
+        QVector<QRectF> rects;
+        rects.reserve(region.rectCount());
+        for (const QRect &r : region) {
+            rects << QRectF(r.translated(-x(), -y()));
+        }
+        data.quads = clipQuads(data.quads, rects);
+        countClipping(Clipping::Quads, 1);
+    } else if (data.rotationAngle() == 0.0 && data.zTranslation() == 0.0 &&
+               !data.quads.isTransformed() && !hasMappedSubSurfaces(windowPixmap<WindowPixmap>()) &&
+               data.modelViewMatrix().isIdentity() &&
+               (data.projectionMatrix().isIdentity() || data.projectionMatrix() == m_scene->screenProjectionMatrix())) {
+        // Only scaled and translated, so the rects of the region which matter can be
+        // found and mapped back onto the quads. Sub-surfaces may be outside of the quads.
+        // Matrices of effects are not taken into account, the window has to be painted
+        // with the projection of the screen.
+        const QMatrix4x4 matrix = transformation(mask, data);
+        region &= matrix.mapRect(quadsBoundingRect(data.quads)).toAlignedRect();
+        if (region.isEmpty())
+            return false;
+
+        if (region.rectCount() > 1 && region.rectCount() * data.quads.count() <= s_maxQuadClipOperations) {
+            const QMatrix4x4 inverse = matrix.inverted();
+            QVector<QRectF> rects;
+            rects.reserve(region.rectCount());
+            for (const QRect &r : region) {
+                rects << inverse.mapRect(QRectF(r));
             }
+            data.quads = clipQuads(data.quads, rects);
+            countClipping(Clipping::Quads, 1);
+        } else {
+            m_hardwareClipping = true;
+            countClipping(Clipping::Scissor, region.rectCount());
         }
-        data.quads = quads;
+    } else {
+        m_hardwareClipping = true;
+        countClipping(Clipping::Scissor, region.rectCount());
     }
 
     if (data.quads.isEmpty())
@@ -1236,7 +1454,7 @@ void SceneOpenGL::Window::endRenderWindow()
     }
 }
 
-GLTexture *SceneOpenGL::Window::getDecorationTexture() const
+GLTexture *SceneOpenGL::Window::getDecorationTexture(QPoint *textureOffset) const
 {
     if (AbstractClient *client = dynamic_cast<AbstractClient *>(toplevel)) {
         if (client->noBorder()) {
@@ -1248,6 +1466,7 @@ GLTexture *SceneOpenGL::Window::getDecorationTexture() const
         }
         if (SceneOpenGLDecorationRenderer *renderer = static_cast<SceneOpenGLDecorationRenderer*>(client->decoratedClient()->renderer())) {
             renderer->render();
+            *textureOffset = renderer->textureOffset();
             return renderer->texture();
         }
     } else if (toplevel->isDeleted()) {
@@ -1256,6 +1475,7 @@ GLTexture *SceneOpenGL::Window::getDecorationTexture() const
             return nullptr;
         }
         if (const SceneOpenGLDecorationRenderer *renderer = static_cast<const SceneOpenGLDecorationRenderer*>(deleted->decorationRenderer())) {
+            *textureOffset = renderer->textureOffset();
             return renderer->texture();
         }
     }
@@ -1298,7 +1518,16 @@ void SceneOpenGL2Window::setBlendEnabled(bool enabled)
     m_blendingEnabled = enabled;
 }
 
-void SceneOpenGL2Window::setupLeafNodes(LeafNode *nodes, const WindowQuadList *quads, const WindowPaintData &data)
+QMatrix4x4 SceneOpenGL2Window::textureMatrix(const LeafNode &node)
+{
+    QMatrix4x4 matrix = node.texture->matrix(node.coordinateType);
+    if (!node.textureOffset.isNull()) {
+        matrix.translate(node.textureOffset.x(), node.textureOffset.y());
+    }
+    return matrix;
+}
+
+void SceneOpenGL2Window::setupLeafNodes(LeafNode *nodes, const WindowQuadBuffer *quads, const WindowPaintData &data)
 {
     if (!quads[ShadowLeaf].isEmpty()) {
         nodes[ShadowLeaf].texture = static_cast<SceneOpenGLShadow *>(m_shadow)->shadowTexture();
@@ -1308,7 +1537,7 @@ void SceneOpenGL2Window::setupLeafNodes(LeafNode *nodes, const WindowQuadList *q
     }
 
     if (!quads[DecorationLeaf].isEmpty()) {
-        nodes[DecorationLeaf].texture = getDecorationTexture();
+        nodes[DecorationLeaf].texture = getDecorationTexture(&nodes[DecorationLeaf].textureOffset);
         nodes[DecorationLeaf].opacity = data.opacity();
         nodes[DecorationLeaf].hasAlpha = true;
         nodes[DecorationLeaf].coordinateType = UnnormalizedCoordinates;
@@ -1390,33 +1619,56 @@ void SceneOpenGL2Window::renderSubSurface(GLShader *shader, const QMatrix4x4 &mv
 
 void SceneOpenGL2Window::performPaint(int mask, QRegion region, WindowPaintData data)
 {
+    auto wp = windowPixmap<OpenGLWindowPixmap>();
+    const auto &children = wp ? wp->children() : QVector<WindowPixmap*>();
+    const bool hasSubSurfaces = hasMappedSubSurfaces(wp);
+
+    // Only windows painted with the default shader at their own position are recorded,
+    // everything else has to be painted on top of what has been recorded so far.
+    // The list has to be flushed before beginRenderWindow() changes any GL state.
+    WindowDrawList *drawList = static_cast<SceneOpenGL2 *>(m_scene)->drawList();
+    const bool record = drawList->isEnabled() && !data.shader && !(mask & PAINT_WINDOW_TRANSFORMED) &&
+                        !hasSubSurfaces;
+    if (!record) {
+        drawList->flush();
+    }
+
     if (!beginRenderWindow(mask, region, data))
         return;
 
+    // The list does not scissor, the quads of windows which are not transformed are
+    // always clipped to the region already.
+    Q_ASSERT(!record || !m_hardwareClipping);
+
     QMatrix4x4 windowMatrix = transformation(mask, data);
     const QMatrix4x4 modelViewProjection = modelViewProjectionMatrix(mask, data);
     const QMatrix4x4 mvpMatrix = modelViewProjection * windowMatrix;
 
-    GLShader *shader = data.shader;
-    if (!shader) {
-        ShaderTraits traits = ShaderTrait::MapTexture;
+    ShaderTraits traits = ShaderTrait::MapTexture;
 
-        if (data.opacity() != 1.0 || data.brightness() != 1.0 || data.crossFadeProgress() != 1.0)
-            traits |= ShaderTrait::Modulate;
+    if (data.opacity() != 1.0 || data.brightness() != 1.0 || data.crossFadeProgress() != 1.0)
+        traits |= ShaderTrait::Modulate;
 
-        if (data.saturation() != 1.0)
-            traits |= ShaderTrait::AdjustSaturation;
+    if (data.saturation() != 1.0)
+        traits |= ShaderTrait::AdjustSaturation;
 
-        shader = ShaderManager::instance()->pushShader(traits);
-    }
-    shader->setUniform(GLShader::ModelViewProjectionMatrix, mvpMatrix);
+    GLShader *shader = data.shader;
+    if (!record) {
+        if (!shader)
+            shader = ShaderManager::instance()->pushShader(traits);
 
-    shader->setUniform(GLShader::Saturation, data.saturation());
+        shader->setUniform(GLShader::ModelViewProjectionMatrix, mvpMatrix);
+
+        shader->setUniform(GLShader::Saturation, data.saturation());
+    }
 
     const GLenum filter = (mask & (Effect::PAINT_WINDOW_TRANSFORMED | Effect::PAINT_SCREEN_TRANSFORMED))
                            && options->glSmoothScale() != 0 ? GL_LINEAR : GL_NEAREST;
 
-    WindowQuadList quads[LeafCount];
+    WindowQuadBuffer *quads = m_leafQuads;
+    for (int i = 0; i < LeafCount; i++) {
+        quads[i].clear();
+    }
 
     // Split the quads into separate lists for each type
     foreach (const WindowQuad &quad, data.quads) {
@@ -1442,7 +1694,8 @@ void SceneOpenGL2Window::performPaint(int mask, QRegion region, WindowPaintData
         OpenGLWindowPixmap *previous = previousWindowPixmap<OpenGLWindowPixmap>();
         if (previous) {
             const QRect &oldGeometry = previous->contentsRect();
-            for (const WindowQuad &quad : quads[ContentLeaf]) {
+            for (int q = 0; q < quads[ContentLeaf].count(); q++) {
+                const WindowQuad quad = quads[ContentLeaf].at(q);
                 // we need to create new window quads with normalize texture coordinates
                 // normal quads divide the x/y position by width/height. This would not work as the texture
                 // is larger than the visible content in case of a decorated Client resulting in garbage being shown.
@@ -1466,15 +1719,45 @@ void SceneOpenGL2Window::performPaint(int mask, QRegion region, WindowPaintData
     const GLenum primitiveType = indexedQuads ? GL_QUADS : GL_TRIANGLES;
     const int verticesPerQuad = indexedQuads ? 4 : 6;
 
+    LeafNode nodes[LeafCount];
+    setupLeafNodes(nodes, quads, data);
+
+    if (record) {
+        WindowDrawList::Draw draw;
+        draw.traits = traits;
+        draw.mvp = modelViewProjection;
+        draw.saturation = data.saturation();
+        draw.filter = filter;
+
+        for (int i = 0; i < LeafCount; i++) {
+            if (quads[i].isEmpty() || !nodes[i].texture)
+                continue;
+
+            // The window position goes into the vertices, so that draws of
+            // different windows share the same matrix
+            quads[i].transform(windowMatrix);
+
+            draw.texture = nodes[i].texture;
+            draw.modulation = modulate(nodes[i].opacity, data.brightness());
+            draw.blend = nodes[i].hasAlpha || nodes[i].opacity < 1.0;
+            draw.bounds = quads[i].boundingRect();
+            draw.vertexCount = quads[i].count() * verticesPerQuad;
+
+            GLVertex2D *vertices = drawList->allocateVertices(draw.vertexCount, &draw.firstVertex);
+            quads[i].makeInterleavedArrays(primitiveType, vertices, textureMatrix(nodes[i]));
+            drawList->addDraw(draw);
+        }
+
+        endRenderWindow();
+        return;
+    }
+
     const size_t size = verticesPerQuad *
         (quads[0].count() + quads[1].count() + quads[2].count() + quads[3].count()) * sizeof(GLVertex2D);
 
     GLVertexBuffer *vbo = GLVertexBuffer::streamingBuffer();
     GLVertex2D *map = (GLVertex2D *) vbo->map(size);
 
-    LeafNode nodes[LeafCount];
-    setupLeafNodes(nodes, quads, data);
-
     for (int i = 0, v = 0; i < LeafCount; i++) {
         if (quads[i].isEmpty() || !nodes[i].texture)
             continue;
@@ -1482,7 +1765,7 @@ void SceneOpenGL2Window::performPaint(int mask, QRegion region, WindowPaintData
         nodes[i].firstVertex = v;
         nodes[i].vertexCount = quads[i].count() * verticesPerQuad;
 
-        const QMatrix4x4 matrix = nodes[i].texture->matrix(nodes[i].coordinateType);
+        const QMatrix4x4 matrix = textureMatrix(nodes[i]);
 
         quads[i].makeInterleavedArrays(primitiveType, &map[v], matrix);
         v += quads[i].count() * verticesPerQuad;
@@ -1518,8 +1801,6 @@ void SceneOpenGL2Window::performPaint(int mask, QRegion region, WindowPaintData
     vbo->unbindArrays();
 
     // render sub-surfaces
-    auto wp = windowPixmap<OpenGLWindowPixmap>();
-    const auto &children = wp ? wp->children() : QVector<WindowPixmap*>();
     windowMatrix.translate(toplevel->clientPos().x(), toplevel->clientPos().y());
     for (auto pixmap : children) {
         if (pixmap->subSurface().isNull() || pixmap->subSurface()->surface().isNull() || !pixmap->subSurface()->surface()->isMapped()) {
@@ -2469,14 +2750,43 @@ bool SceneOpenGLShadow::prepareBackend()
     return true;
 }
 
-SceneOpenGLDecorationRenderer::SceneOpenGLDecorationRenderer(Decoration::DecoratedClientImpl *client)
+SceneOpenGLDecorationRenderer::SceneOpenGLDecorationRenderer(Decoration::DecoratedClientImpl *client, const QSharedPointer<GLTextureAtlas> &atlas)
     : Renderer(client)
     , m_texture()
+    , m_atlas(atlas)
 {
     connect(this, &Renderer::renderScheduled, client->client(), static_cast<void (AbstractClient::*)(const QRect&)>(&AbstractClient::addRepaint));
 }
 
-SceneOpenGLDecorationRenderer::~SceneOpenGLDecorationRenderer() = default;
+SceneOpenGLDecorationRenderer::~SceneOpenGLDecorationRenderer()
+{
+    releaseTexture();
+}
+
+GLTexture *SceneOpenGLDecorationRenderer::texture() const
+{
+    if (m_atlasId) {
+        return m_atlas->texture(m_atlasId);
+    }
+    return m_texture.data();
+}
+
+QPoint SceneOpenGLDecorationRenderer::textureOffset() const
+{
+    if (m_atlasId) {
+        return m_atlas->rect(m_atlasId).topLeft();
+    }
+    return QPoint();
+}
+
+void SceneOpenGLDecorationRenderer::releaseTexture()
+{
+    if (m_atlasId) {
+        m_atlas->release(m_atlasId);
+        m_atlasId = 0;
+    }
+    m_texture.reset();
+}
 
 // Rotates the given source rect 90° counter-clockwise,
 // and flips it vertically
@@ -2515,17 +2825,19 @@ void SceneOpenGLDecorationRenderer::render()
         resetImageSizesDirty();
     }
 
-    if (!m_texture) {
+    GLTexture *texture = this->texture();
+    if (!texture) {
         // for invalid sizes we get no texture, see BUG 361551
         return;
     }
+    const QPoint textureOffset = this->textureOffset();
 
     QRect left, top, right, bottom;
     client()->client()->layoutDecorationRects(left, top, right, bottom);
 
     const QRect geometry = dirty ? QRect(QPoint(0, 0), client()->client()->geometry().size()) : scheduled.boundingRect();
 
-    auto renderPart = [this](const QRect &geo, const QRect &partRect, const QPoint &offset, bool rotated = false) {
+    auto renderPart = [this, texture, textureOffset](const QRect &geo, const QRect &partRect, const QPoint &offset, bool rotated = false) {
         if (geo.isNull()) {
             return;
         }
@@ -2534,7 +2846,7 @@ void SceneOpenGLDecorationRenderer::render()
             // TODO: get this done directly when rendering to the image
             image = rotate(image, QRect(geo.topLeft() - partRect.topLeft(), geo.size()));
         }
-        m_texture->update(image, (geo.topLeft() - partRect.topLeft() + offset) * image.devicePixelRatio());
+        texture->update(image, textureOffset + (geo.topLeft() - partRect.topLeft() + offset) * image.devicePixelRatio());
     };
     renderPart(left.intersected(geometry), left, QPoint(0, top.height() + bottom.height() + 2), true);
     renderPart(top.intersected(geometry), top, QPoint(0, 0));
@@ -2561,17 +2873,26 @@ void SceneOpenGLDecorationRenderer::resizeTexture()
     size.rwidth() = align(size.width(), 128);
 
     size *= client()->client()->screenScale();
+    if (m_atlasId && m_atlas->rect(m_atlasId).size() == size)
+        return;
     if (m_texture && m_texture->size() == size)
         return;
 
-    if (!size.isEmpty()) {
-        m_texture.reset(new GLTexture(GL_RGBA8, size.width(), size.height()));
-        m_texture->setYInverted(true);
-        m_texture->setWrapMode(GL_CLAMP_TO_EDGE);
-        m_texture->clear();
-    } else {
-        m_texture.reset();
+    releaseTexture();
+    if (size.isEmpty()) {
+        return;
+    }
+    if (m_atlas) {
+        m_atlasId = m_atlas->allocate(size);
+        if (m_atlasId) {
+            m_atlas->clear(m_atlasId);
+            return;
+        }
     }
+    m_texture.reset(new GLTexture(GL_RGBA8, size.width(), size.height()));
+    m_texture->setYInverted(true);
+    m_texture->setWrapMode(GL_CLAMP_TO_EDGE);
+    m_texture->clear();
 }
 
 void SceneOpenGLDecorationRenderer::reparent(Deleted *deleted)
@@ -24,12 +24,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "scene.h"
 #include "shadow.h"
+#include "drawlist.h"
 
 #include "kwinglutils.h"
+#include "kwingltextureatlas.h"
 
 #include "decorations/decorationrenderer.h"
 #include "platformsupport/scenes/opengl/backend.h"
 
+class QTimer;
+
 namespace KWin
 {
 class LanczosFilter;
@@ -48,6 +52,8 @@ public:
     virtual bool initFailed() const;
     virtual bool hasPendingFlush() const;
     virtual qint64 paint(QRegion damage, ToplevelList windows);
+    bool supportsOutputPainting() const override;
+    qint64 paintOutput(int screenId, QRegion damage, ToplevelList windows) override;
     virtual Scene::EffectFrame *createEffectFrame(EffectFrameImpl *frame);
     virtual Shadow *createShadow(Toplevel *toplevel);
     virtual void screenGeometryChanged(const QSize &size);
@@ -100,11 +106,21 @@ protected:
     bool init_ok;
 private:
     bool viewportLimitsMatched(const QSize &size) const;
+    /**
+     * Renders and presents the screen @p screenId in per screen rendering mode.
+     * @returns @c false if a graphics reset got detected.
+     **/
+    bool paintScreenOnBackend(int screenId, const QRegion &damage);
+    void finishFrame();
 private:
     bool m_debug;
     OpenGLBackend *m_backend;
     SyncManager *m_syncManager;
     SyncObject *m_currentFence;
+    // per screen, damage only presented on overlay planes which the last rendered frame lacks
+    QHash<int, QRegion> m_overlayDamage;
+    // shared by the decoration renderers, outlives the scene if they do
+    QSharedPointer<GLTextureAtlas> m_decorationAtlas;
 };
 
 class SceneOpenGL2 : public SceneOpenGL
@@ -119,8 +135,17 @@ public:
 
     static bool supported(OpenGLBackend *backend);
 
+    void idle() override;
+
     QMatrix4x4 projectionMatrix() const override { return m_projectionMatrix; }
     QMatrix4x4 screenProjectionMatrix() const override { return m_screenProjectionMatrix; }
+    /**
+     * The list windows record their draws into, only enabled while painting a frame
+     * in which no Effect takes part.
+     **/
+    WindowDrawList *drawList() {
+        return &m_drawList;
+    }
 
 protected:
     virtual void paintSimpleScreen(int mask, QRegion region);
@@ -134,6 +159,13 @@ protected:
 private:
     void performPaintWindow(EffectWindowImpl* w, int mask, QRegion region, WindowPaintData& data);
     QMatrix4x4 createProjectionMatrix() const;
+    /**
+     * Creates the next of the shaders for the common trait combinations while the compositor
+     * is idle, instead of when a window or effect first needs them.
+     **/
+    void precompileShaders();
+    void beginDrawList();
+    void endDrawList();
 
 private:
     LanczosFilter *m_lanczosFilter;
@@ -141,6 +173,10 @@ private:
     QMatrix4x4 m_projectionMatrix;
     QMatrix4x4 m_screenProjectionMatrix;
     GLuint vao;
+    WindowDrawList m_drawList;
+    // runs while idle until all shaders got precompiled
+    QTimer *m_precompileTimer = nullptr;
+    int m_precompiledShaders = 0;
 };
 
 class SceneOpenGL::Window
@@ -148,7 +184,11 @@ class SceneOpenGL::Window
 {
 public:
     virtual ~Window();
-    bool beginRenderWindow(int mask, const QRegion &region, WindowPaintData &data);
+    /**
+     * Clips the quads in @p data to @p region or enables scissoring, whichever is cheaper.
+     * @p region may get reduced to the part covered by the window.
+     **/
+    bool beginRenderWindow(int mask, QRegion &region, WindowPaintData &data);
     virtual void performPaint(int mask, QRegion region, WindowPaintData data) = 0;
     void endRenderWindow();
     bool bindTexture();
@@ -166,7 +206,10 @@ protected:
     };
 
     QMatrix4x4 transformation(int mask, const WindowPaintData &data) const;
-    GLTexture *getDecorationTexture() const;
+    /**
+     * @p textureOffset is set to the position of the decoration in the returned texture.
+     **/
+    GLTexture *getDecorationTexture(QPoint *textureOffset) const;
 
 protected:
     SceneOpenGL *m_scene;
@@ -193,6 +236,8 @@ public:
         }
 
         GLTexture *texture;
+        // where the unnormalized texture coordinates start in texture
+        QPoint textureOffset;
         int firstVertex;
         int vertexCount;
         float opacity;
@@ -207,7 +252,8 @@ protected:
     QMatrix4x4 modelViewProjectionMatrix(int mask, const WindowPaintData &data) const;
     QVector4D modulate(float opacity, float brightness) const;
     void setBlendEnabled(bool enabled);
-    void setupLeafNodes(LeafNode *nodes, const WindowQuadList *quads, const WindowPaintData &data);
+    void setupLeafNodes(LeafNode *nodes, const WindowQuadBuffer *quads, const WindowPaintData &data);
+    static QMatrix4x4 textureMatrix(const LeafNode &node);
     virtual void performPaint(int mask, QRegion region, WindowPaintData data);
 
 private:
@@ -216,6 +262,10 @@ private:
      * Whether prepareStates enabled blending and restore states should disable again.
      **/
     bool m_blendingEnabled;
+    /**
+     * The quads of the last paint split by leaf, kept to reuse their memory.
+     **/
+    WindowQuadBuffer m_leafQuads[LeafCount];
 };
 
 class OpenGLWindowPixmap : public WindowPixmap
@@ -306,22 +356,31 @@ public:
         Bottom,
         Count
     };
-    explicit SceneOpenGLDecorationRenderer(Decoration::DecoratedClientImpl *client);
+    /**
+     * The texture gets allocated in @p atlas if possible.
+     **/
+    explicit SceneOpenGLDecorationRenderer(Decoration::DecoratedClientImpl *client, const QSharedPointer<GLTextureAtlas> &atlas);
     virtual ~SceneOpenGLDecorationRenderer();
 
     void render() override;
     void reparent(Deleted *deleted) override;
 
-    GLTexture *texture() {
-        return m_texture.data();
-    }
-    GLTexture *texture() const {
-        return m_texture.data();
-    }
+    /**
+     * The texture holding the decoration, it can be a page of the atlas shared
+     * with other decorations.
+     **/
+    GLTexture *texture() const;
+    /**
+     * The position of the decoration in texture().
+     **/
+    QPoint textureOffset() const;
 
 private:
     void resizeTexture();
+    void releaseTexture();
     QScopedPointer<GLTexture> m_texture;
+    QSharedPointer<GLTextureAtlas> m_atlas;
+    quint32 m_atlasId = 0;
 };
 
 inline bool SceneOpenGL::hasPendingFlush() const
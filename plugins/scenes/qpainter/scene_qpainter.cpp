@@ -122,6 +122,7 @@ qint64 SceneQPainter::paint(QRegion damage, ToplevelList toplevels)
             m_painter->restore();
             m_painter->end();
         }
+        enterFramePhase(FrameTelemetry::Phase::Swap);
         m_backend->showOverlay();
         m_backend->present(mask, overallUpdate);
     } else {
@@ -139,6 +140,7 @@ qint64 SceneQPainter::paint(QRegion damage, ToplevelList toplevels)
         m_backend->showOverlay();
 
         m_painter->end();
+        enterFramePhase(FrameTelemetry::Phase::Swap);
         m_backend->present(mask, updateRegion);
     }
 
@@ -260,6 +260,7 @@ qint64 SceneXrender::paint(QRegion damage, ToplevelList toplevels)
 
     m_backend->showOverlay();
 
+    enterFramePhase(FrameTelemetry::Phase::Swap);
     m_backend->present(mask, updateRegion);
     // do cleanup
     clearStackingOrder();
@@ -0,0 +1,227 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "presentationtime.h"
+
+#include <KWayland/Server/display.h>
+#include <KWayland/Server/subcompositor_interface.h>
+#include <KWayland/Server/surface_interface.h>
+
+#include <wayland-server.h>
+#include "wayland-presentation-time-server-protocol.h"
+
+#include <algorithm>
+
+#include <time.h>
+
+namespace KWin
+{
+
+static const quint32 s_version = 1;
+static const qint64 s_nanoPerSecond = 1000000000;
+
+const struct wp_presentation_interface PresentationTime::s_interface = {
+    PresentationTime::destroyCallback,
+    PresentationTime::feedbackCallback
+};
+
+PresentationTime::PresentationTime(KWayland::Server::Display *display, QObject *parent)
+    : QObject(parent)
+{
+    m_global = wl_global_create(*display, &wp_presentation_interface, s_version, this, &PresentationTime::bind);
+    connect(display, &KWayland::Server::Display::aboutToTerminate, this, &PresentationTime::destroyGlobal);
+}
+
+PresentationTime::~PresentationTime()
+{
+    destroyGlobal();
+    // the clients keep their feedbacks, they just won't hear of them anymore
+    auto orphan = [] (const QVector<wl_resource*> &feedbacks) {
+        for (wl_resource *feedback : feedbacks) {
+            wl_resource_set_user_data(feedback, nullptr);
+        }
+    };
+    std::for_each(m_pending.constBegin(), m_pending.constEnd(), orphan);
+    std::for_each(m_committed.constBegin(), m_committed.constEnd(), orphan);
+    std::for_each(m_painted.constBegin(), m_painted.constEnd(), orphan);
+    for (const auto &frames : qAsConst(m_queued)) {
+        std::for_each(frames.constBegin(), frames.constEnd(), orphan);
+    }
+}
+
+void PresentationTime::destroyGlobal()
+{
+    if (m_global) {
+        wl_global_destroy(m_global);
+        m_global = nullptr;
+    }
+}
+
+void PresentationTime::bind(wl_client *client, void *data, uint32_t version, uint32_t id)
+{
+    wl_resource *resource = wl_resource_create(client, &wp_presentation_interface, qMin(version, s_version), id);
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(resource, &s_interface, data, nullptr);
+    wp_presentation_send_clock_id(resource, CLOCK_MONOTONIC);
+}
+
+void PresentationTime::destroyCallback(wl_client *client, wl_resource *resource)
+{
+    Q_UNUSED(client)
+    wl_resource_destroy(resource);
+}
+
+void PresentationTime::feedbackCallback(wl_client *client, wl_resource *resource, wl_resource *surface, uint32_t callback)
+{
+    auto p = reinterpret_cast<PresentationTime*>(wl_resource_get_user_data(resource));
+    wl_resource *feedback = wl_resource_create(client, &wp_presentation_feedback_interface, wl_resource_get_version(resource), callback);
+    if (!feedback) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(feedback, nullptr, p, &PresentationTime::destroyFeedback);
+
+    using KWayland::Server::SurfaceInterface;
+    SurfaceInterface *s = SurfaceInterface::get(surface);
+    if (!s) {
+        sendDiscarded({feedback});
+        return;
+    }
+    p->m_pending[s] << feedback;
+    // the next commit with new content is the content update the feedback belongs to
+    connect(s, &SurfaceInterface::damaged, p, &PresentationTime::surfaceDamaged, Qt::UniqueConnection);
+    connect(s, &QObject::destroyed, p, &PresentationTime::surfaceDestroyed, Qt::UniqueConnection);
+}
+
+void PresentationTime::destroyFeedback(wl_resource *resource)
+{
+    if (auto p = reinterpret_cast<PresentationTime*>(wl_resource_get_user_data(resource))) {
+        p->removeFeedback(resource);
+    }
+}
+
+void PresentationTime::removeFeedback(wl_resource *feedback)
+{
+    auto remove = [feedback] (auto &hash) {
+        for (auto it = hash.begin(); it != hash.end();) {
+            it.value().removeOne(feedback);
+            if (it.value().isEmpty()) {
+                it = hash.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    };
+    remove(m_pending);
+    remove(m_committed);
+    remove(m_painted);
+    for (auto &frames : m_queued) {
+        // keep empty frames, they still stand for a frame on its way to the screen
+        for (auto &frame : frames) {
+            frame.removeOne(feedback);
+        }
+    }
+}
+
+void PresentationTime::sendDiscarded(const QVector<wl_resource*> &feedbacks)
+{
+    for (wl_resource *feedback : feedbacks) {
+        wp_presentation_feedback_send_discarded(feedback);
+        wl_resource_destroy(feedback);
+    }
+}
+
+void PresentationTime::surfaceDamaged()
+{
+    auto surface = qobject_cast<KWayland::Server::SurfaceInterface*>(sender());
+    if (!surface) {
+        return;
+    }
+    const QVector<wl_resource*> pending = m_pending.take(surface);
+    // content which was never painted got replaced
+    sendDiscarded(m_committed.take(surface));
+    if (!pending.isEmpty()) {
+        m_committed.insert(surface, pending);
+    }
+}
+
+void PresentationTime::surfaceDestroyed(QObject *surface)
+{
+    // only used as key, the surface is already gone
+    auto s = static_cast<KWayland::Server::SurfaceInterface*>(surface);
+    sendDiscarded(m_pending.take(s));
+    sendDiscarded(m_committed.take(s));
+}
+
+void PresentationTime::frameRendered(AbstractOutput *output, KWayland::Server::SurfaceInterface *surface)
+{
+    const QVector<wl_resource*> committed = m_committed.take(surface);
+    if (!committed.isEmpty()) {
+        m_painted[output] << committed;
+    }
+    const auto children = surface->childSubSurfaces();
+    for (const auto &child : children) {
+        if (child && child->surface()) {
+            frameRendered(output, child->surface().data());
+        }
+    }
+}
+
+void PresentationTime::frameSubmitted(AbstractOutput *output)
+{
+    m_queued[output] << m_painted.take(output);
+}
+
+QVector<wl_resource*> PresentationTime::takeOldestFrame(AbstractOutput *output)
+{
+    auto it = m_queued.find(output);
+    if (it == m_queued.end()) {
+        return QVector<wl_resource*>();
+    }
+    const QVector<wl_resource*> feedbacks = it.value().takeFirst();
+    if (it.value().isEmpty()) {
+        m_queued.erase(it);
+    }
+    return feedbacks;
+}
+
+void PresentationTime::presented(AbstractOutput *output, qint64 timestamp, qint64 refresh, quint64 sequence, Kinds kinds)
+{
+    const QVector<wl_resource*> feedbacks = takeOldestFrame(output);
+    const quint64 seconds = timestamp / s_nanoPerSecond;
+    for (wl_resource *feedback : feedbacks) {
+        wp_presentation_feedback_send_presented(feedback,
+                                                seconds >> 32, seconds & 0xffffffff,
+                                                timestamp % s_nanoPerSecond,
+                                                refresh,
+                                                sequence >> 32, sequence & 0xffffffff,
+                                                uint32_t(kinds));
+        wl_resource_destroy(feedback);
+    }
+}
+
+void PresentationTime::discarded(AbstractOutput *output)
+{
+    sendDiscarded(takeOldestFrame(output));
+}
+
+}
@@ -0,0 +1,129 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#ifndef KWIN_PRESENTATIONTIME_H
+#define KWIN_PRESENTATIONTIME_H
+
+#include <kwin_export.h>
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QVector>
+
+struct wl_client;
+struct wl_global;
+struct wl_resource;
+struct wp_presentation_interface;
+
+namespace KWayland
+{
+namespace Server
+{
+class Display;
+class SurfaceInterface;
+}
+}
+
+namespace KWin
+{
+
+class AbstractOutput;
+
+/**
+ * @brief Implements the wp_presentation global of the presentation-time protocol.
+ *
+ * A feedback requested by a client belongs to the next content update of the surface.
+ * Once the Compositor painted the surface it hands the feedback over to the output the
+ * surface got painted on with frameRendered. The frame is queued for the output with
+ * frameSubmitted. An output can have several frames waiting for scanout, they reach the
+ * screen in the order they got submitted. When the oldest one does the Compositor reports
+ * the presentation time with presented, at which point the feedback is sent to the client.
+ * Feedbacks for content which got replaced before it was painted are discarded.
+ *
+ * The clock is CLOCK_MONOTONIC, like the one of the VBlankClock.
+ **/
+class KWIN_EXPORT PresentationTime : public QObject
+{
+    Q_OBJECT
+public:
+    enum class Kind {
+        VSync = 0x1,
+        HwClock = 0x2,
+        HwCompletion = 0x4,
+        ZeroCopy = 0x8
+    };
+    Q_DECLARE_FLAGS(Kinds, Kind)
+
+    explicit PresentationTime(KWayland::Server::Display *display, QObject *parent = nullptr);
+    virtual ~PresentationTime();
+
+    /**
+     * The current content of @p surface and its sub-surfaces got painted for @p output.
+     * @p output is @c nullptr if the frame covers all outputs.
+     **/
+    void frameRendered(AbstractOutput *output, KWayland::Server::SurfaceInterface *surface);
+    /**
+     * Everything rendered for @p output since the last call got handed over to the output
+     * as one frame.
+     **/
+    void frameSubmitted(AbstractOutput *output);
+    /**
+     * The oldest frame submitted for @p output is visible since @p timestamp. @p refresh is
+     * the duration of the refresh cycle, @p sequence the hardware vblank counter, both
+     * @c 0 if unknown.
+     **/
+    void presented(AbstractOutput *output, qint64 timestamp, qint64 refresh, quint64 sequence, Kinds kinds);
+    /**
+     * The oldest frame submitted for @p output will never be shown.
+     **/
+    void discarded(AbstractOutput *output);
+
+private Q_SLOTS:
+    void surfaceDamaged();
+    void surfaceDestroyed(QObject *surface);
+
+private:
+    static void bind(wl_client *client, void *data, uint32_t version, uint32_t id);
+    static void destroyCallback(wl_client *client, wl_resource *resource);
+    static void feedbackCallback(wl_client *client, wl_resource *resource, wl_resource *surface, uint32_t callback);
+    static void destroyFeedback(wl_resource *resource);
+    void destroyGlobal();
+    void removeFeedback(wl_resource *feedback);
+    QVector<wl_resource*> takeOldestFrame(AbstractOutput *output);
+    static void sendDiscarded(const QVector<wl_resource*> &feedbacks);
+
+    static const struct wp_presentation_interface s_interface;
+
+    wl_global *m_global = nullptr;
+    // requested, but the surface did not commit new content yet
+    QHash<KWayland::Server::SurfaceInterface*, QVector<wl_resource*>> m_pending;
+    // the surface committed, but was not painted yet
+    QHash<KWayland::Server::SurfaceInterface*, QVector<wl_resource*>> m_committed;
+    // painted, but the frame was not submitted yet
+    QHash<AbstractOutput*, QVector<wl_resource*>> m_painted;
+    // the frames waiting for the presentation of the output, oldest first
+    QHash<AbstractOutput*, QList<QVector<wl_resource*>>> m_queued;
+};
+
+}
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(KWin::PresentationTime::Kinds)
+
+#endif
@@ -0,0 +1,494 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "rectregion.h"
+
+#include <algorithm>
+#include <climits>
+
+namespace KWin
+{
+
+typedef RectRegion::Box Box;
+
+static inline Box toBox(const QRect &rect)
+{
+    return Box{rect.x(), rect.y(), rect.x() + rect.width(), rect.y() + rect.height()};
+}
+
+static inline QRect toRect(const Box &box)
+{
+    return QRect(box.x1, box.y1, box.x2 - box.x1, box.y2 - box.y1);
+}
+
+static inline bool boxContains(const Box &outer, const Box &inner)
+{
+    return outer.x1 <= inner.x1 && outer.y1 <= inner.y1 && outer.x2 >= inner.x2 && outer.y2 >= inner.y2;
+}
+
+static inline bool boxIntersects(const Box &a, const Box &b)
+{
+    return a.x1 < b.x2 && b.x1 < a.x2 && a.y1 < b.y2 && b.y1 < a.y2;
+}
+
+static inline const Box *bandEnd(const Box *band, const Box *end)
+{
+    const int y1 = band->y1;
+    while (band != end && band->y1 == y1) {
+        ++band;
+    }
+    return band;
+}
+
+/**
+ * Merges the band [@p current, @p currentEnd) into the band starting at @p previous if it
+ * continues it downwards with the same spans.
+ * @returns the start of the last band
+ **/
+static size_t coalesce(std::vector<Box> &boxes, size_t previous, size_t current, size_t currentEnd)
+{
+    if (current == currentEnd) {
+        // nothing got added
+        return previous;
+    }
+    const size_t count = currentEnd - current;
+    if (previous == current || current - previous != count || boxes[previous].y2 != boxes[current].y1) {
+        return current;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (boxes[previous + i].x1 != boxes[current + i].x1 || boxes[previous + i].x2 != boxes[current + i].x2) {
+            return current;
+        }
+    }
+    const int y2 = boxes[current].y2;
+    for (size_t i = 0; i < count; ++i) {
+        boxes[previous + i].y2 = y2;
+    }
+    boxes.erase(boxes.begin() + current, boxes.begin() + currentEnd);
+    return previous;
+}
+
+/**
+ * Adds the spans of the slab from @p y1 to @p y2 for which @p keep is true, given whether
+ * they are covered by the spans of @p a and @p b.
+ **/
+template <typename Keep>
+static void combineSpans(const Box *a, const Box *aEnd, const Box *b, const Box *bEnd,
+                         int y1, int y2, Keep keep, std::vector<Box> &out)
+{
+    const size_t bandStart = out.size();
+    int x = INT_MAX;
+    if (a != aEnd) {
+        x = a->x1;
+    }
+    if (b != bEnd) {
+        x = std::min(x, b->x1);
+    }
+    while (a != aEnd || b != bEnd) {
+        const bool inA = a != aEnd && a->x1 <= x;
+        const bool inB = b != bEnd && b->x1 <= x;
+        // the next position at which one of the inputs starts or ends a span
+        int next = INT_MAX;
+        if (a != aEnd) {
+            next = std::min(next, inA ? a->x2 : a->x1);
+        }
+        if (b != bEnd) {
+            next = std::min(next, inB ? b->x2 : b->x1);
+        }
+        if (keep(inA, inB)) {
+            if (out.size() > bandStart && out.back().x2 == x) {
+                out.back().x2 = next;
+            } else {
+                out.push_back(Box{x, y1, next, y2});
+            }
+        }
+        x = next;
+        if (a != aEnd && a->x2 <= x) {
+            ++a;
+        }
+        if (b != bEnd && b->x2 <= x) {
+            ++b;
+        }
+    }
+}
+
+/**
+ * Walks both band lists from top to bottom. Each slab between two consecutive horizontal
+ * edges of either input becomes one output band.
+ **/
+template <typename Keep>
+static void combineBands(const Box *a, const Box *aEnd, const Box *b, const Box *bEnd,
+                         Keep keep, bool needsA, bool needsB, std::vector<Box> &out)
+{
+    out.clear();
+    size_t previousBand = 0;
+    const Box *aBandEnd = a != aEnd ? bandEnd(a, aEnd) : aEnd;
+    const Box *bBandEnd = b != bEnd ? bandEnd(b, bEnd) : bEnd;
+    int y = INT_MIN;
+    while (a != aEnd || b != bEnd) {
+        if ((needsA && a == aEnd) || (needsB && b == bEnd)) {
+            // nothing of what is left can end up in the result
+            break;
+        }
+        const int aTop = a != aEnd ? std::max(a->y1, y) : INT_MAX;
+        const int bTop = b != bEnd ? std::max(b->y1, y) : INT_MAX;
+        const int top = std::min(aTop, bTop);
+        int bottom = INT_MAX;
+        if (a != aEnd) {
+            bottom = std::min(bottom, aTop > top ? aTop : a->y2);
+        }
+        if (b != bEnd) {
+            bottom = std::min(bottom, bTop > top ? bTop : b->y2);
+        }
+        const bool inA = aTop == top && a != aEnd;
+        const bool inB = bTop == top && b != bEnd;
+
+        const size_t bandStart = out.size();
+        // an input which does not cover the slab is passed as an empty band
+        combineSpans(inA ? a : aBandEnd, aBandEnd, inB ? b : bBandEnd, bBandEnd, top, bottom, keep, out);
+        previousBand = coalesce(out, previousBand, bandStart, out.size());
+
+        y = bottom;
+        if (a != aEnd && a->y2 <= y) {
+            a = aBandEnd;
+            aBandEnd = a != aEnd ? bandEnd(a, aEnd) : aEnd;
+        }
+        if (b != bEnd && b->y2 <= y) {
+            b = bBandEnd;
+            bBandEnd = b != bEnd ? bandEnd(b, bEnd) : bEnd;
+        }
+    }
+}
+
+RectRegion::RectRegion(const QRect &rect)
+{
+    setRect(rect);
+}
+
+RectRegion::RectRegion(const QRegion &region)
+{
+    setRegion(region);
+}
+
+void RectRegion::clear()
+{
+    m_boxes.clear();
+}
+
+void RectRegion::setRect(const QRect &rect)
+{
+    m_boxes.clear();
+    if (rect.isEmpty()) {
+        return;
+    }
+    m_bounds = toBox(rect);
+    m_boxes.push_back(m_bounds);
+}
+
+void RectRegion::setRegion(const QRegion &region)
+{
+    m_boxes.clear();
+    if (region.isEmpty()) {
+        return;
+    }
+    m_boxes.reserve(region.rectCount());
+    // QRegion is banded the same way, but does not promise to merge all bands
+    size_t previousBand = 0;
+    size_t bandStart = 0;
+    for (const QRect &rect : region) {
+        const Box box = toBox(rect);
+        if (!m_boxes.empty() && m_boxes.back().y1 != box.y1) {
+            previousBand = coalesce(m_boxes, previousBand, bandStart, m_boxes.size());
+            bandStart = m_boxes.size();
+        }
+        m_boxes.push_back(box);
+    }
+    coalesce(m_boxes, previousBand, bandStart, m_boxes.size());
+    updateBounds();
+}
+
+void RectRegion::updateBounds()
+{
+    if (m_boxes.empty()) {
+        return;
+    }
+    int x1 = INT_MAX;
+    int x2 = INT_MIN;
+    for (const Box &box : m_boxes) {
+        x1 = std::min(x1, box.x1);
+        x2 = std::max(x2, box.x2);
+    }
+    m_bounds = Box{x1, m_boxes.front().y1, x2, m_boxes.back().y2};
+}
+
+QRect RectRegion::boundingRect() const
+{
+    if (m_boxes.empty()) {
+        return QRect();
+    }
+    return toRect(m_bounds);
+}
+
+QRegion RectRegion::toRegion() const
+{
+    QRegion region;
+    if (m_boxes.empty()) {
+        return region;
+    }
+    if (m_boxes.size() == 1) {
+        return QRegion(toRect(m_boxes.front()));
+    }
+    static thread_local std::vector<QRect> rects;
+    rects.resize(m_boxes.size());
+    std::transform(m_boxes.cbegin(), m_boxes.cend(), rects.begin(), toRect);
+    region.setRects(rects.data(), int(rects.size()));
+    return region;
+}
+
+bool RectRegion::contains(const QRect &rect) const
+{
+    if (rect.isEmpty()) {
+        return true;
+    }
+    const Box wanted = toBox(rect);
+    if (m_boxes.empty() || !boxContains(m_bounds, wanted)) {
+        return false;
+    }
+    // the bottom edges grow monotonically as well
+    const Box *box = std::lower_bound(begin(), end(), wanted.y1,
+        [] (const Box &b, int y) {
+            return b.y2 <= y;
+        }
+    );
+    int y = wanted.y1;
+    while (box != end()) {
+        if (box->y1 > y) {
+            // a gap between two bands
+            return false;
+        }
+        const Box *last = bandEnd(box, end());
+        // spans of a band never touch, so one of them has to cover it all
+        const Box *span = std::find_if(box, last,
+            [&wanted] (const Box &b) {
+                return b.x2 > wanted.x1;
+            }
+        );
+        if (span == last || span->x1 > wanted.x1 || span->x2 < wanted.x2) {
+            return false;
+        }
+        y = box->y2;
+        if (y >= wanted.y2) {
+            return true;
+        }
+        box = last;
+    }
+    return false;
+}
+
+bool RectRegion::contains(const RectRegion &other) const
+{
+    if (other.isEmpty()) {
+        return true;
+    }
+    if (isEmpty() || !boxContains(m_bounds, other.m_bounds)) {
+        return false;
+    }
+    return std::all_of(other.begin(), other.end(),
+        [this] (const Box &box) {
+            return contains(toRect(box));
+        }
+    );
+}
+
+bool RectRegion::intersects(const QRect &rect) const
+{
+    if (rect.isEmpty() || m_boxes.empty()) {
+        return false;
+    }
+    const Box wanted = toBox(rect);
+    if (!boxIntersects(m_bounds, wanted)) {
+        return false;
+    }
+    const Box *box = std::lower_bound(begin(), end(), wanted.y1,
+        [] (const Box &b, int y) {
+            return b.y2 <= y;
+        }
+    );
+    for (; box != end() && box->y1 < wanted.y2; ++box) {
+        if (boxIntersects(*box, wanted)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void RectRegion::append(const RectRegion &below)
+{
+    const size_t junction = m_boxes.size();
+    size_t lastBand = junction - 1;
+    while (lastBand > 0 && m_boxes[lastBand - 1].y1 == m_boxes[junction - 1].y1) {
+        --lastBand;
+    }
+    m_boxes.insert(m_boxes.end(), below.m_boxes.cbegin(), below.m_boxes.cend());
+    const size_t firstBandEnd = bandEnd(m_boxes.data() + junction, m_boxes.data() + m_boxes.size()) - m_boxes.data();
+    coalesce(m_boxes, lastBand, junction, firstBandEnd);
+    m_bounds.x1 = std::min(m_bounds.x1, below.m_bounds.x1);
+    m_bounds.x2 = std::max(m_bounds.x2, below.m_bounds.x2);
+    m_bounds.y2 = below.m_bounds.y2;
+}
+
+void RectRegion::combine(const RectRegion &other, Operation operation)
+{
+    static thread_local std::vector<Box> scratch;
+    const Box *a = begin();
+    const Box *aEnd = end();
+    const Box *b = other.begin();
+    const Box *bEnd = other.end();
+    switch (operation) {
+    case Operation::Union:
+        combineBands(a, aEnd, b, bEnd, [] (bool inA, bool inB) { return inA || inB; }, false, false, scratch);
+        break;
+    case Operation::Subtract:
+        combineBands(a, aEnd, b, bEnd, [] (bool inA, bool inB) { return inA && !inB; }, true, false, scratch);
+        break;
+    case Operation::Intersect:
+        combineBands(a, aEnd, b, bEnd, [] (bool inA, bool inB) { return inA && inB; }, true, true, scratch);
+        break;
+    }
+    // the old boxes become the scratch buffer of the next operation
+    m_boxes.swap(scratch);
+    updateBounds();
+}
+
+RectRegion &RectRegion::operator|=(const RectRegion &other)
+{
+    if (other.isEmpty() || &other == this) {
+        return *this;
+    }
+    if (isEmpty()) {
+        m_boxes = other.m_boxes;
+        m_bounds = other.m_bounds;
+        return *this;
+    }
+    if (m_boxes.size() == 1 && boxContains(m_bounds, other.m_bounds)) {
+        return *this;
+    }
+    if (other.m_boxes.size() == 1 && boxContains(other.m_bounds, m_bounds)) {
+        m_boxes = other.m_boxes;
+        m_bounds = other.m_bounds;
+        return *this;
+    }
+    if (other.m_bounds.y1 >= m_bounds.y2) {
+        // typical when collecting the rects of a region top to bottom
+        append(other);
+        return *this;
+    }
+    combine(other, Operation::Union);
+    return *this;
+}
+
+RectRegion &RectRegion::operator|=(const QRect &rect)
+{
+    if (rect.isEmpty()) {
+        return *this;
+    }
+    if (isEmpty()) {
+        setRect(rect);
+        return *this;
+    }
+    if (contains(rect)) {
+        return *this;
+    }
+    static thread_local RectRegion single;
+    single.setRect(rect);
+    return *this |= single;
+}
+
+RectRegion &RectRegion::operator-=(const RectRegion &other)
+{
+    if (isEmpty() || other.isEmpty()) {
+        return *this;
+    }
+    if (&other == this) {
+        clear();
+        return *this;
+    }
+    if (!boxIntersects(m_bounds, other.m_bounds)) {
+        return *this;
+    }
+    if (other.m_boxes.size() == 1 && boxContains(other.m_bounds, m_bounds)) {
+        clear();
+        return *this;
+    }
+    combine(other, Operation::Subtract);
+    return *this;
+}
+
+RectRegion &RectRegion::operator&=(const RectRegion &other)
+{
+    if (&other == this || isEmpty()) {
+        return *this;
+    }
+    if (other.isEmpty() || !boxIntersects(m_bounds, other.m_bounds)) {
+        clear();
+        return *this;
+    }
+    if (other.m_boxes.size() == 1 && boxContains(other.m_bounds, m_bounds)) {
+        return *this;
+    }
+    if (m_boxes.size() == 1 && boxContains(m_bounds, other.m_bounds)) {
+        m_boxes = other.m_boxes;
+        m_bounds = other.m_bounds;
+        return *this;
+    }
+    combine(other, Operation::Intersect);
+    return *this;
+}
+
+RectRegion RectRegion::operator|(const RectRegion &other) const
+{
+    RectRegion result = *this;
+    result |= other;
+    return result;
+}
+
+RectRegion RectRegion::operator-(const RectRegion &other) const
+{
+    RectRegion result = *this;
+    result -= other;
+    return result;
+}
+
+RectRegion RectRegion::operator&(const RectRegion &other) const
+{
+    RectRegion result = *this;
+    result &= other;
+    return result;
+}
+
+bool RectRegion::operator==(const RectRegion &other) const
+{
+    return std::equal(m_boxes.cbegin(), m_boxes.cend(), other.m_boxes.cbegin(), other.m_boxes.cend(),
+        [] (const Box &a, const Box &b) {
+            return a.x1 == b.x1 && a.y1 == b.y1 && a.x2 == b.x2 && a.y2 == b.y2;
+        }
+    );
+}
+
+}
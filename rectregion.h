@@ -0,0 +1,128 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#ifndef KWIN_RECTREGION_H
+#define KWIN_RECTREGION_H
+
+#include <kwin_export.h>
+
+#include <QRect>
+#include <QRegion>
+
+#include <vector>
+
+namespace KWin
+{
+
+/**
+ * @brief A region stored as a flat list of y-x banded rectangles.
+ *
+ * The rectangles are sorted by their top edge, then by their left edge. Rectangles with the
+ * same top edge form a band and have the same height, rectangles of a band neither overlap
+ * nor touch. Vertically adjacent bands with the same horizontal spans are merged. This is the
+ * layout QRegion uses internally as well, so converting between the two is a plain copy.
+ *
+ * Unlike QRegion the rectangles are not implicitly shared. Every operation builds its result
+ * in a per thread scratch buffer which is swapped with the storage of the region afterwards,
+ * so once the buffers grew to the size of a frame's regions no allocations happen anymore.
+ * The scene keeps its regions across frames for the same reason.
+ *
+ * The operations have fast paths for the common cases of the occlusion pass: disjoint
+ * bounding rectangles, a region which lies completely below another one and a single
+ * rectangle covering everything.
+ **/
+class KWIN_EXPORT RectRegion
+{
+public:
+    /**
+     * A rectangle with exclusive right and bottom edges.
+     **/
+    struct Box {
+        int x1;
+        int y1;
+        int x2;
+        int y2;
+    };
+
+    RectRegion() = default;
+    explicit RectRegion(const QRect &rect);
+    explicit RectRegion(const QRegion &region);
+
+    bool isEmpty() const {
+        return m_boxes.empty();
+    }
+    int rectCount() const {
+        return int(m_boxes.size());
+    }
+    const Box *begin() const {
+        return m_boxes.data();
+    }
+    const Box *end() const {
+        return m_boxes.data() + m_boxes.size();
+    }
+    QRect boundingRect() const;
+    QRegion toRegion() const;
+
+    /**
+     * Empties the region but keeps the memory for the next use.
+     **/
+    void clear();
+    void setRect(const QRect &rect);
+    void setRegion(const QRegion &region);
+
+    /**
+     * @returns whether @p rect is covered completely.
+     **/
+    bool contains(const QRect &rect) const;
+    /**
+     * @returns whether @p other is covered completely.
+     **/
+    bool contains(const RectRegion &other) const;
+    bool intersects(const QRect &rect) const;
+
+    RectRegion &operator|=(const RectRegion &other);
+    RectRegion &operator|=(const QRect &rect);
+    RectRegion &operator-=(const RectRegion &other);
+    RectRegion &operator&=(const RectRegion &other);
+    RectRegion operator|(const RectRegion &other) const;
+    RectRegion operator-(const RectRegion &other) const;
+    RectRegion operator&(const RectRegion &other) const;
+    bool operator==(const RectRegion &other) const;
+    bool operator!=(const RectRegion &other) const {
+        return !(*this == other);
+    }
+
+private:
+    enum class Operation {
+        Union,
+        Subtract,
+        Intersect
+    };
+    void combine(const RectRegion &other, Operation operation);
+    void append(const RectRegion &below);
+    void updateBounds();
+
+    std::vector<Box> m_boxes;
+    // exclusive like the boxes, only valid if not empty
+    Box m_bounds = {0, 0, 0, 0};
+};
+
+}
+
+#endif
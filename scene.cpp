@@ -70,11 +70,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <QQuickWindow>
 #include <QVector2D>
+#include <QtConcurrentMap>
 
 #include "client.h"
+#include "composite.h"
 #include "deleted.h"
 #include "effects.h"
+#include "main.h"
 #include "overlaywindow.h"
+#include "platform.h"
 #include "screens.h"
 #include "shadow.h"
 #include "wayland_server.h"
@@ -108,9 +112,11 @@ void Scene::paintScreen(int* mask, const QRegion &damage, const QRegion &repaint
                         QRegion *updateRegion, QRegion *validRegion, const QMatrix4x4 &projection, const QRect &outputGeometry)
 {
     const QSize &screenSize = screens()->size();
-    const QRegion displayRegion(0, 0, screenSize.width(), screenSize.height());
+    const QRect displayRect(0, 0, screenSize.width(), screenSize.height());
+    const QRegion displayRegion(displayRect);
     *mask = (damage == displayRegion) ? 0 : PAINT_SCREEN_REGION;
 
+    enterFramePhase(FrameTelemetry::Phase::PrePaint);
     updateTimeDiff();
     // preparation step
     static_cast<EffectsHandlerImpl*>(effects)->startPaint();
@@ -183,6 +189,133 @@ void Scene::updateTimeDiff()
         time_diff = 1;
 }
 
+void Scene::enterFramePhase(FrameTelemetry::Phase phase)
+{
+    if (Compositor *compositor = Compositor::self()) {
+        compositor->frameTelemetry()->enterPhase(phase);
+    }
+}
+
+bool Scene::canBypassComposition(int screenId) const
+{
+    if (!waylandServer() || waylandServer()->isScreenLocked()) {
+        return false;
+    }
+    // nothing may be painted on top of the surfaces
+    if (kwinApp()->platform()->usesSoftwareCursor() ||
+            static_cast<EffectsHandlerImpl*>(effects)->blocksDirectScanout()) {
+        return false;
+    }
+    return screens()->scale(screenId) == 1 && screens()->orientation(screenId) == Qt::PrimaryOrientation;
+}
+
+KWayland::Server::SurfaceInterface *Scene::directScanoutCandidate(int screenId) const
+{
+    if (!canBypassComposition(screenId)) {
+        return nullptr;
+    }
+    const QRect screenGeometry = screens()->geometry(screenId);
+    for (auto it = stacking_order.crbegin(); it != stacking_order.crend(); ++it) {
+        const Window *w = *it;
+        Toplevel *toplevel = w->window();
+        if (!w->isVisible() || !toplevel->visibleRect().intersects(screenGeometry)) {
+            continue;
+        }
+        // only the topmost window on the screen can be scanned out
+        AbstractClient *c = qobject_cast<AbstractClient*>(toplevel);
+        if (!c || !c->isFullScreen() || c->isDecorated() || c->geometry() != screenGeometry || !w->isOpaque()) {
+            return nullptr;
+        }
+        KWayland::Server::SurfaceInterface *surface = c->surface();
+        if (!surface || !surface->childSubSurfaces().isEmpty()) {
+            return nullptr;
+        }
+        const auto buffer = surface->buffer();
+        if (!buffer || buffer->shmBuffer() || buffer->size() != screenGeometry.size()) {
+            return nullptr;
+        }
+        return surface;
+    }
+    return nullptr;
+}
+
+// walks the sub-surface tree of @p surface from top to bottom
+static void collectOverlayCandidates(KWayland::Server::SurfaceInterface *surface, const QPoint &pos, const QRect &screenGeometry,
+                                     QRegion *occluded, QVector<OverlayCandidate> *candidates)
+{
+    const auto children = surface->childSubSurfaces();
+    for (auto it = children.crbegin(); it != children.crend(); ++it) {
+        const auto &child = *it;
+        if (child && child->surface()) {
+            collectOverlayCandidates(child->surface().data(), pos + child->position(), screenGeometry, occluded, candidates);
+        }
+    }
+    const auto buffer = surface->buffer();
+    if (!buffer) {
+        return;
+    }
+    const QRect geometry(pos, surface->size());
+    if (!occluded->intersects(geometry) && screenGeometry.contains(geometry) &&
+            !buffer->shmBuffer() && !buffer->hasAlphaChannel() && buffer->size() == geometry.size()) {
+        candidates->append({surface, geometry});
+    }
+    *occluded |= geometry;
+}
+
+QVector<OverlayCandidate> Scene::overlayCandidates(int screenId) const
+{
+    QVector<OverlayCandidate> candidates;
+    if (!canBypassComposition(screenId)) {
+        return candidates;
+    }
+    const QRect screenGeometry = screens()->geometry(screenId);
+    // everything painted above the surface checked next
+    QRegion occluded;
+    for (auto it = stacking_order.crbegin(); it != stacking_order.crend(); ++it) {
+        const Window *w = *it;
+        Toplevel *toplevel = w->window();
+        if (!w->isVisible() || !toplevel->visibleRect().intersects(screenGeometry)) {
+            continue;
+        }
+        if (toplevel->surface() && toplevel->opacity() == 1.0) {
+            collectOverlayCandidates(toplevel->surface(), toplevel->pos() + toplevel->clientPos(), screenGeometry,
+                                     &occluded, &candidates);
+        }
+        // decoration and shadow
+        occluded |= toplevel->visibleRect();
+    }
+    return candidates;
+}
+
+void Scene::resetRepaintsAfterDirectScanout(int screenId)
+{
+    const QRect screenGeometry = screens()->geometry(screenId);
+
+    // active effects which allow the scanout still have to advance their animations
+    updateTimeDiff();
+    static_cast<EffectsHandlerImpl*>(effects)->startPaint();
+    ScreenPrePaintData pdata;
+    pdata.mask = 0;
+    pdata.paint = screenGeometry;
+    effects->prePaintScreen(pdata, time_diff);
+
+    for (Window *w : qAsConst(stacking_order)) {
+        Toplevel *toplevel = w->window();
+        const QRegion repaints = toplevel->repaints();
+        if (!repaints.intersects(screenGeometry)) {
+            continue;
+        }
+        toplevel->resetRepaints();
+        // the parts on other outputs still have to be painted there
+        const QRegion remaining = repaints - screenGeometry;
+        if (!remaining.isEmpty()) {
+            toplevel->addLayerRepaint(remaining);
+        }
+    }
+
+    effects->postPaintScreen();
+}
+
 // Painting pass is optimized away.
 void Scene::idle()
 {
@@ -207,7 +340,9 @@ void Scene::paintGenericScreen(int orig_mask, ScreenPaintData)
         paintBackground(infiniteRegion());
     }
     QList< Phase2Data > phase2;
-    foreach (Window * w, stacking_order) { // bottom to top
+    buildWindowQuads(false);
+    for (int i = 0; i < stacking_order.count(); ++i) { // bottom to top
+        Window *w = stacking_order.at(i);
         Toplevel* topw = w->window();
 
         // Reset the repaint_region.
@@ -220,7 +355,7 @@ void Scene::paintGenericScreen(int orig_mask, ScreenPaintData)
         w->resetPaintingEnabled();
         data.paint = infiniteRegion(); // no clipping, so doesn't really matter
         data.clip = QRegion();
-        data.quads = w->buildQuads();
+        data.quads = m_windowQuads.at(i);
         // preparation step
         effects->prePaintWindow(effectWindow(w), data, time_diff);
 #ifndef NDEBUG
@@ -233,9 +368,10 @@ void Scene::paintGenericScreen(int orig_mask, ScreenPaintData)
         }
         phase2.append(Phase2Data(w, infiniteRegion(), data.clip, data.mask, data.quads));
     }
+    enterFramePhase(FrameTelemetry::Phase::Paint);
 
     foreach (const Phase2Data & d, phase2) {
-        paintWindow(d.window, d.mask, d.region, d.quads);
+        paintWindow(d.window, d.mask, d.region.toRegion(), d.quads);
     }
 
     const QSize &screenSize = screens()->size();
@@ -249,7 +385,11 @@ void Scene::paintSimpleScreen(int orig_mask, QRegion region)
 {
     assert((orig_mask & (PAINT_SCREEN_TRANSFORMED
                          | PAINT_SCREEN_WITH_TRANSFORMED_WINDOWS)) == 0);
-    QList< QPair< Window*, Phase2Data > > phase2data;
+    // the entries beyond are left over from previous frames
+    int phase2Count = 0;
+
+    markOccludedWindows();
+    buildWindowQuads(true);
 
     QRegion dirtyArea = region;
     bool opaqueFullscreen(false);
@@ -258,6 +398,11 @@ void Scene::paintSimpleScreen(int orig_mask, QRegion region)
             ++i) {
         Window* w = stacking_order[ i ];
         Toplevel* topw = w->window();
+        if (m_occluded.at(i)) {
+            // neither the effects nor the screen will get to see it
+            topw->resetRepaints();
+            continue;
+        }
         WindowPrePaintData data;
         data.mask = orig_mask | (w->isOpaque() ? PAINT_WINDOW_OPAQUE : PAINT_WINDOW_TRANSLUCENT);
         w->resetPaintingEnabled();
@@ -276,26 +421,9 @@ void Scene::paintSimpleScreen(int orig_mask, QRegion region)
             if (c) {
                 opaqueFullscreen = c->isFullScreen();
             }
-            Client *cc = dynamic_cast<Client*>(c);
-            // the window is fully opaque
-            if (cc && cc->decorationHasAlpha()) {
-                // decoration uses alpha channel, so we may not exclude it in clipping
-                data.clip = w->clientShape().translated(w->x(), w->y());
-            } else {
-                // decoration is fully opaque
-                if (c && c->isShade()) {
-                    data.clip = QRegion();
-                } else {
-                    data.clip = w->shape().translated(w->x(), w->y());
-                }
-            }
-        } else if (topw->hasAlpha() && topw->opacity() == 1.0) {
-            // the window is partially opaque
-            data.clip = (w->clientShape() & topw->opaqueRegion().translated(topw->clientPos())).translated(w->x(), w->y());
-        } else {
-            data.clip = QRegion();
         }
-        data.quads = w->buildQuads();
+        data.clip = opaqueClip(w);
+        data.quads = m_windowQuads.at(i);
         // preparation step
         effects->prePaintWindow(effectWindow(w), data, time_diff);
 #ifndef NDEBUG
@@ -308,9 +436,17 @@ void Scene::paintSimpleScreen(int orig_mask, QRegion region)
         }
         dirtyArea |= data.paint;
         // Schedule the window for painting
-        phase2data.append(QPair< Window*, Phase2Data >(w,Phase2Data(w, data.paint, data.clip,
-                                                                    data.mask, data.quads)));
+        if (phase2Count == m_phase2Data.count()) {
+            m_phase2Data.append(Phase2Data());
+        }
+        Phase2Data &phase2 = m_phase2Data[phase2Count++];
+        phase2.window = w;
+        phase2.region.setRegion(data.paint);
+        phase2.clip.setRegion(data.clip);
+        phase2.mask = data.mask;
+        phase2.quads = data.quads;
     }
+    enterFramePhase(FrameTelemetry::Phase::Paint);
 
     // Save the part of the repaint region that's exclusively rendered to
     // bring a reused back buffer up to date. Then union the dirty region
@@ -326,52 +462,62 @@ void Scene::paintSimpleScreen(int orig_mask, QRegion region)
         fullRepaint = (dirtyArea == displayRegion);
     }
 
-    QRegion allclips, upperTranslucentDamage;
-    upperTranslucentDamage = repaint_region;
+    m_allClips.clear();
+    m_upperTranslucentDamage.setRegion(repaint_region);
+    // whether the opaque windows seen so far hide everything below them
+    bool covered = false;
 
     // This is the occlusion culling pass
-    for (int i = phase2data.count() - 1; i >= 0; --i) {
-        QPair< Window*, Phase2Data > *entry = &phase2data[i];
-        Phase2Data *data = &entry->second;
+    for (int i = phase2Count - 1; i >= 0; --i) {
+        Phase2Data *data = &m_phase2Data[i];
+
+        if (covered) {
+            data->region.clear();
+            continue;
+        }
 
         if (fullRepaint)
-            data->region = displayRegion;
+            data->region.setRect(displayRect);
         else
-            data->region |= upperTranslucentDamage;
+            data->region |= m_upperTranslucentDamage;
 
         // subtract the parts which will possibly been drawn as part of
         // a higher opaque window
-        data->region -= allclips;
+        data->region -= m_allClips;
 
         // Here we rely on WindowPrePaintData::setTranslucent() to remove
         // the clip if needed.
         if (!data->clip.isEmpty() && !(data->mask & PAINT_WINDOW_TRANSFORMED)) {
             // clip away the opaque regions for all windows below this one
-            allclips |= data->clip;
+            m_allClips |= data->clip;
+            covered = m_allClips.contains(displayRect);
             // extend the translucent damage for windows below this by remaining (translucent) regions
-            if (!fullRepaint)
-                upperTranslucentDamage |= data->region - data->clip;
+            if (!fullRepaint && !covered)
+                m_upperTranslucentDamage |= data->region - data->clip;
         } else if (!fullRepaint) {
-            upperTranslucentDamage |= data->region;
+            m_upperTranslucentDamage |= data->region;
         }
     }
 
+    // the windows are painted with a QRegion, which is extended by each window's region
+    // instead of converting the whole painted area again for every window
     QRegion paintedArea;
     // Fill any areas of the root window not covered by opaque windows
     if (!(orig_mask & PAINT_SCREEN_BACKGROUND_FIRST)) {
-        paintedArea = dirtyArea - allclips;
+        m_paintedArea.setRegion(dirtyArea);
+        m_paintedArea -= m_allClips;
+        paintedArea = m_paintedArea.toRegion();
         paintBackground(paintedArea);
     }
 
     // Now walk the list bottom to top and draw the windows.
-    for (int i = 0; i < phase2data.count(); ++i) {
-        Phase2Data *data = &phase2data[i].second;
+    for (int i = 0; i < phase2Count; ++i) {
+        Phase2Data *data = &m_phase2Data[i];
 
         // add all regions which have been drawn so far
-        paintedArea |= data->region;
-        data->region = paintedArea;
+        paintedArea |= data->region.toRegion();
 
-        paintWindow(data->window, data->mask, data->region, data->quads);
+        paintWindow(data->window, data->mask, paintedArea, data->quads);
     }
 
     if (fullRepaint) {
@@ -390,6 +536,99 @@ void Scene::paintSimpleScreen(int orig_mask, QRegion region)
     }
 }
 
+QRegion Scene::opaqueClip(Window *w) const
+{
+    Toplevel* topw = w->window();
+    if (w->isOpaque()) {
+        AbstractClient *c = dynamic_cast<AbstractClient*>(topw);
+        Client *cc = dynamic_cast<Client*>(c);
+        // the window is fully opaque
+        if (cc && cc->decorationHasAlpha()) {
+            // decoration uses alpha channel, so we may not exclude it in clipping
+            return w->clientShape().translated(w->x(), w->y());
+        }
+        // decoration is fully opaque
+        if (c && c->isShade()) {
+            return QRegion();
+        }
+        return w->shape().translated(w->x(), w->y());
+    }
+    if (topw->hasAlpha() && topw->opacity() == 1.0) {
+        // the window is partially opaque
+        return (w->clientShape() & topw->opaqueRegion().translated(topw->clientPos())).translated(w->x(), w->y());
+    }
+    return QRegion();
+}
+
+void Scene::markOccludedWindows()
+{
+    m_occluded.fill(false, stacking_order.count());
+    // an effect could transform the windows above or make them translucent
+    if (static_cast<EffectsHandlerImpl*>(effects)->needsOccludedWindows()) {
+        return;
+    }
+    // reused as the union of the opaque windows, the occlusion pass starts over anyway
+    m_allClips.clear();
+    for (int i = stacking_order.count() - 1; i >= 0; --i) {
+        Window *w = stacking_order.at(i);
+        if (!w->isVisible()) {
+            continue;
+        }
+        if (m_allClips.contains(w->window()->visibleRect())) {
+            m_occluded[i] = true;
+            continue;
+        }
+        const QRegion clip = opaqueClip(w);
+        if (!clip.isEmpty()) {
+            m_allClips |= RectRegion(clip);
+        }
+    }
+}
+
+// Below this many rebuilt quad lists in the last frame waking up the
+// thread pool costs more than building them on the main thread
+static const int s_minConcurrentQuadRebuilds = 4;
+
+void Scene::buildWindowQuads(bool skipOccluded)
+{
+    m_windowQuads.resize(stacking_order.count());
+    m_quadsJobs.clear();
+    m_quadsVersions.resize(stacking_order.count());
+    for (int i = 0; i < stacking_order.count(); ++i) {
+        m_windowQuads[i].clear();
+        if (skipOccluded && m_occluded.at(i)) {
+            continue;
+        }
+        m_quadsJobs << i;
+        m_quadsVersions[i] = stacking_order.at(i)->quadsVersion();
+        // reading the Toplevel, the decoration or the X shape is not thread-safe
+        stacking_order.at(i)->prepareQuads();
+    }
+
+    // Rebuilds come in bursts, e.g. while resizing or after a scale change, so
+    // the last frame tells whether it is worth to build them in parallel
+    WindowQuadList *quads = m_windowQuads.data();
+    Window *const *windows = stacking_order.constData();
+    auto build = [quads, windows] (int index) {
+        quads[index] = windows[index]->buildPreparedQuads();
+    };
+    if (m_quadRebuilds >= s_minConcurrentQuadRebuilds && m_quadsJobs.count() > 1 &&
+            static_cast<EffectsHandlerImpl*>(effects)->supportsConcurrentBuildQuads()) {
+        QtConcurrent::blockingMap(m_quadsJobs, build);
+    } else {
+        for (int index : qAsConst(m_quadsJobs)) {
+            build(index);
+        }
+    }
+
+    m_quadRebuilds = 0;
+    for (int index : qAsConst(m_quadsJobs)) {
+        if (stacking_order.at(index)->quadsVersion() != m_quadsVersions.at(index)) {
+            ++m_quadRebuilds;
+        }
+    }
+}
+
 void Scene::windowAdded(Toplevel *c)
 {
     assert(!m_windows.contains(c));
@@ -455,7 +694,7 @@ void Scene::clearStackingOrder()
 
 static Scene::Window *s_recursionCheck = NULL;
 
-void Scene::paintWindow(Window* w, int mask, QRegion region, WindowQuadList quads)
+void Scene::paintWindow(Window* w, int mask, QRegion region, const WindowQuadList &quads)
 {
     // no painting outside visible screen (and no transformations)
     const QSize &screenSize = screens()->size();
@@ -629,6 +868,17 @@ bool Scene::syncsToVBlank() const
     return false;
 }
 
+bool Scene::supportsOutputPainting() const
+{
+    return false;
+}
+
+qint64 Scene::paintOutput(int screenId, QRegion damage, ToplevelList windows)
+{
+    Q_UNUSED(screenId)
+    return paint(damage, windows);
+}
+
 void Scene::screenGeometryChanged(const QSize &size)
 {
     if (!overlayWindow()) {
@@ -688,7 +938,6 @@ Scene::Window::Window(Toplevel * c)
     , m_referencePixmapCounter(0)
     , disable_painting(0)
     , shape_valid(false)
-    , cached_quad_list(NULL)
 {
 }
 
@@ -731,8 +980,8 @@ void Scene::Window::discardShape()
 {
     // it is created on-demand and cached, simply
     // reset the flag
+    // the quads only get rebuilt if the shape turns out to be different, moving doesn't change it
     shape_valid = false;
-    cached_quad_list.reset();
 }
 
 // Find out the shape of the window using the XShape extension
@@ -833,51 +1082,139 @@ void Scene::Window::disablePainting(int reason)
     disable_painting |= reason;
 }
 
-WindowQuadList Scene::Window::buildQuads(bool force) const
+std::atomic<quint64> Scene::Window::s_quadCacheHits(0);
+std::atomic<quint64> Scene::Window::s_quadCacheMisses(0);
+quint64 Scene::Window::s_clippedWindows[2] = {0, 0};
+quint64 Scene::Window::s_clippedDraws[2] = {0, 0};
+
+bool Scene::Window::QuadsKey::operator==(const QuadsKey &other) const
+{
+    return shape == other.shape &&
+           clientPos == other.clientPos &&
+           clientSize == other.clientSize &&
+           clientContentPos == other.clientContentPos &&
+           transparentRect == other.transparentRect &&
+           decorationRect == other.decorationRect &&
+           std::equal(decorationRects, decorationRects + 4, other.decorationRects) &&
+           scale == other.scale &&
+           decorationScale == other.decorationScale &&
+           client == other.client &&
+           shaded == other.shaded &&
+           shadow == other.shadow;
+}
+
+Scene::Window::QuadsKey Scene::Window::quadsKey() const
 {
-    if (cached_quad_list != NULL && !force)
-        return *cached_quad_list;
-    WindowQuadList ret;
-    qreal scale = 1.0;
+    QuadsKey key;
+    key.shape = shape();
+    key.clientPos = toplevel->clientPos();
+    key.clientSize = toplevel->clientSize();
+    key.clientContentPos = toplevel->clientContentPos();
+    key.transparentRect = toplevel->transparentRect();
+    key.decorationRect = toplevel->decorationRect();
     if (toplevel->surface()) {
-        scale = toplevel->surface()->scale();
+        key.scale = toplevel->surface()->scale();
+    }
+    if (AbstractClient *client = dynamic_cast<AbstractClient*>(toplevel)) {
+        client->layoutDecorationRects(key.decorationRects[0], key.decorationRects[1], key.decorationRects[2], key.decorationRects[3]);
+        key.decorationScale = client->screenScale();
+        key.client = true;
+        key.shaded = client->isShade();
     }
+    key.shadow = m_shadow && toplevel->wantsShadowToBeRendered();
+    if (key.shadow) {
+        key.shadowQuads = m_shadow->shadowQuads();
+    }
+    return key;
+}
+
+WindowQuadList Scene::Window::buildQuads(bool force) const
+{
+    return buildQuads(quadsKey(), force);
+}
+
+void Scene::Window::prepareQuads()
+{
+    m_preparedQuadsKey = quadsKey();
+}
 
-    if (toplevel->clientPos() == QPoint(0, 0) && toplevel->clientSize() == toplevel->decorationRect().size())
-        ret = makeQuads(WindowQuadContents, shape(), QPoint(0,0), scale);  // has no decoration
+WindowQuadList Scene::Window::buildPreparedQuads()
+{
+    return buildQuads(std::move(m_preparedQuadsKey), false);
+}
+
+WindowQuadList Scene::Window::buildQuads(QuadsKey key, bool force) const
+{
+    if (m_quadsValid && !force && key == m_quadsKey) {
+        ++s_quadCacheHits;
+        // shares the data, nothing gets copied unless an effect modifies its copy
+        return m_quads;
+    }
+    ++s_quadCacheMisses;
+    WindowQuadList ret;
+
+    if (key.clientPos == QPoint(0, 0) && key.clientSize == key.decorationRect.size())
+        ret = makeQuads(WindowQuadContents, key.shape, QPoint(0,0), key.scale);  // has no decoration
     else {
-        AbstractClient *client = dynamic_cast<AbstractClient*>(toplevel);
-        QRegion contents = clientShape();
-        QRegion center = toplevel->transparentRect();
-        QRegion decoration = (client ? QRegion(client->decorationRect()) : shape()) - center;
-        qreal decorationScale = 1.0;
-        ret = makeQuads(WindowQuadContents, contents, toplevel->clientContentPos(), scale);
-
-        QRect rects[4];
-        bool isShadedClient = false;
-
-        if (client) {
-            client->layoutDecorationRects(rects[0], rects[1], rects[2], rects[3]);
-            decorationScale = client->screenScale();
-            isShadedClient = client->isShade() || center.isEmpty();
-        }
+        // same as clientShape()
+        const QRegion contents = key.shaded ? QRegion() : key.shape & QRect(key.clientPos, key.clientSize);
+        QRegion center = key.transparentRect;
+        QRegion decoration = (key.client ? QRegion(key.decorationRect) : key.shape) - center;
+        ret = makeQuads(WindowQuadContents, contents, key.clientContentPos, key.scale);
+
+        const bool isShadedClient = key.client && (key.shaded || center.isEmpty());
 
         if (isShadedClient) {
+            const QRect *rects = key.decorationRects;
             const QRect bounding = rects[0] | rects[1] | rects[2] | rects[3];
-            ret += makeDecorationQuads(rects, bounding, decorationScale);
+            ret += makeDecorationQuads(rects, bounding, key.decorationScale);
         } else {
-            ret += makeDecorationQuads(rects, decoration, decorationScale);
+            ret += makeDecorationQuads(key.decorationRects, decoration, key.decorationScale);
         }
 
     }
-    if (m_shadow && toplevel->wantsShadowToBeRendered()) {
-        ret << m_shadow->shadowQuads();
+    if (key.shadow) {
+        ret << key.shadowQuads;
     }
     effects->buildQuads(toplevel->effectWindow(), ret);
-    cached_quad_list.reset(new WindowQuadList(ret));
+    m_quads = ret;
+    m_quadsKey = std::move(key);
+    m_quadsValid = true;
+    ++m_quadsVersion;
     return ret;
 }
 
+quint64 Scene::Window::quadsVersion() const
+{
+    return m_quadsVersion;
+}
+
+quint64 Scene::Window::quadCacheHits()
+{
+    return s_quadCacheHits;
+}
+
+quint64 Scene::Window::quadCacheMisses()
+{
+    return s_quadCacheMisses;
+}
+
+void Scene::Window::countClipping(Clipping clipping, int draws)
+{
+    ++s_clippedWindows[int(clipping)];
+    s_clippedDraws[int(clipping)] += draws;
+}
+
+quint64 Scene::Window::clippedWindows(Clipping clipping)
+{
+    return s_clippedWindows[int(clipping)];
+}
+
+quint64 Scene::Window::clippedDraws(Clipping clipping)
+{
+    return s_clippedDraws[int(clipping)];
+}
+
 WindowQuadList Scene::Window::makeDecorationQuads(const QRect *rects, const QRegion &region, qreal textureScale) const
 {
     WindowQuadList list;
@@ -21,6 +21,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef KWIN_SCENE_H
 #define KWIN_SCENE_H
 
+#include "frametelemetry.h"
+#include "rectregion.h"
 #include "toplevel.h"
 #include "utils.h"
 #include "kwineffects.h"
@@ -28,6 +30,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QElapsedTimer>
 #include <QMatrix4x4>
 
+#include <atomic>
+
 class QOpenGLFramebufferObject;
 
 namespace KWayland
@@ -36,6 +40,7 @@ namespace Server
 {
 class BufferInterface;
 class SubSurfaceInterface;
+class SurfaceInterface;
 }
 }
 
@@ -56,6 +61,16 @@ class OverlayWindow;
 class Shadow;
 class WindowPixmap;
 
+/**
+ * A surface which can be shown on a hardware plane instead of being composited.
+ **/
+struct OverlayCandidate
+{
+    KWayland::Server::SurfaceInterface *surface;
+    // in global compositor coordinates
+    QRect geometry;
+};
+
 // The base class for compositing backends.
 class KWIN_EXPORT Scene : public QObject
 {
@@ -77,6 +92,18 @@ public:
     // returns the time since the last vblank signal - if there's one
     // ie. "what of this frame is lost to painting"
     virtual qint64 paint(QRegion damage, ToplevelList windows) = 0;
+    /**
+     * Whether the Scene is able to repaint a single screen through paintOutput.
+     * The default implementation returns @c false.
+     **/
+    virtual bool supportsOutputPainting() const;
+    /**
+     * Like paint, but only repaints the screen @p screenId. The Compositor uses this to drive
+     * outputs with independent repaint loops. @p damage is in global compositor coordinates.
+     *
+     * The default implementation paints all screens.
+     **/
+    virtual qint64 paintOutput(int screenId, QRegion damage, ToplevelList windows);
 
     // Notification function - KWin core informs about changes.
     // Used to mainly discard cached data.
@@ -217,7 +244,7 @@ protected:
     // called after all effects had their paintWindow() called
     void finalPaintWindow(EffectWindowImpl* w, int mask, QRegion region, WindowPaintData& data);
     // shared implementation, starts painting the window
-    virtual void paintWindow(Window* w, int mask, QRegion region, WindowQuadList quads);
+    virtual void paintWindow(Window* w, int mask, QRegion region, const WindowQuadList &quads);
     // called after all effects had their drawWindow() called
     virtual void finalDrawWindow(EffectWindowImpl* w, int mask, QRegion region, WindowPaintData& data);
     // let the scene decide whether it's better to paint more of the screen, eg. in order to allow a buffer swap
@@ -226,17 +253,25 @@ protected:
     virtual void paintDesktop(int desktop, int mask, const QRegion &region, ScreenPaintData &data);
     // compute time since the last repaint
     void updateTimeDiff();
+    // tells the Compositor's FrameTelemetry which part of the pass is running
+    void enterFramePhase(FrameTelemetry::Phase phase);
+    // the surface of the window covering the whole screen if it can be presented without compositing
+    KWayland::Server::SurfaceInterface *directScanoutCandidate(int screenId) const;
+    // the unobscured opaque surfaces on the screen which could be put on overlay planes, topmost first
+    QVector<OverlayCandidate> overlayCandidates(int screenId) const;
+    // marks the windows on the screen painted after it got presented without compositing
+    void resetRepaintsAfterDirectScanout(int screenId);
     // saved data for 2nd pass of optimized screen painting
     struct Phase2Data {
-        Phase2Data(Window* w, QRegion r, QRegion c, int m, const WindowQuadList& q)
+        Phase2Data(Window* w, const QRegion &r, const QRegion &c, int m, const WindowQuadList& q)
             : window(w), region(r), clip(c), mask(m), quads(q) {}
         Phase2Data()  {
             window = 0;
             mask = 0;
         }
         Window* window;
-        QRegion region;
-        QRegion clip;
+        RectRegion region;
+        RectRegion clip;
         int mask;
         WindowQuadList quads;
     };
@@ -254,9 +289,31 @@ protected:
     int time_diff;
     QElapsedTimer last_time;
 private:
+    // whether nothing prevents presenting surfaces on the screen without compositing them
+    bool canBypassComposition(int screenId) const;
+    // the part of the window hiding what is below it as long as no effect touches it
+    QRegion opaqueClip(Window *w) const;
+    // marks the windows which are hidden behind opaque windows above them
+    void markOccludedWindows();
+    // builds the quads of all windows in the stacking order, in parallel if worthwhile
+    void buildWindowQuads(bool skipOccluded);
     void paintWindowThumbnails(Scene::Window *w, QRegion region, qreal opacity, qreal brightness, qreal saturation);
     void paintDesktopThumbnails(Scene::Window *w);
     QHash< Toplevel*, Window* > m_windows;
+    // regions of the occlusion pass, kept across frames to reuse their memory
+    RectRegion m_allClips;
+    RectRegion m_upperTranslucentDamage;
+    RectRegion m_paintedArea;
+    // the second pass of paintSimpleScreen, kept across frames like the regions
+    QVector<Phase2Data> m_phase2Data;
+    // whether the window at the same position in the stacking order is hidden completely
+    QVector<bool> m_occluded;
+    // the quads of the window at the same position in the stacking order
+    QVector<WindowQuadList> m_windowQuads;
+    QVector<int> m_quadsJobs;
+    QVector<quint64> m_quadsVersions;
+    // how many windows had to rebuild their quads in the last frame
+    int m_quadRebuilds = 0;
     // windows in their stacking order
     QVector< Window* > stacking_order;
 };
@@ -329,8 +386,26 @@ public:
     QRegion clientShape() const;
     void discardShape();
     void updateToplevel(Toplevel* c);
-    // creates initial quad list for the window
+    // creates initial quad list for the window, reused until anything it is built from changes
     virtual WindowQuadList buildQuads(bool force = false) const;
+    // collects what the quads are built from, has to be called on the main thread
+    void prepareQuads();
+    // builds the quads from what prepareQuads() collected, may be called from any thread
+    WindowQuadList buildPreparedQuads();
+    // changes whenever buildQuads() had to build a new quad list
+    quint64 quadsVersion() const;
+    // how often buildQuads() could reuse the quads since startup
+    static quint64 quadCacheHits();
+    static quint64 quadCacheMisses();
+    // how a window painted with a clip region got restricted to it
+    enum class Clipping {
+        Quads, // the quads were trimmed to the region before uploading them
+        Scissor // one draw per rect of the region, each with a scissor rect
+    };
+    static void countClipping(Clipping clipping, int draws);
+    // how many windows were clipped in the given way and with how many draws since startup
+    static quint64 clippedWindows(Clipping clipping);
+    static quint64 clippedDraws(Clipping clipping);
     void updateShadow(Shadow* shadow);
     const Shadow* shadow() const;
     Shadow* shadow();
@@ -373,7 +448,36 @@ private:
     int disable_painting;
     mutable QRegion shape_region;
     mutable bool shape_valid;
-    mutable QScopedPointer<WindowQuadList> cached_quad_list;
+    // everything the quads are built from, a new shadow forces a rebuild on its own
+    struct QuadsKey {
+        QRegion shape;
+        QPoint clientPos;
+        QSize clientSize;
+        QPoint clientContentPos;
+        QRect transparentRect;
+        QRect decorationRect;
+        QRect decorationRects[4];
+        qreal scale = 1.0;
+        qreal decorationScale = 1.0;
+        bool client = false;
+        bool shaded = false;
+        bool shadow = false;
+        // not compared, the quads of a new shadow force a rebuild on their own
+        WindowQuadList shadowQuads;
+        bool operator==(const QuadsKey &other) const;
+    };
+    QuadsKey quadsKey() const;
+    // only uses @p key and the cached quads, so that it is safe on other threads
+    WindowQuadList buildQuads(QuadsKey key, bool force) const;
+    mutable WindowQuadList m_quads;
+    mutable QuadsKey m_quadsKey;
+    QuadsKey m_preparedQuadsKey;
+    mutable bool m_quadsValid = false;
+    mutable quint64 m_quadsVersion = 0;
+    static std::atomic<quint64> s_quadCacheHits;
+    static std::atomic<quint64> s_quadCacheMisses;
+    static quint64 s_clippedWindows[2];
+    static quint64 s_clippedDraws[2];
     Q_DISABLE_COPY(Window)
 };
 
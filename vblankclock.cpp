@@ -0,0 +1,173 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "vblankclock.h"
+#include "utils.h"
+
+#include <QSocketNotifier>
+#include <QTimer>
+
+#ifdef Q_OS_LINUX
+#include <sys/timerfd.h>
+#endif
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace KWin
+{
+
+static const qint64 s_nanoPerSecond = 1000000000;
+
+static qint64 intervalForRefreshRate(int refreshRate)
+{
+    // refresh rate is given in mHz
+    return s_nanoPerSecond * 1000 / qMax(refreshRate, 1000);
+}
+
+VBlankClock::VBlankClock(QObject *parent)
+    : QObject(parent)
+    , m_refreshInterval(intervalForRefreshRate(m_refreshRate))
+{
+#ifdef Q_OS_LINUX
+    m_timerFd = ::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (m_timerFd >= 0) {
+        m_notifier = new QSocketNotifier(m_timerFd, QSocketNotifier::Read, this);
+        connect(m_notifier, &QSocketNotifier::activated, this,
+            [this] {
+                uint64_t expirations;
+                if (::read(m_timerFd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+                    // spurious wakeup, e.g. the timer got re-armed in between
+                    return;
+                }
+                handleWakeup();
+            }
+        );
+        return;
+    }
+    qCWarning(KWIN_CORE) << "Failed to create timerfd for vblank clock, falling back to QTimer";
+#endif
+    m_fallbackTimer = new QTimer(this);
+    m_fallbackTimer->setSingleShot(true);
+    m_fallbackTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_fallbackTimer, &QTimer::timeout, this, &VBlankClock::handleWakeup);
+}
+
+VBlankClock::~VBlankClock()
+{
+    if (m_timerFd >= 0) {
+        ::close(m_timerFd);
+    }
+}
+
+qint64 VBlankClock::now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * s_nanoPerSecond + ts.tv_nsec;
+}
+
+void VBlankClock::setRefreshRate(int refreshRate)
+{
+    if (m_refreshRate == refreshRate) {
+        return;
+    }
+    m_refreshRate = refreshRate;
+    m_refreshInterval = intervalForRefreshRate(refreshRate);
+}
+
+void VBlankClock::notifyVBlank(qint64 timestamp, quint64 sequence)
+{
+    if (timestamp <= 0) {
+        return;
+    }
+    m_lastVBlank = timestamp;
+    m_lastSequence = sequence;
+}
+
+qint64 VBlankClock::nextVBlank() const
+{
+    const qint64 current = now();
+    qint64 reference = m_lastVBlank;
+    if (reference == 0) {
+        // we never got a real timestamp, so the phase is unknown - just pick one and stick to it
+        if (m_softwareReference == 0) {
+            m_softwareReference = current;
+        }
+        reference = m_softwareReference;
+    }
+    if (reference > current) {
+        return reference;
+    }
+    const qint64 cycles = (current - reference) / m_refreshInterval + 1;
+    return reference + cycles * m_refreshInterval;
+}
+
+void VBlankClock::scheduleWakeup(qint64 target)
+{
+    m_wakeupScheduled = true;
+#ifdef Q_OS_LINUX
+    if (m_timerFd >= 0) {
+        // an all zero it_value would disarm the timer, a time in the past fires immediately
+        target = qMax(target, qint64(1));
+        itimerspec spec = {};
+        spec.it_value.tv_sec = target / s_nanoPerSecond;
+        spec.it_value.tv_nsec = target % s_nanoPerSecond;
+        if (::timerfd_settime(m_timerFd, TFD_TIMER_ABSTIME, &spec, nullptr) == 0) {
+            return;
+        }
+        qCWarning(KWIN_CORE) << "Failed to arm vblank timer";
+    }
+#endif
+    if (m_fallbackTimer) {
+        m_fallbackTimer->start(qMax(qint64(0), (target - now()) / 1000000));
+    } else {
+        // nothing we can wait on, wake up with the next event loop iteration
+        QMetaObject::invokeMethod(this, "wakeup", Qt::QueuedConnection);
+        m_wakeupScheduled = false;
+    }
+}
+
+void VBlankClock::cancelWakeup()
+{
+    if (!m_wakeupScheduled) {
+        return;
+    }
+    m_wakeupScheduled = false;
+#ifdef Q_OS_LINUX
+    if (m_timerFd >= 0) {
+        const itimerspec spec = {};
+        ::timerfd_settime(m_timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+    }
+#endif
+    if (m_fallbackTimer) {
+        m_fallbackTimer->stop();
+    }
+}
+
+void VBlankClock::handleWakeup()
+{
+    if (!m_wakeupScheduled) {
+        return;
+    }
+    m_wakeupScheduled = false;
+    emit wakeup();
+}
+
+}
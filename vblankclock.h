@@ -0,0 +1,129 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 kwin-lowlatency contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#ifndef KWIN_VBLANKCLOCK_H
+#define KWIN_VBLANKCLOCK_H
+
+#include <kwin_export.h>
+
+#include <QObject>
+
+class QSocketNotifier;
+class QTimer;
+
+namespace KWin
+{
+
+/**
+ * @brief Predicts the vertical blanks of one output.
+ *
+ * The clock is fed with the timestamps of real vblanks or presentations by the platform
+ * (e.g. the DRM page flip event or GLX_OML_sync_control) through notifyVBlank. Without
+ * such timestamps it acts as a software clock running at the configured refresh rate.
+ *
+ * All times are in nanoseconds on the CLOCK_MONOTONIC time base.
+ *
+ * Besides prediction the clock provides an asynchronous wakeup (a timerfd on Linux), so
+ * that the Compositor can wait for a vblank without blocking the event loop.
+ **/
+class KWIN_EXPORT VBlankClock : public QObject
+{
+    Q_OBJECT
+public:
+    explicit VBlankClock(QObject *parent = nullptr);
+    virtual ~VBlankClock();
+
+    /**
+     * Sets the refresh rate in mHz, like in the wl_output mode.
+     **/
+    void setRefreshRate(int refreshRate);
+    int refreshRate() const {
+        return m_refreshRate;
+    }
+    /**
+     * @returns the duration of one refresh cycle in nanoseconds
+     **/
+    qint64 refreshInterval() const {
+        return m_refreshInterval;
+    }
+
+    /**
+     * Feeds the clock with the @p timestamp of a vblank which actually happened.
+     * @p sequence is the hardware vblank counter, if known.
+     **/
+    void notifyVBlank(qint64 timestamp, quint64 sequence = 0);
+    /**
+     * @returns the timestamp of the last known vblank, @c 0 if there has not been any
+     **/
+    qint64 lastVBlank() const {
+        return m_lastVBlank;
+    }
+    /**
+     * @returns the vblank counter of the last known vblank, @c 0 if unknown
+     **/
+    quint64 lastSequence() const {
+        return m_lastSequence;
+    }
+    /**
+     * @returns the predicted timestamp of the first vblank after now
+     **/
+    qint64 nextVBlank() const;
+    /**
+     * @returns @c true if the clock got fed by the platform, @c false if it is a pure
+     * software clock.
+     **/
+    bool isHardwareBacked() const {
+        return m_lastVBlank != 0;
+    }
+
+    /**
+     * Arms a one-shot wakeup at @p target. The wakeup signal is emitted once
+     * the target time is reached. An already armed wakeup is replaced.
+     **/
+    void scheduleWakeup(qint64 target);
+    void cancelWakeup();
+    bool isWakeupScheduled() const {
+        return m_wakeupScheduled;
+    }
+
+    /**
+     * @returns the current time on the clock's time base
+     **/
+    static qint64 now();
+
+Q_SIGNALS:
+    void wakeup();
+
+private:
+    void handleWakeup();
+    int m_refreshRate = 60000;
+    qint64 m_refreshInterval;
+    qint64 m_lastVBlank = 0;
+    quint64 m_lastSequence = 0;
+    // reference point for the software clock if the platform never fed us
+    mutable qint64 m_softwareReference = 0;
+    bool m_wakeupScheduled = false;
+    int m_timerFd = -1;
+    QSocketNotifier *m_notifier = nullptr;
+    QTimer *m_fallbackTimer = nullptr;
+};
+
+}
+
+#endif
@@ -20,6 +20,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "wayland_server.h"
 #include "client.h"
 #include "platform.h"
+#include "presentationtime.h"
 #include "composite.h"
 #include "idle_inhibition.h"
 #include "screens.h"
@@ -364,6 +365,8 @@ bool WaylandServer::init(const QByteArray &socketName, InitalizationFlags flags)
     m_XdgForeign = m_display->createXdgForeignInterface(m_display);
     m_XdgForeign->create();
 
+    m_presentationTime = new PresentationTime(m_display, m_display);
+
     return true;
 }
 
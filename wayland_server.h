@@ -66,6 +66,7 @@ class XdgOutputManagerInterface;
 
 namespace KWin
 {
+class PresentationTime;
 class ShellClient;
 
 class AbstractClient;
@@ -108,6 +109,9 @@ public:
     KWayland::Server::XdgOutputManagerInterface *xdgOutputManager() const {
         return m_xdgOutputManager;
     }
+    PresentationTime *presentationTime() const {
+        return m_presentationTime;
+    }
 
     QList<ShellClient*> clients() const {
         return m_clients;
@@ -254,6 +258,7 @@ private:
         QPointer<KWayland::Server::DataDeviceInterface> ddi;
     } m_xclipbaordSync;
     KWayland::Server::XdgForeignInterface *m_XdgForeign = nullptr;
+    PresentationTime *m_presentationTime = nullptr;
     QList<ShellClient*> m_clients;
     QList<ShellClient*> m_internalClients;
     QHash<KWayland::Server::ClientConnection*, quint16> m_clientIds;